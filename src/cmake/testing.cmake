@@ -158,15 +158,17 @@ macro (osl_add_all_tests)
                 fprintf
                 function-earlyreturn function-simple function-outputelem
                 function-overloads function-redef
-                geomath getattribute-camera getattribute-shader
+                geomath getattribute-camera getattribute-invariant
+                getattribute-shader
                 getsymbol-nonheap gettextureinfo
                 group-outputs groupstring
                 hash hashnoise hex hyperb
                 ieee_fp if incdec initlist initops intbits isconnected isconstant
+                jit-cache
                 layers layers-Ciassign layers-entry layers-lazy layers-lazyerror
                 layers-nonlazycopy layers-repeatedoutputs
-                linearstep
-                logic loop matrix message
+                linearstep llvm-tiered-jit
+                logic loop matrix matrix-cache message
                 mergeinstances-duplicate-entrylayers
                 mergeinstances-nouserdata mergeinstances-vararray
                 metadata-braces miscmath missing-shader
@@ -195,17 +197,20 @@ macro (osl_add_all_tests)
                 oslc-version
                 oslinfo-arrayparams oslinfo-colorctrfloat
                 oslinfo-metadata oslinfo-noparams
-                osl-imageio
+                osl-imageio oso-binary
                 paramval-floatpromotion
+                pointcloud-oslpc
                 pragma-nowarn
-                printf-whole-array
-                raytype raytype-specialized reparam
+                printf-whole-array promote-interactive
+                raytype raytype-specialized regex-runtime
+                reparam reparam-interactive
                 render-background render-bumptest
                 render-cornell render-furnace-diffuse
                 render-microfacet render-oren-nayar render-veachmis render-ward
-                select shortcircuit spline splineinverse splineinverse-ident
+                render-wavefront
+                select shadeimage shortcircuit spline splineinverse splineinverse-ident
                 spline-boundarybug spline-derivbug
-                string
+                string string-threads
                 struct struct-array struct-array-mixture
                 struct-err struct-init-copy
                 struct-isomorphic-overload struct-layers
@@ -218,7 +223,7 @@ macro (osl_add_all_tests)
                 texture-derivs texture-errormsg
                 texture-firstchannel texture-interp
                 texture-missingalpha texture-missingcolor texture-simple
-                texture-smallderivs texture-swirl texture-udim
+                texture-smallderivs texture-swirl texture-udim texture-warmup
                 texture-width texture-withderivs texture-wrap
                 trailing-commas
                 transitive-assign
@@ -7,7 +7,6 @@
 #include <OSL/optautomata.h>
 #include <OSL/oslconfig.h>
 #include <list>
-#include <stack>
 
 OSL_NAMESPACE_ENTER
 
@@ -123,7 +122,25 @@ public:
 
     /// Performs an accumulation in the given outputs vector if any rule is activated in the given state
     void accum(int state, const Color3& color,
-               std::vector<AovOutput>& outputs) const;
+               std::vector<AovOutput>& outputs) const
+    {
+        const StateTargets& st = m_state_targets[state];
+        const int* targets     = &m_targets[st.begin];
+        for (int i = 0; i < st.ncolor; ++i) {
+            AovOutput& out = outputs[targets[i]];
+            out.color += color;
+            out.has_color = true;
+        }
+        if (st.nalpha) {
+            float alpha = (color.x + color.y + color.z) * 1.0f / 3.0f;
+            targets += st.ncolor;
+            for (int i = 0; i < st.nalpha; ++i) {
+                AovOutput& out = outputs[targets[i]];
+                out.alpha += alpha;
+                out.has_alpha = true;
+            }
+        }
+    };
 
     /// Get an specific transition
     int getTransition(int state, ustring symbol) const
@@ -141,6 +158,14 @@ public:
     };
 
 private:
+    // Output indices written by the rules of a state, the color targets
+    // first and then the alpha ones, flattened into m_targets by compile()
+    struct StateTargets {
+        int begin;
+        int ncolor;
+        int nalpha;
+    };
+
     // Compiled lpexp's we save while creating the rules with addRule.
     // It gets nuked after you call compile()
     std::list<lpexp::Rule*> m_rules;
@@ -152,6 +177,9 @@ private:
     std::vector<ustring> m_user_events;
     // Custom symbols to support on expressions as scattering
     std::vector<ustring> m_user_scatterings;
+    // Accumulation targets of every state
+    std::vector<StateTargets> m_state_targets;
+    std::vector<int> m_targets;
 };
 
 
@@ -162,6 +190,10 @@ private:
 /// integrator functions during the light walk. Knows what state
 /// we are at and keeps record of the accumulated values (AovOutput)
 ///
+/// Note: the layouts of AccumAutomata and Accumulator (and of
+/// DfOptimizedAutomata) changed in 1.12, so code that embeds them must
+/// be rebuilt against the 1.12 headers.
+///
 class OSLEXECPUBLIC Accumulator {
 public:
     Accumulator(const AccumAutomata* accauto);
@@ -224,7 +256,7 @@ private:
     // by rules and NULL for the rest
     std::vector<AovOutput> m_outputs;
     // Current state stack, this is state information
-    std::stack<int> m_stack;
+    std::vector<int> m_stack;
     // And the current state
     int m_state;
 };
@@ -110,6 +110,30 @@ public:
     void jit_aggressive(bool val) { m_jit_aggressive = val; }
     bool jit_aggressive() const { return m_jit_aggressive; }
 
+    /// When true, string constants are emitted as references to named
+    /// external symbols (resolved when the code is JITed) rather than as
+    /// the absolute addresses of the ustring characters, so that the
+    /// compiled object code is not tied to this process and may be saved
+    /// in a jit_object_cache() for later runs.
+    void relocatable_constants(bool val) { m_relocatable_constants = val; }
+    bool relocatable_constants() const { return m_relocatable_constants; }
+
+    /// When true, each ExecutionEngine made by make_jit_execengine() gets
+    /// its own memory manager rather than sharing the per-thread one that
+    /// lives until the last ScopedJitMemoryUser goes away.  The machine
+    /// code is then owned by the JitCodeHandle returned by jit_code(), and
+    /// is unmapped once the last copy of that handle is released.
+    void own_jit_code(bool val) { m_own_jit_code = val; }
+    bool own_jit_code() const { return m_own_jit_code; }
+
+    /// Opaque reference that keeps JITed machine code alive.
+    typedef std::shared_ptr<void> JitCodeHandle;
+
+    /// Handle for the code of the most recent make_jit_execengine(), or
+    /// an empty handle if own_jit_code() was not set.  The handle remains
+    /// valid after the ExecutionEngine and this LLVM_Util are destroyed.
+    JitCodeHandle jit_code() const { return m_jit_code; }
+
     /// Return a reference to the current context.
     llvm::LLVMContext &context () const { return *m_llvm_context; }
 
@@ -138,6 +162,15 @@ public:
                                        const std::string &name=std::string(),
                                        std::string *err=NULL);
 
+    /// Like module_from_bitcode, but the buffer is only deserialized the
+    /// first time this thread asks for it (it is remembered by address in
+    /// the PerThreadInfo, so the bitcode must outlive it), and every call
+    /// returns a new clone of that parsed template.  Use this for bitcode
+    /// libraries that are loaded over and over, such as the shadeops.
+    llvm::Module *module_from_bitcode_cached (const char *bitcode, size_t size,
+                                              const std::string &name=std::string(),
+                                              std::string *err=NULL);
+
     bool debug_is_enabled() const;
     void debug_setup_compilation_unit(const char * compile_unit_name);
     void debug_push_function(const std::string & function_name,
@@ -168,6 +201,18 @@ public:
     /// explicitly instead of relying on dlsym.
     void add_function_mapping (llvm::Function *func, void *addr);
 
+    typedef std::vector<std::pair<std::string,void*> > GlobalMappings;
+
+    /// All the (symbol, address) pairs that the ExecutionEngine has been
+    /// given for the current module, by add_function_mapping() or for
+    /// relocatable string constants.  Together with the module bitcode,
+    /// this is what it takes to JIT the module again later.
+    const GlobalMappings &global_mappings () const { return m_global_mappings; }
+
+    /// Give the ExecutionEngine the addresses of all the globals in
+    /// 'mappings' that the current module refers to.
+    void add_global_mappings (const GlobalMappings &mappings);
+
     /// Set up a new current function that subsequent basic blocks will
     /// be added to.
     void current_function (llvm::Function *func) { m_current_function = func; }
@@ -202,6 +247,15 @@ public:
                          bool debugging_symbols = false,
                          bool profiling_events = false);
 
+    /// Like the above, but profiling_events selects which profiler to
+    /// notify: 0 = none, 1 = Intel VTune, 2 = a perf map
+    /// (/tmp/perf-<pid>.map), 3 = perf jitdump if LLVM supports it, else
+    /// a perf map.
+    llvm::ExecutionEngine* make_jit_execengine (std::string *err,
+                         TargetISA requestedISA,
+                         bool debugging_symbols,
+                         int profiling_events);
+
     /// Report the host's TargetISA as chosen by the last call to
     /// make_jit_execengine() or to detect_cpu_features(). Don't call
     /// target_isa() unless one of those has previously been called.
@@ -250,6 +304,26 @@ public:
     /// current one).
     void execengine (llvm::ExecutionEngine *exec);
 
+    enum class ObjectCacheResult {
+        Uncacheable, // Module embeds process-specific addresses
+        Miss,        // Not in the cache, will be added once compiled
+        Hit          // Cached object code will be used
+    };
+
+    /// Use directory 'dir' as an on-disk cache of the machine code that
+    /// the current ExecutionEngine produces for the current module, stored
+    /// under the name 'key' (which the caller must make unique to the
+    /// module contents, target and JIT options).  Call after
+    /// make_jit_execengine() and before getPointerToFunction().  On a Hit,
+    /// the cached object will be loaded instead of generating code, so
+    /// there is no need to run do_optimize(), and if bytes_loaded is not
+    /// NULL, the object size will be stored there.  On a Miss, the object
+    /// will be written to the cache when it is compiled.  Modules that
+    /// embed absolute addresses (see relocatable_constants()) are never
+    /// cached.
+    ObjectCacheResult jit_object_cache (string_view dir, string_view key,
+                                        size_t *bytes_loaded = nullptr);
+
     enum class Linkage {
         External, // Externally visible
         LinkOnceODR, // One Definition Rule:  Inline version, but allow replacement by equivalent.
@@ -630,6 +704,14 @@ public:
     /// If the type specified is NULL, it will make a 'void *'.
     llvm::Value *constant_ptr (void *p, llvm::PointerType *type=NULL);
 
+    /// Like constant_ptr(p,type), but if relocatable_constants() is on,
+    /// refer to the address through an external symbol called 'name'
+    /// that is mapped to p when the code is JITed.  The name must stand
+    /// for the same object in any process that might load the code (for
+    /// example, be derived from its contents).
+    llvm::Value *constant_ptr (void *p, string_view name,
+                               llvm::PointerType *type=NULL);
+
     /// Return an llvm::Value holding the given string constant.
     llvm::Value *constant (ustring s);
     llvm::Value *constant (string_view s) {
@@ -900,6 +982,9 @@ public:
     /// Convert entire module's bitcode to a string.
     std::string module_string ();
 
+    /// Return the serialized bitcode of the current module.
+    std::string module_bitcode ();
+
     /// Delete the IR for the body of the given function to reclaim its
     /// memory (only helpful if we know we won't use it again).
     void delete_func_body (llvm::Function *func);
@@ -914,6 +999,7 @@ public:
 private:
     class MemoryManager;
     class IRBuilder;
+    class ObjectCache;
 
     void SetupLLVM ();
     IRBuilder& builder();
@@ -922,6 +1008,11 @@ private:
     bool m_dumpasm = false;
     bool m_jit_fma = false;
     bool m_jit_aggressive = false;
+    bool m_relocatable_constants = false;
+    bool m_own_jit_code = false;
+    JitCodeHandle m_jit_code;
+    GlobalMappings m_global_mappings;
+    ObjectCache *m_object_cache = nullptr;
     PerThreadInfo::Impl *m_thread;
     llvm::LLVMContext *m_llvm_context;
     llvm::Module *m_llvm_module;
@@ -985,6 +1076,7 @@ private:
 
     // Profiling Info
     llvm::JITEventListener* mVTuneNotifier;
+    llvm::JITEventListener* mPerfNotifier;
 
     // Debug Info
     llvm::DIFile * getOrCreateDebugFileFor(const std::string &file_name);
@@ -20,27 +20,37 @@ class DfAutomata;
 ///
 /// Apparently hash maps suck in speed for our transition tables. This
 /// is a fast compact equivalent of the DfAutomata designed for read
-/// only operations.
+/// only operations. Every symbol that appears in a transition is
+/// interned to a small integer id at compile time, and transitions are
+/// a dense state x symbol table, so a move is a single table lookup.
 ///
 class OSLEXECPUBLIC DfOptimizedAutomata {
 public:
     void compileFrom(const DfAutomata& dfautomata);
 
-    int getTransition(int state, OIIO::ustring symbol) const
+    /// Return the interned id of a symbol. All the symbols that no
+    /// state has an explicit transition for share the id numSymbols()-1,
+    /// which only leads to wildcard transitions.
+    int getSymbolId(OIIO::ustring symbol) const
     {
-        const State& mystate    = m_states[state];
-        const Transition* begin = &m_trans[mystate.begin_trans];
-        const Transition* end   = begin + mystate.ntrans;
-        while (begin < end) {  // binary search
-            const Transition* middle = begin + ((end - begin) >> 1);
-            if (symbol.data() < middle->symbol.data())
-                end = middle;
-            else if (middle->symbol.data() < symbol.data())
-                begin = middle + 1;
-            else  // match
-                return middle->state;
+        // open addressing on the precomputed ustring hash, empty slots
+        // hold a null string and the id of "any other symbol"
+        const size_t mask = m_symbol_slots.size() - 1;
+        for (size_t i = symbol.hash() & mask;; i = (i + 1) & mask) {
+            const SymbolSlot& slot = m_symbol_slots[i];
+            if (slot.symbol == symbol.c_str() || !slot.symbol)
+                return slot.id;
         }
-        return mystate.wildcard_trans;
+    }
+
+    int getTransition(int state, int symbolid) const
+    {
+        return m_trans[state * m_nsymbols + symbolid];
+    }
+
+    int getTransition(int state, OIIO::ustring symbol) const
+    {
+        return getTransition(state, getSymbolId(symbol));
     }
 
     void* const* getRules(int state, int& count) const
@@ -49,23 +59,23 @@ public:
         return &m_rules[m_states[state].begin_rules];
     }
 
+    int numStates() const { return int(m_states.size()); }
+    int numSymbols() const { return m_nsymbols; }
+
 protected:
     struct State {
-        unsigned int begin_trans;
-        unsigned int ntrans;
         unsigned int begin_rules;
         unsigned int nrules;
-        int wildcard_trans;
     };
-    struct Transition {
-        // we use this only for sorting
-        static bool trans_comp(const Transition& a, const Transition& b);
-        OIIO::ustring symbol;
-        int state;
+    struct SymbolSlot {
+        const char* symbol;
+        int id;
     };
-    std::vector<Transition> m_trans;
+    std::vector<SymbolSlot> m_symbol_slots;  // power of two sized
+    std::vector<int> m_trans;  // [state * m_nsymbols + symbolid] -> state
     std::vector<void*> m_rules;
     std::vector<State> m_states;
+    int m_nsymbols = 0;  // interned symbols plus one for all others
 };
 
 OSL_NAMESPACE_EXIT
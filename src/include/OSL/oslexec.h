@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 
 #include <OSL/oslconfig.h>
@@ -83,7 +84,13 @@ public:
     ///    int buffer_printf      Buffer printf output from shaders and
     ///                              output atomically, to prevent threads
     ///                              from interleaving lines. (1)
-    ///    int profile            Perform some rudimentary profiling (0)
+    ///    int profile            Perform some rudimentary profiling (0).
+    ///                              2 also times every stretch of code
+    ///                              from each shader source line, and
+    ///                              lists the most expensive lines in
+    ///                              getstats(), less the measured cost of
+    ///                              the timing itself (costly, for tuning
+    ///                              only).
     ///    int no_noise           Replace noise with constant value. (0)
     ///    int no_pointcloud      Skip pointcloud lookups. (0)
     ///    int exec_repeat        How many times to run each group (1).
@@ -121,6 +128,20 @@ public:
     ///                              isconnected()? (0)
     ///    int greedyjit          Optimize and compile all shaders up front,
     ///                              versus only as needed (0).
+    ///    int jit_cost_order     When compiling many groups at once, start
+    ///                              with the most expensive ones, so that a
+    ///                              few big groups don't finish last (1).
+    ///    int async_jit_threads  Number of background threads used to
+    ///                              compile groups passed to compile_async()
+    ///                              or execute_nonblocking() (0 = one per
+    ///                              hardware core). Started on first use.
+    ///    int texture_warmup     As soon as a group is optimized, open the
+    ///                              constant textures it can access on a
+    ///                              background thread, so their first
+    ///                              lookup doesn't wait on the file open:
+    ///                              0 = off, 1 = open files and read their
+    ///                              specs, 2 = also read the coarsest MIP
+    ///                              level of each. (0)
     ///    int llvm_target_host   Target the specific host architecture for
     ///                              LLVM IR generation. (1)
     ///    int llvm_jit_fma       Allow fused mul/add (0). This can increase
@@ -138,7 +159,11 @@ public:
     ///                             that associate machine code with shader
     ///                             source and lines. (0)
     ///    int llvm_profiling_events  When JITing, generate events to enable
-    ///                             full profiling of shaders. (0)
+    ///                             full profiling of shaders: 1 = Intel
+    ///                             VTune, 2 = write /tmp/perf-<pid>.map
+    ///                             for Linux perf, 3 = perf jitdump (needs
+    ///                             an LLVM built with LLVM_USE_PERF, else
+    ///                             same as 2). (0)
     ///    int lockgeom           Default 'lockgeom' value for shader params
     ///                              that don't specify it (1).  Lockgeom
     ///                              means a param CANNOT be overridden by
@@ -148,6 +173,15 @@ public:
     ///                              once, replacing former definition.
     ///    string archive_groupname  Name of a group to pickle and archive.
     ///    string archive_filename   Name of file to save the group archive.
+    ///    string jit_cache_dir   If set, directory in which to keep the
+    ///                              machine code of JITed shader groups,
+    ///                              so that later runs that build the same
+    ///                              groups with the same options can skip
+    ///                              LLVM optimization and code generation. ("")
+    ///    int jit_dedup          Let groups whose generated code is identical
+    ///                              (for example, copies of one material
+    ///                              that differ only in their names) share
+    ///                              a single JIT compile. (1)
     /// 3. Attributes that that are intended for developers debugging
     /// liboslexec itself:
     /// These attributes may be helpful for liboslexec developers or
@@ -165,6 +199,12 @@ public:
     ///         opt_seed_bblock_aliases
     ///    int opt_passes         Number of optimization passes per layer (10)
     ///    int llvm_optimize      Which of several LLVM optimize strategies (1)
+    ///    int llvm_tiered_jit    If nonzero, first JIT each group quickly at
+    ///                              the llvm_tiered_jit_level, and re-JIT it
+    ///                              in the background at full llvm_optimize
+    ///                              after this many executions (0).
+    ///    int llvm_tiered_jit_level  The llvm_optimize level used for the
+    ///                              quick first JIT of tiered groups (11).
     ///    int llvm_debug         Set LLVM extra debug level (0)
     ///    int llvm_debug_layers  Extra printfs upon entering and leaving
     ///                              layer functions.
@@ -369,6 +409,10 @@ public:
     ///   int raytype_queries        Bit field of all possible rayquery
     ///   int num_entry_layers       Number of named entry point layers.
     ///   string entry_layers[]      List of entry point layers.
+    ///   int tier_up_pending        Nonzero if the group has asked for its
+    ///                                fully optimized re-JIT (see
+    ///                                "llvm_tiered_jit") and it hasn't
+    ///                                finished yet.
     ///   string pickle              Retrieves a serialized representation
     ///                                 of the shader group declaration.
     /// Note: the attributes referred to as "string" are actually on the app
@@ -461,6 +505,16 @@ public:
     /// this call) is a constant.
     bool Parameter (ShaderGroup& group, string_view name, TypeDesc t,
                     const void *val, bool lockgeom=true);
+    /// Set a parameter as above, and if interactive is true (and lockgeom
+    /// is also true), mark it as a parameter that will keep being edited
+    /// with ReParameter after the group is optimized, for example while a
+    /// user drags a slider.  Interactive parameters are not constant
+    /// folded; the compiled shader reads them from a per-group parameter
+    /// block, so a ReParameter takes effect on the next execution without
+    /// recompiling.  In a serialized group description, the same is
+    /// expressed by the hint [[int interactive=1]].
+    bool Parameter (ShaderGroup& group, string_view name, TypeDesc t,
+                    const void *val, bool lockgeom, bool interactive);
     // Shortcuts for param passing a single int, float, or string.
     bool Parameter (ShaderGroup& group, string_view name,
                     int val, bool lockgeom=true) {
@@ -510,7 +564,11 @@ public:
     /// unless the particular parameter is marked as lockgeom=0 (which
     /// indicates that it's a parameter that may be overridden by the
     /// geometric primitive).  This call gives you a way of changing the
-    /// instance value, even if it's not a geometric override.
+    /// instance value, even if it's not a geometric override.  Parameters
+    /// declared interactive may also be changed after optimization.
+    /// Shading reads interactive values in place, so no shading of the
+    /// group may be in flight while they are changed, or it can see a
+    /// partly written value.
     bool ReParameter (ShaderGroup &group,
                       string_view layername, string_view paramname,
                       TypeDesc type, const void *val);
@@ -534,6 +592,19 @@ public:
                             (const char**)&val);
     }
 
+    /// Once editing of a group's interactive parameters has settled,
+    /// rebuild the network as it was originally described (not as the
+    /// optimizer left it), except that those parameters are ordinary
+    /// instance values with their current settings, so that they can be
+    /// fully optimized again.  The new group is queued for
+    /// compile_async() at the given priority and returned (or an empty
+    /// ref on failure); the renderer can keep shading with the original
+    /// group and swap in the new one when execute_nonblocking() reports
+    /// that it is ready.  It must not run concurrently with ReParameter
+    /// on the same group.
+    ShaderGroupRef PromoteInteractiveParameters (ShaderGroup &group,
+                                                 int priority=0);
+
     // Non-threadsafe versions of Parameter, Shader, ConnectShaders, and
     // ShaderGroupEnd. These depend on some persistent state about which
     // shader group is the "current" one being amended. It's fine to use
@@ -719,6 +790,13 @@ public:
     ///
     std::string getstats (int level=1) const;
 
+    /// Make every ShadingContext forget the attribute values it has
+    /// remembered because RendererServices::attribute_invariance said they
+    /// were invariant per object or per group.  Call this if the renderer
+    /// changes such an attribute while keeping the same objdata.  (Values
+    /// already constant folded into compiled groups are not affected.)
+    void invalidate_attribute_cache ();
+
     void register_closure (string_view name, int id, const ClosureParam *params,
                            PrepareClosureFunc prepare, SetupClosureFunc setup);
 
@@ -764,6 +842,50 @@ public:
     /// specified number of threads (0 means use all available HW cores).
     void optimize_all_groups (int nthreads=0, bool do_jit = true);
 
+    /// A function that runs `work` concurrently on `nworkers` threads
+    /// (the calling thread may be one of them) and returns only once all
+    /// of them have finished, for example by way of the renderer's own
+    /// task scheduler.
+    typedef std::function<void(int nworkers, const std::function<void()> &work)> Executor;
+
+    /// Like optimize_all_groups(nthreads,do_jit), but let the executor
+    /// provide the threads rather than OSL's internal thread pool.
+    void optimize_all_groups (const Executor &executor, int nthreads=0,
+                              bool do_jit = true);
+
+    /// Queue the group to be optimized and JITed by the ShadingSystem's
+    /// background compile threads (see the "async_jit_threads" attribute),
+    /// without blocking the caller. Groups with higher priority are
+    /// compiled first; requesting an already-queued group again with a
+    /// higher priority moves it up. Return true if the group is already
+    /// compiled and ready to execute, false if it was (or already had
+    /// been) queued.
+    bool compile_async (ShaderGroup *group, int priority = 0);
+
+    /// Remove the group from the background compile queue, if it is still
+    /// waiting there (a compile already in progress can't be stopped).
+    /// Return true if the group was dequeued.
+    bool cancel_compile_async (ShaderGroup *group);
+
+    /// Start opening the textures that the optimized group is known to
+    /// access (see "textures_needed" in getattribute) on a background
+    /// thread, as the "texture_warmup" attribute does automatically, at
+    /// that attribute's level or at least 1.  Textures that were already
+    /// warmed up are skipped.  If wait is true, return only when they
+    /// are all open, including any that an earlier warmup is still
+    /// opening.  Return false if the group is not yet optimized.
+    bool warmup_textures (ShaderGroup *group, bool wait = false);
+
+    /// Non-blocking version of execute(): if the group has not yet been
+    /// optimized and JITed, don't do that now on the calling thread, but
+    /// instead queue it with compile_async() at the given priority, set
+    /// `ready` to false and return false without running anything, so the
+    /// renderer can defer the shade or substitute a cheaper group.
+    /// Otherwise, set `ready` to true and behave just like execute().
+    bool execute_nonblocking (ShadingContext &ctx, ShaderGroup &group,
+                              ShaderGlobals &globals, bool &ready,
+                              int priority = 0, bool run = true);
+
     /// Return a pointer to the TextureSystem being used.
     TextureSystem * texturesys () const;
 
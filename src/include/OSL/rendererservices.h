@@ -16,6 +16,7 @@ class RendererServices;
 template<int WidthT>
 class BatchedRendererServices;
 class ShadingContext;
+class ShaderGroup;
 struct ShaderGlobals;
 
 // Tags for polymorphic dispatch
@@ -52,7 +53,9 @@ public:
 
     /// Given the name of a 'feature', return whether this RendererServices
     /// supports it. Feature names include:
-    ///    <none>
+    ///    "attribute_invariance"  attribute_invariance() is implemented,
+    ///                            and getattribute results may be cached
+    ///                            or constant folded accordingly.
     ///
     /// This allows some customization of JIT generated code based on the
     /// facilities and features of a particular renderer. It also allows
@@ -176,6 +179,36 @@ public:
                                       ustring object, TypeDesc type,
                                       ustring name, int index, void *val) { return false; }
 
+    /// Over how much of the scene is the value of an attribute guaranteed
+    /// not to change?
+    enum AttributeInvariance {
+        AttributeVaries,      ///< No guarantee (the default)
+        AttributePerObject,   ///< Same for every point with the same objdata
+        AttributePerGroup     ///< Same everywhere the group is executed
+    };
+
+    /// Tell the shading system how invariant the named attribute of the
+    /// named object (or of the shaded object, if object is empty) is when
+    /// looked up by the given shader group, so that it can avoid calling
+    /// get_attribute or get_array_attribute for it over and over.  This is
+    /// only consulted if supports("attribute_invariance") is true.  Each
+    /// ShadingContext remembers lookups separately for every combination
+    /// of group, object, attribute, type, array index and derivatives, and
+    /// asks once for each, but it only keeps a limited number of them and
+    /// may forget them all and ask again.  An AttributePerObject value is
+    /// reused while the context keeps shading points with the same
+    /// ShaderGlobals::objdata, an AttributePerGroup value for as long as
+    /// it is remembered (see also
+    /// ShadingSystem::invalidate_attribute_cache).  AttributePerGroup
+    /// attributes may in addition be folded into constants by the runtime
+    /// optimizer, which fetches them with a NULL ShaderGlobals as
+    /// described for get_attribute.
+    virtual AttributeInvariance attribute_invariance (ShaderGroup *group,
+                                                      ustring object,
+                                                      ustring name) {
+        return AttributeVaries;
+    }
+
     /// Get the named user-data from the current object and write it into
     /// 'val'. If derivatives is true, the derivatives should be written into val
     /// as well. Return false if no user-data with the given name and type was
@@ -327,6 +360,12 @@ public:
     /// but distances can be NULL.  If a derivs_offset > 0 is given,
     /// derivatives will be computed for distances (when provided).
     ///
+    /// The default implementation reads files ending in ".oslpc" (which
+    /// pointcloud_write creates for such names) itself: they store a
+    /// prebuilt k-d tree and are memory mapped, so they load instantly,
+    /// are shared between processes and are searched without locking.
+    /// Any other file is read with Partio, if OSL was built with it.
+    ///
     /// Return the number of points found, always < max_points
     virtual int pointcloud_search (ShaderGlobals *sg,
                                    ustring filename, const OSL::Vec3 &center,
@@ -478,6 +478,7 @@ public:
         , m_connected_down(false)
         , m_initialized(false)
         , m_lockgeom(false)
+        , m_interactive(false)
         , m_allowconnect(true)
         , m_renderer_output(false)
         , m_readonly(false)
@@ -490,6 +491,7 @@ public:
         , m_scope(0)
         , m_dataoffset(-1)
         , m_wide_dataoffset(-1)
+        , m_interactive_offset(-1)
         , m_initializers(0)
         , m_node(declaration_node)
         , m_alias(NULL)
@@ -614,6 +616,11 @@ public:
     void wide_dataoffset(int d) { m_wide_dataoffset = d; }
     int wide_dataoffset() const { return m_wide_dataoffset; }
 
+    /// Offset of an interactive param's value within its group's
+    /// interactive parameter block (-1 if not allocated there).
+    void interactive_offset(int d) { m_interactive_offset = d; }
+    int interactive_offset() const { return m_interactive_offset; }
+
     void initializers(int d) { m_initializers = d; }
     int initializers() const { return m_initializers; }
 
@@ -733,6 +740,9 @@ public:
     bool lockgeom() const { return m_lockgeom; }
     void lockgeom(bool lock) { m_lockgeom = lock; }
 
+    bool interactive() const { return m_interactive; }
+    void interactive(bool val) { m_interactive = val; }
+
     bool allowconnect() const { return m_allowconnect; }
     void allowconnect(bool val) { m_allowconnect = val; }
 
@@ -847,6 +857,7 @@ protected:
     unsigned m_connected_down : 1;   ///< Connected to a later/downstream layer
     unsigned m_initialized : 1;      ///< If a param, has it been initialized?
     unsigned m_lockgeom : 1;         ///< Is the param not overridden by geom?
+    unsigned m_interactive : 1;      ///< May the param be edited post-opt?
     unsigned m_allowconnect : 1;     ///< Is the param not overridden by geom?
     unsigned m_renderer_output : 1;  ///< Is this sym a renderer output?
     unsigned m_readonly : 1;         ///< read-only symbol
@@ -859,6 +870,7 @@ protected:
     int m_scope;                  ///< Scope where this symbol was declared
     int m_dataoffset;             ///< Offset of the data (-1 for unknown)
     int m_wide_dataoffset;        ///< Offset of the wide data (-1 for unknown)
+    int m_interactive_offset;     ///< Offset in the interactive param block
     int m_initializers;           ///< Number of default initializers
     ASTNode* m_node;              ///< Ptr to the declaration of this symbol
     Symbol* m_alias;              ///< Another symbol that this is an alias for
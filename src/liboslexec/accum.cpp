@@ -86,20 +86,30 @@ AccumAutomata::compile()
     DfAutomata dfautomata;
     ndfautoToDfauto(ndfautomata, dfautomata);
     m_dfoptautomata.compileFrom(dfautomata);
-}
-
-
 
-void
-AccumAutomata::accum(int state, const Color3 &color, std::vector<AovOutput> &outputs)const
-{
-    // get the rules field, the underlying type is a std::vector
-    int nrules = 0;
-    void * const * rules = getRulesInState(state, nrules);
-    // Iterate the vector
-    for (int i = 0; i < nrules; ++i)
-        // Let the accumulator rule do its job
-        ((AccumRule *)(rules[i]))->accum(color, outputs);
+    // Resolve the rules of every state to the output indices they write,
+    // so accumulating doesn't have to chase the rule pointers
+    int nstates = m_dfoptautomata.numStates();
+    m_state_targets.resize(nstates);
+    m_targets.clear();
+    for (int s = 0; s < nstates; ++s) {
+        int nrules = 0;
+        void * const * rules = getRulesInState(s, nrules);
+        StateTargets &st = m_state_targets[s];
+        st.begin = int(m_targets.size());
+        st.ncolor = st.nalpha = 0;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int i = 0; i < nrules; ++i) {
+                const AccumRule *rule = (const AccumRule *)rules[i];
+                if (rule->toAlpha() != (pass == 1))
+                    continue;
+                m_targets.push_back(rule->getOutputIndex());
+                (pass ? st.nalpha : st.ncolor)++;
+            }
+        }
+    }
+    // pad so that &m_targets[begin] is valid for trailing empty states
+    m_targets.push_back(0);
 }
 
 
@@ -116,6 +126,8 @@ Accumulator::Accumulator(const AccumAutomata *accauto)
 
     // 0 is our initial state always
     m_state = 0;
+    // Room for any reasonable path depth, so pushState won't reallocate
+    m_stack.reserve(64);
 }
 
 
@@ -135,7 +147,7 @@ void
 Accumulator::pushState()
 {
     OSL_ASSERT (m_state >= 0);
-    m_stack.push(m_state);
+    m_stack.push_back(m_state);
 }
 
 
@@ -144,8 +156,8 @@ void
 Accumulator::popState()
 {
     OSL_ASSERT (m_stack.size());
-    m_state = m_stack.top();
-    m_stack.pop();
+    m_state = m_stack.back();
+    m_stack.pop_back();
 }
 
 
@@ -0,0 +1,98 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/imageworks/OpenShadingLanguage
+
+// Microbenchmark for the LPE accumulator: the same rules and light paths
+// as accum_test, timed instead of checked.
+
+#include <algorithm>
+#include <vector>
+
+#include <OSL/accum.h>
+#include <OSL/oslclosure.h>
+#include <OpenImageIO/benchmark.h>
+
+using namespace OSL;
+
+
+// Swallows everything; we only want to time the automata
+class NullAov final : public Aov
+{
+    public:
+        virtual void write(void * /*flush_data*/, Color3 & /*color*/,
+                           float /*alpha*/, bool /*has_color*/,
+                           bool /*has_alpha*/) {}
+};
+
+
+
+int main()
+{
+    const char *rules[] = { "C[SG]*D*L", "C[SG]*D{2,3}L", "C[SG]*D*<L.'3'>",
+                            "C[SG]*<.D'1'>D*L", "C<.[SG]>+D*L", "CD+L",
+                            "CD+<Ts>L", "C<R[^D]>+D*L", "C([SG]*D){1,2}L",
+                            "CDY+U", NULL };
+    const char *test[][16] = {
+        { "C_", "TS",  "TS", "RD", "L_", NULL },
+        { "C_", "TS",  "TS", "RD", "RG", "L_", NULL },
+        { "C_", "TS",  "TS", "RD", "RD", "L_", NULL },
+        { "C_", "RG",  "RD", "RG", "RD", "RG", "RD", "L_", NULL },
+        { "C_", "RG",  "RD", "RG", "RD", "L_", NULL },
+        { "C_", "RD",  "RD", "L_", NULL },
+        { "C_", "RD",  "RS", "RD", "L_", NULL },
+        { "C_", "RD",  "Ts", "L_", NULL },
+        { "C_", "TS",  "TS", "RD", "L_3", NULL },
+        { "C_", "RD1", "RD", "L_", NULL },
+        { "C_", "RS",  "RD", "RG", "L_", NULL },
+        { "C_", "RS",  "RD", "L_", NULL },
+        { "C_", "RD",  "RY", "RD", "U_", NULL },
+        { NULL } };
+
+    AccumAutomata automata;
+    automata.addEventType(ustring("U"));
+    automata.addScatteringType(ustring("Y"));
+    int naovs = 0;
+    for ( ; rules[naovs]; ++naovs)
+        automata.addRule(rules[naovs], naovs);
+    automata.compile();
+
+    std::vector<NullAov> aovs (naovs);
+    Accumulator accum (&automata);
+    for (int i = 0; i < naovs; ++i)
+        accum.setAov(i, &aovs[i], false, false);
+
+    // Intern the labels of every path ahead of time so that only the
+    // automata is measured
+    std::vector<std::vector<ustring>> paths;
+    for (int i = 0; test[i][0]; ++i) {
+        paths.emplace_back();
+        for (const char **events = test[i]; *events; ++events) {
+            for (const char *e = *events; *e; ++e)
+                paths.back().emplace_back(e, 1);
+            paths.back().push_back(Labels::STOP);
+        }
+    }
+
+    using namespace OIIO;
+    Benchmarker bench;
+    bench ("Accumulator move+accum, all paths", [&](){
+        accum.begin();
+        for (const auto& labels : paths) {
+            accum.pushState();
+            for (ustring label : labels)
+                accum.move(label);
+            accum.accum(Color3(1, 1, 1));
+            accum.popState();
+        }
+        DoNotOptimize (accum.getOutput(0));
+    });
+    bench ("AccumAutomata getTransition, all paths", [&](){
+        int state = 0;
+        for (const auto& labels : paths)
+            for (ustring label : labels)
+                state = std::max(0, automata.getTransition(state, label));
+        DoNotOptimize (state);
+    });
+
+    return 0;
+}
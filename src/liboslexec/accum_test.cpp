@@ -170,5 +170,52 @@ int main()
     OIIO_CHECK_ASSERT(aovs[nocaustic   ].check());
 
     std::cout << "Light expressions check OK" << std::endl;
+
+    // The dense per-state target lists that AccumAutomata::accum walks
+    // must add up to the same thing as the rules of each state. Visit
+    // every state the test paths reach, plus where a label that no rule
+    // mentions leads from each of them.
+    std::vector<int> states { 0 };
+    for (int i = 0; test[i].path[0]; ++i) {
+        int state = 0;
+        for (const char **events = test[i].path; *events && state >= 0; ++events) {
+            for (const char *e = *events; *e && state >= 0; ++e) {
+                state = automata.getTransition(state, ustring(e, 1));
+                if (state >= 0)
+                    states.push_back(state);
+            }
+            if (state >= 0)
+                state = automata.getTransition(state, Labels::STOP);
+            if (state >= 0)
+                states.push_back(state);
+        }
+    }
+    for (size_t i = 0, n = states.size(); i < n; ++i) {
+        int state = automata.getTransition(states[i], ustring("Q"));
+        if (state >= 0)
+            states.push_back(state);
+    }
+    for (int state : states) {
+        std::vector<AovOutput> dense(naovs), byrule(naovs);
+        for (auto outputs : { &dense, &byrule })
+            for (auto& out : *outputs) {
+                out.color = Color3(0, 0, 0);
+                out.alpha = 0;
+                out.has_color = out.has_alpha = false;
+            }
+        Color3 color(0.25f, 0.5f, 1.0f);
+        automata.accum(state, color, dense);
+        int nrules = 0;
+        void* const* rules = automata.getRulesInState(state, nrules);
+        for (int r = 0; r < nrules; ++r)
+            ((const AccumRule*)rules[r])->accum(color, byrule);
+        for (int o = 0; o < naovs; ++o) {
+            OIIO_CHECK_EQUAL(dense[o].has_color, byrule[o].has_color);
+            OIIO_CHECK_EQUAL(dense[o].has_alpha, byrule[o].has_alpha);
+            OIIO_CHECK_ASSERT(dense[o].color == byrule[o].color);
+            OIIO_CHECK_EQUAL(dense[o].alpha, byrule[o].alpha);
+        }
+    }
+
     return unit_test_failures;
 }
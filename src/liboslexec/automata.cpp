@@ -592,44 +592,52 @@ ndfautoToDfauto(const NdfAutomata &ndfautomata, DfAutomata &dfautomata)
 
 
 
-bool
-DfOptimizedAutomata::Transition::trans_comp (const DfOptimizedAutomata::Transition &a, const DfOptimizedAutomata::Transition &b)
-{
-    return a.symbol.data() < b.symbol.data();
-}
-
-
-
 void
 DfOptimizedAutomata::compileFrom(const DfAutomata &dfautomata)
 {
-    m_states.resize(dfautomata.m_states.size());
-    size_t totaltrans = 0;
+    const size_t nstates = dfautomata.m_states.size();
+
+    // Intern every symbol that has an explicit transition somewhere
+    SymbolToInt symbolids;
+    for (size_t s = 0; s < nstates; ++s)
+        for (const auto& t : dfautomata.m_states[s]->m_symbol_trans)
+            symbolids.emplace(t.first, int(symbolids.size()));
+    m_nsymbols = int(symbolids.size()) + 1;
+    const int other = m_nsymbols - 1;
+
+    // Hash the symbols into a table at most half full
+    size_t nslots = 8;
+    while (nslots < 2 * symbolids.size())
+        nslots *= 2;
+    m_symbol_slots.assign(nslots, SymbolSlot { nullptr, other });
+    const size_t mask = nslots - 1;
+    for (const auto& i : symbolids) {
+        size_t slot = i.first.hash() & mask;
+        while (m_symbol_slots[slot].symbol)
+            slot = (slot + 1) & mask;
+        m_symbol_slots[slot].symbol = i.first.c_str();
+        m_symbol_slots[slot].id = i.second;
+    }
+
+    // Dense transitions, anything not explicit follows the wildcard
+    m_states.resize(nstates);
+    m_trans.resize(nstates * m_nsymbols);
     size_t totalrules = 0;
-    for (size_t s = 0; s < m_states.size(); ++s) {
-        totaltrans += dfautomata.m_states[s]->m_symbol_trans.size();
+    for (size_t s = 0; s < nstates; ++s)
         totalrules += dfautomata.m_states[s]->m_rules.size();
-    }
-    m_trans.resize(totaltrans);
     m_rules.resize(totalrules);
-    size_t trans_offset = 0;
     size_t rules_offset = 0;
-    for (size_t s = 0; s < m_states.size(); ++s) {
-        m_states[s].begin_trans = trans_offset;
+    for (size_t s = 0; s < nstates; ++s) {
+        const DfAutomata::State *dfstate = dfautomata.m_states[s];
+        int *row = &m_trans[s * m_nsymbols];
+        std::fill(row, row + m_nsymbols, dfstate->m_wildcard_trans);
+        for (const auto& t : dfstate->m_symbol_trans)
+            row[symbolids[t.first]] = t.second;
         m_states[s].begin_rules = rules_offset;
-        for (SymbolToInt::const_iterator i = dfautomata.m_states[s]->m_symbol_trans.begin();
-              i != dfautomata.m_states[s]->m_symbol_trans.end(); ++i, ++trans_offset) {
-            m_trans[trans_offset].symbol = i->first;
-            m_trans[trans_offset].state = i->second;
-        }
-        for (RuleSet::const_iterator i = dfautomata.m_states[s]->m_rules.begin();
-              i != dfautomata.m_states[s]->m_rules.end(); ++i, ++rules_offset)
+        m_states[s].nrules = dfstate->m_rules.size();
+        for (RuleSet::const_iterator i = dfstate->m_rules.begin();
+              i != dfstate->m_rules.end(); ++i, ++rules_offset)
             m_rules[rules_offset] = *i;
-        m_states[s].ntrans = dfautomata.m_states[s]->m_symbol_trans.size();
-        m_states[s].nrules = dfautomata.m_states[s]->m_rules.size();
-        std::sort(m_trans.begin() + m_states[s].begin_trans, m_trans.begin() + m_states[s].begin_trans + m_states[s].ntrans,
-                     DfOptimizedAutomata::Transition::trans_comp);
-        m_states[s].wildcard_trans = dfautomata.m_states[s]->m_wildcard_trans;
     }
 }
 
@@ -81,6 +81,11 @@ BackendLLVM::BackendLLVM (ShadingSystemImpl &shadingsys,
     ll.dumpasm(shadingsys.m_llvm_dumpasm);
     ll.jit_fma(shadingsys.m_llvm_jit_fma);
     ll.jit_aggressive(shadingsys.m_llvm_jit_aggressive);
+    // Cached object code must not depend on where this process happened
+    // to put its strings.
+    ll.relocatable_constants(shadingsys.m_jit_cache_dir.size() && !m_use_optix);
+    // The group owns its machine code, so it is freed when the group is.
+    ll.own_jit_code(true);
 }
 
 
@@ -306,6 +311,66 @@ BackendLLVM::getOrAllocateLLVMSymbol (const Symbol& sym)
 
 
 
+llvm::GlobalVariable *
+BackendLLVM::llvm_constant_data_placeholder (size_t size)
+{
+    llvm::Type *type = llvm::ArrayType::get (ll.type_char(), size);
+    return new llvm::GlobalVariable (*ll.module(), type, true,
+                                     llvm::GlobalValue::PrivateLinkage,
+                                     nullptr, "constant data placeholder");
+}
+
+
+
+llvm::GlobalVariable *
+BackendLLVM::llvm_intern_constant_data (llvm::GlobalVariable *global,
+                                        const void *data, int align)
+{
+    size_t size = global->getValueType()->getArrayNumElements();
+    llvm::StringRef bytes ((const char *)data, size);
+    // Name the global by a hash of its bytes, stepping past the (very
+    // unlikely) globals whose name matches but whose bytes don't.
+    for (size_t h = Strutil::strhash (string_view (bytes.data(), size)); ; ++h) {
+        std::string name = Strutil::sprintf ("osl.constdata.%016x", h);
+        llvm::GlobalVariable *g = ll.module()->getGlobalVariable (name, true);
+        if (! g) {
+            global->setInitializer (llvm::ConstantDataArray::get (
+                ll.context(), llvm::ArrayRef<uint8_t>((const uint8_t *)data, size)));
+            global->setName (name);
+            global->setUnnamedAddr (llvm::GlobalValue::UnnamedAddr::Global);
+#if OSL_LLVM_VERSION >= 100
+            global->setAlignment (llvm::MaybeAlign(align));
+#else
+            global->setAlignment (align);
+#endif
+            return global;
+        }
+        auto existing = llvm::dyn_cast<llvm::ConstantDataSequential>(g->getInitializer());
+        if (existing && existing->getRawDataValues() == bytes) {
+            global->replaceAllUsesWith (g);
+            global->eraseFromParent ();
+            return g;
+        }
+    }
+}
+
+
+
+llvm::Value *
+BackendLLVM::llvm_texture_options_alloca ()
+{
+    // The alloca itself is in the entry block, so it may be used from
+    // anywhere in the function.
+    if (m_texture_options_func != ll.current_function()) {
+        m_texture_options = ll.op_alloca (ll.type_char(), sizeof(TextureOpt),
+                                          "texture options", 16);
+        m_texture_options_func = ll.current_function();
+    }
+    return ll.void_ptr (m_texture_options);
+}
+
+
+
 llvm::Value*
 BackendLLVM::addCUDAVariable(const std::string& name, int size, int alignment,
                              const void* data, TypeDesc type)
@@ -522,6 +587,32 @@ BackendLLVM::getOrAllocateCUDAVariable (const Symbol& sym, bool addMetadata)
 
 
 
+llvm::Value *
+BackendLLVM::llvm_constant_data_ptr (const Symbol& sym, const void *data)
+{
+    if (! ll.relocatable_constants())
+        return ll.constant_ptr ((void *)data);
+    TypeDesc t = sym.typespec().simpletype();
+    if (t.basetype == TypeDesc::STRING) {
+        // An array of the (relocatable) ustring constants
+        size_t n = t.numelements() * t.aggregate;
+        std::vector<llvm::Constant *> strings (n);
+        for (size_t i = 0;  i < n;  ++i)
+            strings[i] = llvm::cast<llvm::Constant> (
+                             ll.constant (((const ustring *)data)[i]));
+        llvm::ArrayType *type = llvm::ArrayType::get (ll.type_string(), n);
+        llvm::GlobalVariable *g = new llvm::GlobalVariable (
+            *ll.module(), type, true, llvm::GlobalValue::PrivateLinkage,
+            llvm::ConstantArray::get (type, strings), "constant strings");
+        g->setUnnamedAddr (llvm::GlobalValue::UnnamedAddr::Global);
+        return ll.void_ptr (g);
+    }
+    llvm::GlobalVariable *g = llvm_constant_data_placeholder (t.size());
+    return ll.void_ptr (llvm_intern_constant_data (g, data, (int)t.basesize()));
+}
+
+
+
 llvm::Value *
 BackendLLVM::llvm_get_pointer (const Symbol& sym, int deriv,
                                llvm::Value *arrayindex)
@@ -549,7 +640,7 @@ BackendLLVM::llvm_get_pointer (const Symbol& sym, int deriv,
         }
         else {
             // For constants, start with *OUR* pointer to the constant values.
-            result = ll.ptr_cast (ll.constant_ptr (sym.data()),
+            result = ll.ptr_cast (llvm_constant_data_ptr (sym, sym.data()),
                                   ll.type_ptr (llvm_type(sym.typespec().elementtype())));
         }
 
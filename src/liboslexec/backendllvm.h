@@ -42,6 +42,15 @@ public:
     virtual void run ();
 
 
+    /// JIT the group again from the module saved by a quick first-tier
+    /// run(), this time at the full llvm_optimize level, and publish the
+    /// new entry points in place of the old ones.
+    void run_tier_up ();
+
+    /// The llvm_optimize level run() will use: the quick tier's level
+    /// when tiered JIT is on, otherwise the ShadingSystem's llvm_optimize.
+    int llvm_optimize_level();
+
     /// What LLVM debug level are we at?
     int llvm_debug() const;
 
@@ -49,6 +58,10 @@ public:
     ///
     void initialize_llvm_group ();
 
+    /// Return the name under which the current (pruned, not yet
+    /// optimized) module's object code is stored in the JIT cache.
+    std::string jit_cache_key ();
+
     int layer_remap (int origlayer) const { return m_layer_remap[origlayer]; }
 
     /// Create an llvm function for the current shader instance.
@@ -75,6 +88,13 @@ public:
     llvm::Value *llvm_get_pointer (const Symbol& sym, int deriv=0,
                                    llvm::Value *arrayindex=NULL);
 
+    /// Return an llvm::Value* holding the address of data, which are
+    /// values of sym's type (its constant value, or a default).  If the
+    /// code must not refer to this process's addresses (see
+    /// LLVM_Util::relocatable_constants), it points to a copy of the
+    /// values kept in the module instead.
+    llvm::Value *llvm_constant_data_ptr (const Symbol& sym, const void *data);
+
     /// Return the llvm::Value* corresponding to the given element
     /// value, with derivative (0=value, 1=dx, 2=dy), array index (NULL
     /// if it's not an array), and component (x=0 or scalar, y=1, z=2).
@@ -419,6 +439,23 @@ public:
     /// Return the mapping from symbol names to GlobalVariables.
     std::map<std::string,llvm::GlobalVariable*>& get_const_map() { return m_const_map; }
 
+    /// Return a private constant global of 'size' bytes whose contents
+    /// aren't known yet, so that code can already refer to it.  Finish it
+    /// with llvm_intern_constant_data once they are.
+    llvm::GlobalVariable *llvm_constant_data_placeholder (size_t size);
+
+    /// Give a global from llvm_constant_data_placeholder its contents.  If
+    /// the module already has a global with the same bytes, uses of
+    /// 'global' move to that one and 'global' is erased.  The name only
+    /// depends on the bytes, so equal groups still make equal modules.
+    /// Return the global that holds the bytes.
+    llvm::GlobalVariable *llvm_intern_constant_data (llvm::GlobalVariable *global,
+                                                     const void *data, int align);
+
+    /// Return the TextureOpt on the stack of the current function that
+    /// every texture call in the function fills in.
+    llvm::Value *llvm_texture_options_alloca ();
+
     /// Return whether or not we are compiling for an OptiX-based renderer.
     bool use_optix() { return m_use_optix; }
 
@@ -456,6 +493,10 @@ private:
     // A mapping from symbol names to llvm::GlobalVariables
     std::map<std::string,llvm::GlobalVariable*> m_const_map;
 
+    // The TextureOpt alloca of m_texture_options_func
+    llvm::Value *m_texture_options = nullptr;
+    llvm::Function *m_texture_options_func = nullptr;
+
     // A mapping from canonical strings to string variable names, used to
     // detect collisions that might occur due to using the string hash to
     // create variable names.
@@ -117,13 +117,14 @@ DECL (osl_mul_closure_color, "CXCc")
 DECL (osl_allocate_closure_component, "CXii")
 DECL (osl_allocate_weighted_closure_component, "CXiiX")
 DECL (osl_closure_to_string, "sXC")
-DECL (osl_format, "ss*")
+DECL (osl_format, "sXs*")
 DECL (osl_printf, "xXs*")
 DECL (osl_fprintf, "xXss*")
 DECL (osl_error, "xXs*")
 DECL (osl_warning, "xXs*")
-DECL (osl_split, "isXsii")
+DECL (osl_split, "iXsXsii")
 DECL (osl_incr_layers_executed, "xX")
+DECL (osl_profile_line, "xXi")
 
 NOISE_IMPL(cellnoise)
 //NOISE_DERIV_IMPL(cellnoise)
@@ -212,6 +213,7 @@ DECL (osl_naninf_check, "xiXiXXiXiiX")
 DECL (osl_uninit_check, "xLXXXiXiXXiXiXii")
 DECL (osl_get_attribute, "iXiXXiiXX")
 DECL (osl_bind_interpolated_param, "iXXLiXiXiXi")
+DECL (osl_get_interactive_params, "XX")
 DECL (osl_get_texture_options, "XX");
 DECL (osl_get_noise_options, "XX");
 DECL (osl_get_trace_options, "XX");
@@ -327,7 +329,7 @@ DECL (osl_get_from_to_matrix, "iXXss")
 DECL (osl_transpose_mm, "xXX")
 DECL (osl_determinant_fm, "fX")
 
-DECL (osl_concat_sss, "sss")
+DECL (osl_concat_sss, "sXss")
 DECL (osl_strlen_is, "is")
 DECL (osl_hash_is, "is")
 DECL (osl_getchar_isi, "isi");
@@ -335,8 +337,9 @@ DECL (osl_startswith_iss, "iss")
 DECL (osl_endswith_iss, "iss")
 DECL (osl_stoi_is, "is")
 DECL (osl_stof_fs, "fs")
-DECL (osl_substr_ssii, "ssii")
+DECL (osl_substr_ssii, "sXsii")
 DECL (osl_regex_impl, "iXsXisi")
+DECL (osl_regex_compiled_impl, "isXiXi")
 
 DECL (osl_texture_set_firstchannel, "xXi")
 DECL (osl_texture_set_swrap, "xXs")
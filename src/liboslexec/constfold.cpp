@@ -1396,21 +1396,41 @@ DECLFOLDER(constfold_substr)
 
 
 
-DECLFOLDER(constfold_regex_search)
+DECLFOLDER(constfold_regex)
 {
-    // Try to turn R=regex_search(subj,reg) into R=C
+    // Try to turn R=regex_search(subj,reg) or R=regex_match(subj,reg)
+    // into R=C, and likewise the versions that also return results[],
+    // which additionally get results=C2.
     Opcode &op (rop.inst()->ops()[opnum]);
+    bool do_match_results = (op.nargs() == 4);
     Symbol &Subj (*rop.inst()->argsymbol(op.firstarg()+1));
-    Symbol &Reg (*rop.inst()->argsymbol(op.firstarg()+2));
-    if (op.nargs() == 3 // only the 2-arg version without search results
-          && Subj.is_constant() && Reg.is_constant()) {
+    Symbol &Reg (*rop.inst()->argsymbol(op.firstarg()+2+do_match_results));
+    if (Subj.is_constant() && Reg.is_constant()) {
         OSL_DASSERT(Subj.typespec().is_string() && Reg.typespec().is_string());
-        ustring s (Subj.get_string());
-        ustring r (Reg.get_string());
-        regex reg (r.string());
-        int result = regex_search (s.string(), reg);
-        int cind = rop.add_constant (result);
-        rop.turn_into_assign (op, cind, "const fold regex_search");
+        bool fullmatch = (op.opname() == "regex_match");
+        const CompiledRegex &regex (rop.shadingsys().find_regex (Reg.get_string()));
+        int result;
+        if (do_match_results) {
+            int matcharg = rop.inst()->args()[op.firstarg()+2];
+            const TypeSpec &matchtype (rop.inst()->symbol(matcharg)->typespec());
+            if (matchtype.arraylength() <= 0)
+                return 0;   // unsized array, leave it for runtime
+            std::vector<int> results (matchtype.arraylength());
+            result = regex.match (Subj.get_string(), results.data(),
+                                  (int)results.size(), fullmatch);
+            rop.turn_into_assign (op, rop.add_constant (result),
+                                  "const fold regex");
+            const int args_to_add[] = {
+                matcharg, rop.add_constant (matchtype, results.data())
+            };
+            rop.insert_code (opnum, u_assign, args_to_add,
+                             RuntimeOptimizer::RecomputeRWRanges,
+                             RuntimeOptimizer::GroupWithNext);
+        } else {
+            result = regex.match (Subj.get_string(), NULL, 0, fullmatch);
+            rop.turn_into_assign (op, rop.add_constant (result),
+                                  "const fold regex");
+        }
         return 1;
     }
     return 0;
@@ -2273,11 +2293,15 @@ DECLFOLDER(constfold_getattribute)
         // If the object name is not supplied, it implies that we are
         // supposed to search the shaded object first, then if that fails,
         // the scene-wide namespace.  We can't do that yet, have to wait
-        // until shade time.
+        // until shade time -- unless the renderer promises that the
+        // attribute is the same wherever this group is run.
         ustring obj_name;
         if (object_lookup)
             obj_name = ObjectName.get_string();
-        if (obj_name.empty())
+        if (obj_name.empty() &&
+            ! (rop.shadingsys().use_attribute_invariance() &&
+               rop.renderer()->attribute_invariance (&rop.group(), obj_name, attr_name)
+                   == RendererServices::AttributePerGroup))
             return 0;
 
         found = array_lookup
@@ -2,9 +2,12 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/imageworks/OpenShadingLanguage
 
+#include <algorithm>
+#include <limits>
 #include <vector>
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <cstdint>
 
 #include <OpenImageIO/sysutil.h>
@@ -37,7 +40,7 @@ ShadingContext::ShadingContext (ShadingSystemImpl &shadingsys,
                                 PerThreadInfo *threadinfo)
     : m_shadingsys(shadingsys), m_renderer(m_shadingsys.renderer()),
       m_group(NULL), m_max_warnings(shadingsys.max_warnings_per_thread()),
-      m_dictionary(NULL), batch_size_executed(0)
+      batch_size_executed(0)
 {
     m_shadingsys.m_stat_contexts += 1;
     m_threadinfo = threadinfo ? threadinfo : shadingsys.get_perthread_info ();
@@ -49,6 +52,7 @@ ShadingContext::ShadingContext (ShadingSystemImpl &shadingsys,
 ShadingContext::~ShadingContext ()
 {
     process_errors ();
+    flush_runtime_stats ();
     m_shadingsys.m_stat_contexts -= 1;
     free_dict_resources ();
 }
@@ -63,6 +67,7 @@ ShadingContext::execute_init (ShaderGroup &sgroup, ShaderGlobals &ssg, bool run)
     batch_size_executed = 0;
     m_group = &sgroup;
     m_ticks = 0;
+    clear_matrix_cache ();
 
     // Optimize if we haven't already
     if (sgroup.nlayers()) {
@@ -76,6 +81,9 @@ ShadingContext::execute_init (ShaderGroup &sgroup, ShaderGlobals &ssg, bool run)
             }
             shadingsys().release_context(ctx);
         }
+        // Quick-JITed groups count their way to a fully optimized re-JIT.
+        if (sgroup.m_tierup_countdown > 0 && --sgroup.m_tierup_countdown == 0)
+            shadingsys().request_tier_up (sgroup);
         if (sgroup.does_nothing())
             return false;
     } else {
@@ -115,6 +123,8 @@ ShadingContext::execute_init (ShaderGroup &sgroup, ShaderGlobals &ssg, bool run)
         run_func (&ssg, m_heap.get());
     }
 
+    if (profile > 1)
+        profile_line (-1);   // stop timing the last source line
     if (profile)
         m_ticks += timer.ticks();
     return true;
@@ -138,6 +148,8 @@ ShadingContext::execute_layer (ShaderGlobals &ssg, int layernumber)
 
     run_func (&ssg, m_heap.get());
 
+    if (profile > 1)
+        profile_line (-1);
     if (profile)
         m_ticks += timer.ticks();
 
@@ -157,17 +169,128 @@ ShadingContext::execute_cleanup ()
     // Process any queued up error messages, warnings, printfs from shaders
     process_errors ();
 
-    if (shadingsys().m_profile) {
-        record_runtime_stats ();   // Transfer runtime stats to the shadingsys
-        shadingsys().m_stat_total_shading_time_ticks += m_ticks;
-        group()->m_stat_total_shading_time_ticks += m_ticks;
-    }
+    if (shadingsys().m_profile)
+        record_runtime_stats ();   // Accumulate until flush_runtime_stats
 
     return true;
 }
 
 
 
+void
+ShadingContext::record_runtime_stats ()
+{
+    m_pending_get_userdata_calls += m_stat_get_userdata_calls;
+    m_pending_layers_executed += m_stat_layers_executed;
+    m_pending_ticks += m_ticks;
+    // Renderers tend to run the same group many times in a row, so
+    // remember the slot of the last one rather than hashing every time.
+    ustring groupname = group()->name();
+    if (! m_pending_group_slot || groupname != m_pending_group_name) {
+        m_pending_group_slot = &m_pending_group_ticks[groupname];
+        m_pending_group_name = groupname;
+    }
+    *m_pending_group_slot += m_ticks;
+}
+
+
+
+// Defined below; what the generated code calls at each profile=2 probe.
+OSL_SHADEOP void osl_profile_line (ShaderGlobals *sg, int site);
+
+long long
+ShadingContext::measure_profile_line_overhead ()
+{
+    // Go through the same shadeop the generated code calls, billing a
+    // scratch site with this context's own line times set aside.  Take
+    // the best of a few rounds, to leave out preemption and the like.
+    std::vector<std::pair<long long,long long>> saved_times;
+    std::swap (saved_times, m_pending_line_times);
+    int saved_site = m_profile_site;
+    long long saved_mark = m_profile_mark;
+    ShaderGlobals sg;
+    memset ((void *)&sg, 0, sizeof(ShaderGlobals));
+    sg.context = this;
+    const int rounds = 5, probes = 1000;
+    long long best = std::numeric_limits<long long>::max();
+    for (int r = 0;  r < rounds;  ++r) {
+        m_pending_line_times.clear ();
+        m_profile_site = -1;
+        for (int i = 0;  i <= probes;  ++i)
+            osl_profile_line (&sg, 0);
+        best = std::min (best, m_pending_line_times[0].first / probes);
+    }
+    std::swap (saved_times, m_pending_line_times);
+    m_profile_site = saved_site;
+    m_profile_mark = saved_mark;
+    return best;
+}
+
+
+
+void
+ShadingContext::flush_runtime_stats ()
+{
+    if (m_pending_get_userdata_calls)
+        shadingsys().m_stat_get_userdata_calls += m_pending_get_userdata_calls;
+    if (m_pending_layers_executed)
+        shadingsys().m_stat_layers_executed += m_pending_layers_executed;
+    if (m_pending_ticks)
+        shadingsys().m_stat_total_shading_time_ticks += m_pending_ticks;
+    if (m_pending_getattribute_calls)
+        shadingsys().m_stat_getattribute_calls += m_pending_getattribute_calls;
+    if (m_pending_getattribute_cache_hits)
+        shadingsys().m_stat_getattribute_cache_hits += m_pending_getattribute_cache_hits;
+    if (m_pending_matrix_cache_hits)
+        shadingsys().m_stat_matrix_cache_hits += m_pending_matrix_cache_hits;
+    if (m_pending_matrix_cache_misses)
+        shadingsys().m_stat_matrix_cache_misses += m_pending_matrix_cache_misses;
+    if (m_pending_string_cache_hits)
+        shadingsys().m_stat_string_cache_hits += m_pending_string_cache_hits;
+    if (m_pending_string_cache_misses)
+        shadingsys().m_stat_string_cache_misses += m_pending_string_cache_misses;
+    long long line_overhead = 0;
+    if (! m_pending_line_times.empty()) {
+        // Don't bill the lines for the probes that timed them.
+        line_overhead = shadingsys().m_profile_line_overhead;
+        if (line_overhead < 0) {
+            line_overhead = measure_profile_line_overhead ();
+            shadingsys().m_profile_line_overhead = line_overhead;
+        }
+    }
+    if (! m_pending_group_ticks.empty() || m_pending_getattribute_time > 0
+          || ! m_pending_line_times.empty()) {
+        spin_lock lock (shadingsys().m_stat_mutex);
+        for (auto&& gt : m_pending_group_ticks)
+            shadingsys().m_group_profile_times[gt.first] += gt.second;
+        auto &sites (shadingsys().m_profile_sites);
+        for (size_t i = 0, e = std::min (sites.size(), m_pending_line_times.size());  i < e;  ++i) {
+            const auto &t (m_pending_line_times[i]);
+            sites[i].nanoseconds += std::max (0LL, t.first - t.second * line_overhead);
+            sites[i].runs += t.second;
+        }
+        shadingsys().m_stat_getattribute_time += m_pending_getattribute_time;
+        shadingsys().m_stat_getattribute_fail_time += m_pending_getattribute_fail_time;
+    }
+    m_pending_get_userdata_calls = 0;
+    m_pending_layers_executed = 0;
+    m_pending_ticks = 0;
+    m_pending_matrix_cache_hits = 0;
+    m_pending_matrix_cache_misses = 0;
+    m_pending_string_cache_hits = 0;
+    m_pending_string_cache_misses = 0;
+    m_pending_getattribute_calls = 0;
+    m_pending_getattribute_cache_hits = 0;
+    m_pending_getattribute_time = 0;
+    m_pending_getattribute_fail_time = 0;
+    m_pending_group_ticks.clear ();
+    m_pending_group_slot = nullptr;
+    m_pending_group_name = ustring();
+    m_pending_line_times.clear ();
+}
+
+
+
 bool
 ShadingContext::execute (ShaderGroup &sgroup, ShaderGlobals &ssg, bool run)
 {
@@ -260,6 +383,9 @@ ShadingContext::Batched<WidthT>::execute_init
     // Clear miscellaneous scratch space
     context().m_scratch_pool.clear ();
 
+    // Forget transforms cached by a previous batch
+    context().clear_matrix_cache ();
+
     // Zero out stats for this execution
     context().clear_runtime_stats ();
 
@@ -279,6 +405,8 @@ ShadingContext::Batched<WidthT>::execute_init
         }
     }
 
+    if (profile > 1)
+        context().profile_line (-1);
     if (profile)
         context().m_ticks += timer.ticks();
     return true;
@@ -309,6 +437,8 @@ ShadingContext::Batched<WidthT>::execute_layer (int batch_size, BatchedShaderGlo
         run_func (&bsg, context().m_heap.get(), run_mask.value());
     }
 
+    if (profile > 1)
+        context().profile_line (-1);
     if (profile)
         context().m_ticks += timer.ticks();
 
@@ -484,17 +614,34 @@ ShadingContext::symbol_data (const Symbol &sym) const
 
 
 
-const regex &
+ustring
+ShadingContext::make_ustring (string_view s)
+{
+    size_t hash = Strutil::strhash (s);
+    StringCacheEntry &e (m_string_cache[hash & (string_cache_size - 1)]);
+    if (e.hash == hash && ! e.str.empty() && e.str.length() == s.size()
+          && memcmp (e.str.c_str(), s.data(), s.size()) == 0) {
+        ++m_pending_string_cache_hits;
+        return e.str;
+    }
+    ++m_pending_string_cache_misses;
+    e.hash = hash;
+    e.str = ustring (s);
+    return e.str;
+}
+
+
+
+const CompiledRegex &
 ShadingContext::find_regex (ustring r)
 {
     RegexMap::const_iterator found = m_regex_map.find (r);
     if (found != m_regex_map.end())
         return *found->second;
-    // otherwise, it wasn't found, add it
-    m_regex_map[r].reset (new regex(r.c_str()));
-    m_shadingsys.m_stat_regexes += 1;
-    // std::cerr << "Made new regex for " << r << "\n";
-    return *m_regex_map[r];
+    // otherwise, get it from the shading system and remember it
+    const CompiledRegex &regex (m_shadingsys.find_regex (r));
+    m_regex_map[r] = &regex;
+    return regex;
 }
 
 
@@ -506,10 +653,38 @@ ShadingContext::osl_get_attribute (ShaderGlobals *sg, void *objdata,
                                    int array_lookup, int index,
                                    TypeDesc attr_type, void *attr_dest)
 {
-#if 0
-    // Change the #if's below if you want to
-    OIIO::Timer timer;
-#endif
+    // Renderers that support "attribute_invariance" may let us remember
+    // results.  The invariance answers themselves are kept until the
+    // cache is invalidated; a new objdata only voids per-object values.
+    bool use_cache = shadingsys().use_attribute_invariance();
+    size_t size = attr_type.size() * (dest_derivs ? 3 : 1);
+    AttributeCacheKey key;
+    AttributeCacheEntry *entry = nullptr;
+    if (use_cache) {
+        int generation = shadingsys().m_attribute_cache_generation;
+        if (generation != m_attr_cache_generation) {
+            m_attr_cache.clear ();
+            m_attr_cache_data.clear ();
+            m_attr_cache_generation = generation;
+        }
+        key = { group()->id(), obj_name, attr_name, attr_type,
+                array_lookup ? index : -1, bool(dest_derivs) };
+        auto found = m_attr_cache.find (key);
+        if (found != m_attr_cache.end()) {
+            entry = &found->second;
+            if (entry->valid &&
+                (entry->invariance != RendererServices::AttributePerObject
+                 || entry->objdata == objdata)) {
+                ++m_pending_getattribute_cache_hits;
+                if (entry->ok)
+                    memcpy (attr_dest, &m_attr_cache_data[entry->offset], size);
+                return entry->ok;
+            }
+        }
+    }
+
+    int profile = shadingsys().m_profile;
+    OIIO::Timer timer (profile ? OIIO::Timer::StartNow : OIIO::Timer::DontStartNow);
     bool ok;
 
     if (array_lookup)
@@ -521,14 +696,38 @@ ShadingContext::osl_get_attribute (ShaderGlobals *sg, void *objdata,
                                         obj_name, attr_type,
                                         attr_name, attr_dest);
 
-#if 0
-    double time = timer();
-    shadingsys().m_stat_getattribute_time += time;
-    if (!ok)
-        shadingsys().m_stat_getattribute_fail_time += time;
-    shadingsys().m_stat_getattribute_calls += 1;
-#endif
-//    std::cout << "getattribute! '" << obj_name << "' " << attr_name << ' ' << attr_type.c_str() << " ok=" << ok << ", objdata was " << objdata << "\n";
+    ++m_pending_getattribute_calls;
+    if (profile) {
+        double time = timer();
+        m_pending_getattribute_time += time;
+        if (!ok)
+            m_pending_getattribute_fail_time += time;
+    }
+
+    if (use_cache) {
+        // The first time we see an attribute, ask whether it is worth
+        // remembering (and remember the answer either way).
+        if (! entry) {
+            if (m_attr_cache.size() >= max_cached_attributes) {
+                m_attr_cache.clear ();
+                m_attr_cache_data.clear ();
+            }
+            AttributeCacheEntry e;
+            e.invariance = renderer()->attribute_invariance (group(), obj_name,
+                                                             attr_name);
+            e.offset = m_attr_cache_data.size();
+            if (e.invariance != RendererServices::AttributeVaries)
+                m_attr_cache_data.resize (e.offset + size);
+            entry = &m_attr_cache.emplace (key, e).first->second;
+        }
+        if (entry->invariance != RendererServices::AttributeVaries) {
+            entry->ok = ok;
+            entry->valid = true;
+            entry->objdata = objdata;
+            if (ok)
+                memcpy (&m_attr_cache_data[entry->offset], attr_dest, size);
+        }
+    }
     return ok;
 }
 
@@ -541,6 +740,13 @@ osl_incr_layers_executed (ShaderGlobals *sg)
     ctx->incr_layers_executed ();
 }
 
+OSL_SHADEOP void
+osl_profile_line (ShaderGlobals *sg, int site)
+{
+    ShadingContext *ctx = (ShadingContext *)sg->context;
+    ctx->profile_line (site);
+}
+
 template class ShadingContext::Batched<16>;
 template class ShadingContext::Batched<8>;
 
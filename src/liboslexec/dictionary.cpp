@@ -8,6 +8,8 @@
 #include <cstdlib>
 #include <cctype>
 #include <unordered_map>
+#include <memory>
+#include <algorithm>
 
 #include <OpenImageIO/strutil.h>
 
@@ -32,21 +34,40 @@ namespace pvt {   // OSL::pvt
 // it, doing queries, and converting the string data to other types.
 //
 // But that is expensive, so we really cache all this stuff at several
-// levels.
+// levels, and we share it among all the ShadingContexts of a
+// ShadingSystem, since every thread tends to ask the same questions of
+// the same documents.
 //
 // We have parsed xml (as pugi::xml_document *'s) cached in a hash table,
 // looked up by the xml and/or dictionary name.  Either will do, if it
 // looks like a filename, it will read the XML from the file, otherwise it
 // will interpret it as xml directly.
 //
-// Also, individual queries are cached in a hash table.  The key is a
-// tuple of (nodeID, query_string, type_requested), so that asking for a
-// particular query to return a string is a totally different cache
-// entry than asking for it to be converted to a matrix, say.
+// Each distinct query string is compiled to a pugi::xpath_query just
+// once, no matter how many nodes or documents it is later applied to.
+//
+// Individual queries are cached in a hash table keyed on the tuple
+// (document, nodeID, query_string), and attribute values are decoded
+// once per (nodeID, attribute) into all of the representations a shader
+// may ask for (string, ints, floats), so that asking for the same value
+// as an int, a color, or a matrix shares one cache entry.
+//
+// Everything in the cache is immutable once it has been added, so the
+// common case (a hit) only needs a shared lock, and misses take the
+// exclusive lock and check again.  On top of that, each ShadingContext
+// keeps a DictionaryMemo of the answers it has already seen, so repeated
+// lookups from the same thread don't touch the shared lock at all.
 //
 class Dictionary {
 public:
-    Dictionary (ShadingContext *ctx) : m_context(ctx)
+    // The decoded contents of one node value or attribute.
+    struct Value {
+        ustring str;                // the raw string
+        std::vector<int> ints;      // comma/space separated ints
+        std::vector<float> floats;  // comma/space separated floats
+    };
+
+    Dictionary ()
     {
         // Create placeholder element 0 == 'not found'
         m_nodes.emplace_back(0, pugi::xml_node());
@@ -57,25 +78,38 @@ public:
             delete doc;
     }
 
-    int dict_find (ustring dictionaryname, ustring query);
-    int dict_find (int nodeID, ustring query);
+    // Both flavors of dict_find return the first matching nodeID (0 if
+    // not found, -1 if the document could not be parsed).  Errors are
+    // reported to ctx, and 'ok' is set to false if the answer should not
+    // be remembered by the caller because the error should be reported
+    // again next time.
+    int dict_find (ShadingContext *ctx, ustring dictionaryname,
+                   ustring query, bool &ok);
+    int dict_find (ShadingContext *ctx, int nodeID, ustring query, bool &ok);
     int dict_next (int nodeID);
-    int dict_value (int nodeID, ustring attribname, TypeDesc type, void *data);
+
+    // Return the decoded value of the named attribute of the node (or of
+    // the node's own value, if attribname is empty), or NULL if there is
+    // no such node or attribute.  The Value stays valid for the lifetime
+    // of the Dictionary.
+    const Value *dict_value (int nodeID, ustring attribname);
+
+    // Copy a decoded value into data, converted to the given type.
+    // Return 1 on success, 0 for an unsupported type.
+    static int copy_value (const Value &value, TypeDesc type, void *data);
 
 private:
     // We cache individual queries with a key that is a tuple of the
-    // (nodeID, query_string, type_requested).
+    // (document, nodeID, query_string).
     struct Query {
         int document;   // which dictionary document
         int node;       // root node for the search
         ustring name;   // name for the the search
-        TypeDesc type;  // UNKNOWN signifies a node, versus an attribute value
-        Query (int doc_, int node_, ustring name_,
-               TypeDesc type_=TypeDesc::UNKNOWN) :
-            document(doc_), node(node_), name(name_), type(type_) { }
+        Query (int doc_, int node_, ustring name_) :
+            document(doc_), node(node_), name(name_) { }
         bool operator== (const Query &q) const {
             return document == q.document && node == q.node &&
-                   name == q.name && type == q.type;
+                   name == q.name;
         }
     };
 
@@ -86,16 +120,18 @@ private:
         }
     };
 
-    // The cached query result is mostly just a 'valueoffset', which is
-    // the index into floatdata/intdata/stringdata (depending on the type
-    // being asked for) at which the decoded data live, or a node ID
-    // if the query was for a node rather than for an attribute.
-    struct QueryResult {
-        int valueoffset;  // Offset into one of the 'data' vectors, or nodeID
-        bool is_valid;    // true: query found
-        QueryResult (bool valid=true) : valueoffset(0), is_valid(valid) { }
-        QueryResult (bool /*isnode*/, int value)
-            : valueoffset(value), is_valid(true) { }
+    // Attribute values are cached by (nodeID, attribname).
+    struct ValueKey {
+        int node;
+        ustring name;
+        bool operator== (const ValueKey &k) const {
+            return node == k.node && name == k.name;
+        }
+    };
+    struct ValueKeyHash {
+        size_t operator() (const ValueKey &key) const {
+            return key.name.hash() + 17*key.node;
+        }
     };
 
     // Nodes we've looked up.  Includes a 'next' index of the matching node
@@ -108,10 +144,22 @@ private:
             : document(d), node(n), next(0) { }
     };
 
-    typedef std::unordered_map <Query, QueryResult, QueryHash> QueryMap;
+    // A compiled query, or the reason it failed to compile.
+    struct CompiledQuery {
+        std::unique_ptr<pugi::xpath_query> xpath;
+        std::string error;
+    };
+
+    // The cached query result is the nodeID of the first match (0 if
+    // there was no match).
+    typedef std::unordered_map<Query, int, QueryHash> QueryMap;
     typedef std::unordered_map<ustring, int, ustringHash> DocMap;
+    typedef std::unordered_map<ustring, CompiledQuery, ustringHash> XPathMap;
+    typedef std::unordered_map<ValueKey, const Value *, ValueKeyHash> ValueMap;
 
-    ShadingContext *m_context;  // back-pointer to shading context
+    // Guards everything below.  Lookups of things already cached take it
+    // shared, anything that adds to the cache takes it exclusively.
+    spin_rw_mutex m_mutex;
 
     // List of XML documents we've read in.
     std::vector<pugi::xml_document *> m_documents;
@@ -119,26 +167,35 @@ private:
     // Map xml strings and/or filename to indices in m_documents.
     DocMap m_document_map;
 
+    // Compiled XPath queries, by query string.
+    XPathMap m_xpath;
+
     // Cache of fully resolved queries.
-    Dictionary::QueryMap m_cache;  // query cache
+    QueryMap m_cache;  // query cache
 
     // List of all the nodes we've found by queries.
-    std::vector<Dictionary::Node> m_nodes;
+    std::vector<Node> m_nodes;
 
-    // m_floatdata, m_intdata, and m_stringdata hold the decoded data
-    // results (including type conversion) of cached queries.
-    std::vector<float>   m_floatdata;
-    std::vector<int>     m_intdata;
-    std::vector<ustring> m_stringdata;
+    // Decoded attribute values.  They are allocated individually and
+    // never move, so callers may hold on to the pointers.
+    ValueMap m_value_map;
+    std::vector<std::unique_ptr<Value>> m_values;
 
     // Helper function: return the document index given dictionary name.
-    int get_document_index (ustring dictionaryname);
+    // Must hold m_mutex exclusively.
+    int get_document_index (ShadingContext *ctx, ustring dictionaryname);
+
+    // Helper function: run the query from root, add the matches to
+    // m_nodes and the query cache, and return the first one.  Must hold
+    // m_mutex exclusively.
+    int run_query (ShadingContext *ctx, const Query &q,
+                   const pugi::xpath_node &root, bool &ok);
 };
 
 
 
 int
-Dictionary::get_document_index (ustring dictionaryname)
+Dictionary::get_document_index (ShadingContext *ctx, ustring dictionaryname)
 {
     DocMap::iterator dm = m_document_map.find(dictionaryname);
     int dindex;
@@ -156,9 +213,9 @@ Dictionary::get_document_index (ustring dictionaryname)
             parse_result = doc->load_string(dictionaryname.c_str());
         }
         if (! parse_result) {
-            m_context->errorf("XML parsed with errors: %s, at offset %d",
-                              parse_result.description(),
-                              parse_result.offset);
+            ctx->errorf("XML parsed with errors: %s, at offset %d",
+                        parse_result.description(),
+                        parse_result.offset);
             m_document_map[dictionaryname] = -1;
             return -1;
         }
@@ -173,98 +230,112 @@ Dictionary::get_document_index (ustring dictionaryname)
 
 
 int
-Dictionary::dict_find (ustring dictionaryname, ustring query)
+Dictionary::run_query (ShadingContext *ctx, const Query &q,
+                       const pugi::xpath_node &root, bool &ok)
 {
-    int dindex = get_document_index (dictionaryname);
-    if (dindex < 0)
-        return dindex;
-
-    Query q (dindex, 0, query);
+    // Someone else may have resolved it while we waited for the lock
     QueryMap::iterator qfound = m_cache.find (q);
-    if (qfound != m_cache.end()) {
-        return qfound->second.valueoffset;
+    if (qfound != m_cache.end())
+        return qfound->second;
+
+    // Compile the query string, if nobody has asked for it before
+    XPathMap::iterator xfound = m_xpath.find (q.name);
+    if (xfound == m_xpath.end()) {
+        CompiledQuery cq;
+        try {
+            cq.xpath.reset (new pugi::xpath_query (q.name.c_str()));
+        }
+        catch (const pugi::xpath_exception& e) {
+            cq.error = e.what();
+        }
+        xfound = m_xpath.emplace (q.name, std::move(cq)).first;
+    }
+    const CompiledQuery &cq (xfound->second);
+    if (! cq.xpath) {
+        ctx->errorf("Invalid dict_find query '%s': %s",
+                    q.name.c_str(), cq.error);
+        ok = false;
+        return 0;
     }
-
-    pugi::xml_document *doc = m_documents[dindex];
 
     // Query was not found.  Do the expensive lookup and cache it
     pugi::xpath_node_set matches;
-
     try {
-        matches = doc->select_nodes (query.c_str());
+        matches = cq.xpath->evaluate_node_set (root);
     }
     catch (const pugi::xpath_exception& e) {
-        m_context->errorf("Invalid dict_find query '%s': %s",
-                          query.c_str(), e.what());
+        ctx->errorf("Invalid dict_find query '%s': %s",
+                    q.name.c_str(), e.what());
+        ok = false;
         return 0;
     }
 
     if (matches.empty()) {
-        m_cache[q] = QueryResult (false);  // mark invalid
+        m_cache[q] = 0;  // mark invalid
         return 0;   // Not found
     }
     int firstmatch = (int) m_nodes.size();
     int last = -1;
     for (auto&& m : matches) {
-        m_nodes.emplace_back(dindex, m.node());
+        m_nodes.emplace_back(q.document, m.node());
         int nodeid = (int) m_nodes.size()-1;
-        if (last < 0) {
-            // If this is the first match, add a cache entry for it
-            m_cache[q] = QueryResult (true /* it's a node */, nodeid);
-        } else {
-            // If this is a subsequent match, set the last match's 'next'
+        // If this is a subsequent match, set the last match's 'next'
+        if (last >= 0)
             m_nodes[last].next = nodeid;
-        }
         last = nodeid;
     }
+    m_cache[q] = firstmatch;
     return firstmatch;
 }
 
 
 
 int
-Dictionary::dict_find (int nodeID, ustring query)
+Dictionary::dict_find (ShadingContext *ctx, ustring dictionaryname,
+                       ustring query, bool &ok)
 {
-    if (nodeID <= 0 || nodeID >= (int)m_nodes.size())
-        return 0;     // invalid node ID
-
-    int document = m_nodes[nodeID].document;
-    Query q (document, nodeID, query);
-    QueryMap::iterator qfound = m_cache.find (q);
-    if (qfound != m_cache.end()) {
-        return qfound->second.valueoffset;
+    {
+        spin_rw_read_lock lock (m_mutex);
+        DocMap::const_iterator dm = m_document_map.find (dictionaryname);
+        if (dm != m_document_map.end()) {
+            if (dm->second < 0)
+                return -1;
+            QueryMap::const_iterator qfound
+                = m_cache.find (Query (dm->second, 0, query));
+            if (qfound != m_cache.end())
+                return qfound->second;
+        }
     }
 
-    // Query was not found.  Do the expensive lookup and cache it
-    pugi::xpath_node_set matches;
-    try {
-        matches = m_nodes[nodeID].node.select_nodes (query.c_str());
-    }
-    catch (const pugi::xpath_exception& e) {
-        m_context->errorf("Invalid dict_find query '%s': %s",
-                          query.c_str(), e.what());
-        return 0;
-    }
+    spin_rw_write_lock lock (m_mutex);
+    int dindex = get_document_index (ctx, dictionaryname);
+    if (dindex < 0)
+        return dindex;
+    pugi::xml_document *doc = m_documents[dindex];
+    return run_query (ctx, Query (dindex, 0, query), pugi::xpath_node(*doc),
+                      ok);
+}
 
-    if (matches.empty()) {
-        m_cache[q] = QueryResult (false);  // mark invalid
-        return 0;   // Not found
-    }
-    int firstmatch = (int) m_nodes.size();
-    int last = -1;
-    for (auto&& m : matches) {
-        m_nodes.emplace_back(document, m.node());
-        int nodeid = (int) m_nodes.size()-1;
-        if (last < 0) {
-            // If this is the first match, add a cache entry for it
-            m_cache[q] = QueryResult (true /* it's a node */, nodeid);
-        } else {
-            // If this is a subsequent match, set the last match's 'next'
-            m_nodes[last].next = nodeid;
-        }
-        last = nodeid;
+
+
+int
+Dictionary::dict_find (ShadingContext *ctx, int nodeID, ustring query,
+                       bool &ok)
+{
+    {
+        spin_rw_read_lock lock (m_mutex);
+        if (nodeID <= 0 || nodeID >= (int)m_nodes.size())
+            return 0;     // invalid node ID
+        QueryMap::const_iterator qfound
+            = m_cache.find (Query (m_nodes[nodeID].document, nodeID, query));
+        if (qfound != m_cache.end())
+            return qfound->second;
     }
-    return firstmatch;
+
+    spin_rw_write_lock lock (m_mutex);
+    const Node &node (m_nodes[nodeID]);
+    return run_query (ctx, Query (node.document, nodeID, query),
+                      pugi::xpath_node(node.node), ok);
 }
 
 
@@ -272,6 +343,7 @@ Dictionary::dict_find (int nodeID, ustring query)
 int
 Dictionary::dict_next (int nodeID)
 {
+    spin_rw_read_lock lock (m_mutex);
     if (nodeID <= 0 || nodeID >= (int)m_nodes.size())
         return 0;     // invalid node ID
     return m_nodes[nodeID].next;
@@ -279,89 +351,82 @@ Dictionary::dict_next (int nodeID)
 
 
 
-int
-Dictionary::dict_value (int nodeID, ustring attribname,
-                        TypeDesc type, void *data)
+const Dictionary::Value *
+Dictionary::dict_value (int nodeID, ustring attribname)
 {
-    if (nodeID <= 0 || nodeID >= (int)m_nodes.size())
-        return 0;     // invalid node ID
-
-    const Dictionary::Node &node (m_nodes[nodeID]);
-    Dictionary::Query q (node.document, nodeID, attribname, type);
-    Dictionary::QueryMap::iterator qfound = m_cache.find (q);
-    if (qfound != m_cache.end()) {
-        // previously found
-        int offset = qfound->second.valueoffset;
-        int n = type.numelements() * type.aggregate;
-        if (type.basetype == TypeDesc::STRING) {
-            OSL_DASSERT (n == 1 && "no string arrays in XML");
-            ((ustring *)data)[0] = m_stringdata[offset];
-            return 1;
-        }
-        if (type.basetype == TypeDesc::INT) {
-            for (int i = 0;  i < n;  ++i)
-                ((int *)data)[i] = m_intdata[offset++];
-            return 1;
-        }
-        if (type.basetype == TypeDesc::FLOAT) {
-            for (int i = 0;  i < n;  ++i)
-                ((float *)data)[i] = m_floatdata[offset++];
-            return 1;
-        }
-        return 0;  // Unknown type
+    ValueKey key { nodeID, attribname };
+    {
+        spin_rw_read_lock lock (m_mutex);
+        if (nodeID <= 0 || nodeID >= (int)m_nodes.size())
+            return NULL;  // invalid node ID
+        ValueMap::const_iterator vfound = m_value_map.find (key);
+        if (vfound != m_value_map.end())
+            return vfound->second;
     }
 
     // OK, the entry wasn't in the cache, we need to decode it and cache it.
+    spin_rw_write_lock lock (m_mutex);
+    ValueMap::const_iterator vfound = m_value_map.find (key);
+    if (vfound != m_value_map.end())
+        return vfound->second;
 
+    const pugi::xml_node &node (m_nodes[nodeID].node);
     const char *val = NULL;
     if (attribname.empty()) {
-        val = node.node.value();
+        val = node.value();
     } else {
-        for (pugi::xml_attribute_iterator ait = node.node.attributes_begin();
-             ait != node.node.attributes_end(); ++ait) {
+        for (pugi::xml_attribute_iterator ait = node.attributes_begin();
+             ait != node.attributes_end(); ++ait) {
             if (ait->name() == attribname) {
                 val = ait->value();
                 break;
             }
         }
     }
-    if (val == NULL)
-        return 0;   // not found
 
-    Dictionary::QueryResult r (false, 0);
+    Value *value = NULL;
+    if (val) {
+        value = new Value;
+        m_values.emplace_back (value);
+        value->str = ustring (val);
+        string_view valstr (val);
+        int i;
+        while (OIIO::Strutil::parse_int (valstr, i)) {
+            value->ints.push_back (i);
+            OIIO::Strutil::parse_char (valstr, ',');
+        }
+        valstr = val;
+        float f;
+        while (OIIO::Strutil::parse_float (valstr, f)) {
+            value->floats.push_back (f);
+            OIIO::Strutil::parse_char (valstr, ',');
+        }
+    }
+    m_value_map[key] = value;  // NULL marks 'not found'
+    return value;
+}
+
+
+
+int
+Dictionary::copy_value (const Value &value, TypeDesc type, void *data)
+{
+    // Elements the string didn't have are filled in with zero.
     int n = type.numelements() * type.aggregate;
     if (type.basetype == TypeDesc::STRING && n == 1) {
-        r.valueoffset = (int) m_stringdata.size();
-        ustring s (val);
-        m_stringdata.push_back (s);
-        ((ustring *)data)[0] = s;
-        m_cache[q] = r;
+        ((ustring *)data)[0] = value.str;
         return 1;
     }
     if (type.basetype == TypeDesc::INT) {
-        r.valueoffset = (int) m_intdata.size();
-        string_view valstr (val);
-        for (int i = 0;  i < n;  ++i) {
-            int v;
-            OIIO::Strutil::parse_int (valstr, v);
-            OIIO::Strutil::parse_char (valstr, ',');
-            m_intdata.push_back (v);
-            ((int *)data)[i] = v;
-        }
-        m_cache[q] = r;
+        int nvals = std::min (n, (int)value.ints.size());
+        for (int i = 0;  i < n;  ++i)
+            ((int *)data)[i] = i < nvals ? value.ints[i] : 0;
         return 1;
     }
     if (type.basetype == TypeDesc::FLOAT) {
-        r.valueoffset = (int) m_floatdata.size();
-        string_view valstr (val);
-        for (int i = 0;  i < n;  ++i) {
-            float v;
-            OIIO::Strutil::parse_float (valstr, v);
-            OIIO::Strutil::parse_char (valstr, ',');
-            m_floatdata.push_back (v);
-            ((float *)data)[i] = v;
-        }
-        m_cache[q] = r;
+        int nvals = std::min (n, (int)value.floats.size());
+        for (int i = 0;  i < n;  ++i)
+            ((float *)data)[i] = i < nvals ? value.floats[i] : 0.0f;
         return 1;
     }
 
@@ -370,6 +435,131 @@ Dictionary::dict_value (int nodeID, ustring attribname,
 }
 
 
+
+// The per-context front end to the shared Dictionary.  Nothing in the
+// Dictionary ever changes once it has been looked up, so a context can
+// remember every answer it has been given and serve repeats from its own
+// tables without any locking.
+class DictionaryMemo {
+public:
+    DictionaryMemo (Dictionary &dict) : m_dict(dict) { }
+
+    int dict_find (ShadingContext *ctx, ustring dictionaryname, ustring query)
+    {
+        FindKey key { dictionaryname, 0, query };
+        FindMap::const_iterator found = m_finds.find (key);
+        if (found != m_finds.end())
+            return found->second;
+        bool ok = true;
+        int r = m_dict.dict_find (ctx, dictionaryname, query, ok);
+        if (ok)
+            m_finds.emplace (key, r);
+        return r;
+    }
+
+    int dict_find (ShadingContext *ctx, int nodeID, ustring query)
+    {
+        if (nodeID <= 0)
+            return 0;     // invalid node ID
+        FindKey key { ustring(), nodeID, query };
+        FindMap::const_iterator found = m_finds.find (key);
+        if (found != m_finds.end())
+            return found->second;
+        bool ok = true;
+        int r = m_dict.dict_find (ctx, nodeID, query, ok);
+        if (ok)
+            m_finds.emplace (key, r);
+        return r;
+    }
+
+    int dict_next (int nodeID)
+    {
+        std::unordered_map<int,int>::const_iterator found = m_nexts.find (nodeID);
+        if (found != m_nexts.end())
+            return found->second;
+        int r = m_dict.dict_next (nodeID);
+        m_nexts.emplace (nodeID, r);
+        return r;
+    }
+
+    int dict_value (int nodeID, ustring attribname, TypeDesc type, void *data)
+    {
+        ValueKey key { nodeID, attribname };
+        const Dictionary::Value *value;
+        ValueMap::const_iterator found = m_values.find (key);
+        if (found != m_values.end()) {
+            value = found->second;
+        } else {
+            value = m_dict.dict_value (nodeID, attribname);
+            m_values.emplace (key, value);
+        }
+        if (! value)
+            return 0;   // not found
+        return Dictionary::copy_value (*value, type, data);
+    }
+
+private:
+    struct FindKey {
+        ustring dict;   // dictionary name, or empty if searching from a node
+        int node;       // root node for the search
+        ustring query;
+        bool operator== (const FindKey &k) const {
+            return dict == k.dict && node == k.node && query == k.query;
+        }
+    };
+    struct FindKeyHash {
+        size_t operator() (const FindKey &key) const {
+            return key.query.hash() + 17*key.node + 79*key.dict.hash();
+        }
+    };
+    struct ValueKey {
+        int node;
+        ustring name;
+        bool operator== (const ValueKey &k) const {
+            return node == k.node && name == k.name;
+        }
+    };
+    struct ValueKeyHash {
+        size_t operator() (const ValueKey &key) const {
+            return key.name.hash() + 17*key.node;
+        }
+    };
+    typedef std::unordered_map<FindKey, int, FindKeyHash> FindMap;
+    typedef std::unordered_map<ValueKey, const Dictionary::Value *,
+                               ValueKeyHash> ValueMap;
+
+    Dictionary &m_dict;
+    FindMap m_finds;
+    std::unordered_map<int,int> m_nexts;
+    ValueMap m_values;
+};
+
+
+
+Dictionary *
+ShadingSystemImpl::dictionary ()
+{
+    Dictionary *dict = m_dictionary.load (std::memory_order_acquire);
+    if (! dict) {
+        spin_lock lock (m_dictionary_mutex);
+        dict = m_dictionary.load (std::memory_order_relaxed);
+        if (! dict) {
+            dict = new Dictionary;
+            m_dictionary.store (dict, std::memory_order_release);
+        }
+    }
+    return dict;
+}
+
+
+
+void
+ShadingSystemImpl::free_dict_resources ()
+{
+    delete m_dictionary.exchange (nullptr);
+}
+
+
 }; // namespace pvt
 
 
@@ -377,10 +567,9 @@ Dictionary::dict_value (int nodeID, ustring attribname,
 int
 ShadingContext::dict_find (ustring dictionaryname, ustring query)
 {
-    if (! m_dictionary) {
-        m_dictionary = new Dictionary (this);
-    }
-    return m_dictionary->dict_find (dictionaryname, query);
+    if (! m_dictionary_memo)
+        m_dictionary_memo = new DictionaryMemo (*m_shadingsys.dictionary());
+    return m_dictionary_memo->dict_find (this, dictionaryname, query);
 }
 
 
@@ -388,10 +577,9 @@ ShadingContext::dict_find (ustring dictionaryname, ustring query)
 int
 ShadingContext::dict_find (int nodeID, ustring query)
 {
-    if (! m_dictionary) {
-        m_dictionary = new Dictionary (this);
-    }
-    return m_dictionary->dict_find (nodeID, query);
+    if (! m_dictionary_memo)
+        m_dictionary_memo = new DictionaryMemo (*m_shadingsys.dictionary());
+    return m_dictionary_memo->dict_find (this, nodeID, query);
 }
 
 
@@ -399,9 +587,9 @@ ShadingContext::dict_find (int nodeID, ustring query)
 int
 ShadingContext::dict_next (int nodeID)
 {
-    if (! m_dictionary)
+    if (! m_dictionary_memo)
         return 0;
-    return m_dictionary->dict_next (nodeID);
+    return m_dictionary_memo->dict_next (nodeID);
 }
 
 
@@ -410,9 +598,9 @@ int
 ShadingContext::dict_value (int nodeID, ustring attribname,
                             TypeDesc type, void *data)
 {
-    if (! m_dictionary)
+    if (! m_dictionary_memo)
         return 0;
-    return m_dictionary->dict_value (nodeID, attribname, type, data);
+    return m_dictionary_memo->dict_value (nodeID, attribname, type, data);
 }
 
 
@@ -420,7 +608,8 @@ ShadingContext::dict_value (int nodeID, ustring attribname,
 void
 ShadingContext::free_dict_resources ()
 {
-    delete m_dictionary;
+    delete m_dictionary_memo;
+    m_dictionary_memo = nullptr;
 }
 
 
@@ -176,7 +176,8 @@ inline bool compatible_param (const TypeDesc& a, const TypeDesc& b)
 
 
 void
-ShaderInstance::parameters (const ParamValueList &params)
+ShaderInstance::parameters (const ParamValueList &params,
+                            const std::vector<ustring> &interactive)
 {
     // Seed the params with the master's defaults
     m_iparams = m_master->m_idefaults;
@@ -267,6 +268,14 @@ ShaderInstance::parameters (const ParamValueList &params)
                              p.interp() == ParamValue::INTERP_CONSTANT);
             so->lockgeom (lockgeom);
 
+            // Interactive params stay instance values even if they match
+            // the default, since they will be edited later.
+            bool isinteractive = lockgeom &&
+                std::find (interactive.begin(), interactive.end(),
+                           p.name()) != interactive.end();
+            so->interactive (isinteractive);
+            m_interactive_params |= isinteractive;
+
             OSL_DASSERT(so->dataoffset() == sm->dataoffset());
             so->dataoffset (sm->dataoffset());
 
@@ -318,7 +327,7 @@ ShaderInstance::parameters (const ParamValueList &params)
                 // sized array case, which is why we have it in the 'else'
                 // clause of that test.
                 void *defaultdata = m_master->param_default_storage(i);
-                if (lockgeom &&
+                if (lockgeom && ! isinteractive &&
                       memcmp (defaultdata, data, valuetype.size()) == 0) {
                     // Must reset valuesource to default, in case the parameter
                     // was set already, and now is being changed back to default.
@@ -483,6 +492,7 @@ ShaderInstance::copy_code_from_master (ShaderGroup &group)
                 si->valuesource (m_instoverrides[i].valuesource());
                 si->connected_down (m_instoverrides[i].connected_down());
                 si->lockgeom (m_instoverrides[i].lockgeom());
+                si->interactive (m_instoverrides[i].interactive());
                 si->dataoffset (m_instoverrides[i].dataoffset());
                 si->data (param_storage(i));
             }
@@ -594,6 +604,11 @@ ShaderInstance::mergeable (const ShaderInstance &b, const ShaderGroup& /*g*/) co
     if (renderer_outputs() || b.renderer_outputs())
         return false;
 
+    // ReParameter of an interactive param is addressed to one particular
+    // layer, so those must stay separate.
+    if (interactive_params() || b.interactive_params())
+        return false;
+
     // If the shaders haven't been optimized yet, they don't yet have
     // their own symbol tables and instructions (they just refer to
     // their unoptimized master), but they may have an "instance
@@ -800,7 +815,7 @@ ShaderGroup::mark_entry_layer (int layer)
 
 
 std::string
-ShaderGroup::serialize () const
+ShaderGroup::serialize (bool interactive) const
 {
     std::ostringstream out;
     out.imbue (std::locale::classic());  // force C locale
@@ -850,6 +865,10 @@ ShaderGroup::serialize () const
                                               : inst->instoverride(p)->lockgeom();
                 if (! lockgeom)
                     out << Strutil::sprintf (" [[int lockgeom=%d]]", lockgeom);
+                bool isinteractive = dstsyms_exist ? s->interactive()
+                                           : inst->instoverride(p)->interactive();
+                if (isinteractive && interactive)
+                    out << " [[int interactive=1]]";
                 out << " ;\n";
             }
         }
@@ -253,10 +253,8 @@ LLVMGEN (llvm_gen_printf)
         return false;
     }
 
-    // For some ops, we push the shader globals pointer
-    if (op.opname() == op_printf || op.opname() == op_error ||
-            op.opname() == op_warning || op.opname() == op_fprintf)
-        call_args.push_back (rop.sg_void_ptr());
+    // Push the shader globals pointer
+    call_args.push_back (rop.sg_void_ptr());
 
     // fprintf also needs the filename
     if (op.opname() == op_fprintf) {
@@ -1907,6 +1905,33 @@ LLVMGEN (llvm_gen_regex)
                  (Match.typespec().is_array() &&
                   Match.typespec().elementtype().is_int()));
 
+    if (Pattern.is_constant() && ! rop.use_optix()) {
+        // Compile the pattern now, rather than looking it up on every
+        // call, and hand the compiled regex directly to the shadeop.  The
+        // regex is named after its pattern so that cached code can find
+        // it again in another process.
+        ustring pattern = Pattern.get_string();
+        const CompiledRegex &regex (rop.shadingsys().find_regex (pattern));
+        std::string regex_name = "osl.regex.";
+        static const char hexdigits[] = "0123456789abcdef";
+        for (unsigned char c : pattern.string()) {
+            regex_name += hexdigits[c >> 4];
+            regex_name += hexdigits[c & 15];
+        }
+        llvm::Value* call_args[] = {
+            rop.llvm_load_value (Subject),
+            rop.llvm_void_ptr(Match),
+            do_match_results ?
+                rop.ll.constant(Match.typespec().arraylength()) :
+                rop.ll.constant(0),
+            rop.ll.constant_ptr ((void *)&regex, regex_name),
+            rop.ll.constant(fullmatch),
+        };
+        llvm::Value *ret = rop.ll.call_function ("osl_regex_compiled_impl", call_args);
+        rop.llvm_store_value (ret, Result);
+        return true;
+    }
+
     llvm::Value* call_args[] = {
         rop.sg_void_ptr(),              // First arg is ShaderGlobals ptr
         rop.llvm_load_value (Subject),  // Next arg is subject string
@@ -2010,6 +2035,39 @@ LLVMGEN (llvm_gen_generic)
 
 
 
+// concat and substr: the call llvm_gen_generic would make, but with the
+// shader globals pointer in front, so that the results can be made (and
+// remembered) by the shading context.
+LLVMGEN (llvm_gen_string_op)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    OSL_DASSERT (op.nargs() >= 2 && op.nargs() <= 4);
+    Symbol& Result = *rop.opargsym (op, 0);
+    OSL_DASSERT (Result.typespec().is_string());
+
+    std::string name = std::string("osl_") + op.opname().string() + "_s";
+    llvm::Value *args[4];
+    args[0] = rop.sg_void_ptr ();
+    for (int i = 1;  i < op.nargs();  ++i) {
+        Symbol& s (*rop.opargsym (op, i));
+        OSL_DASSERT (s.typespec().is_string() || s.typespec().is_int());
+        if (s.typespec().is_string()) {
+            name += "s";
+            args[i] = rop.use_optix() ? rop.llvm_load_device_string (s, /*follow*/ true)
+                                      : rop.llvm_load_value (s);
+        } else {
+            name += "i";
+            args[i] = rop.llvm_load_value (s);
+        }
+    }
+    llvm::Value *r = rop.ll.call_function (name.c_str(),
+                                           cspan<llvm::Value*>(args, op.nargs()));
+    rop.llvm_store_value (r, Result);
+    return true;
+}
+
+
+
 LLVMGEN (llvm_gen_sincos)
 {
     Opcode &op (rop.inst()->ops()[opnum]);
@@ -2184,15 +2242,120 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
                           llvm::Value* &alpha, llvm::Value* &dalphadx,
                           llvm::Value* &dalphady, llvm::Value* &errormessage)
 {
-    llvm::Value* opt = rop.ll.call_function ("osl_get_texture_options",
-                                             rop.sg_void_ptr());
-    llvm::Value* missingcolor = NULL;
+    // On the CPU, every option whose value is a constant is applied right
+    // now to a TextureOpt template, which becomes a constant global of the
+    // module (shared by all call sites with the same options).  The
+    // generated code just copies the template to the function's TextureOpt
+    // on the stack and then stores the few options whose values vary.
+    // The copy has to come first, before the template is complete, so it
+    // reads from a placeholder that gets the template's bytes at the end.
+    // OptiX can't see host memory, so there we start from a default
+    // TextureOpt and call a setter for each non-default option.
+    bool bake = ! rop.use_optix();
     TextureOpt optdefaults;  // So we can check the defaults
-    bool swidth_set = false, twidth_set = false, rwidth_set = false;
-    bool sblur_set = false, tblur_set = false, rblur_set = false;
-    bool swrap_set = false, twrap_set = false, rwrap_set = false;
-    bool firstchannel_set = false, fill_set = false, interp_set = false;
-    bool time_set = false, subimage_set = false;
+    // Zeroed first, so that padding can't make equal templates differ
+    alignas(TextureOpt) char tmplbuf[sizeof(TextureOpt)] = {};
+    TextureOpt *tmpl = NULL;
+    llvm::GlobalVariable *tmplvar = NULL;
+    llvm::Value* opt;
+    if (bake) {
+        tmpl = new (tmplbuf) TextureOpt;
+        tmplvar = rop.llvm_constant_data_placeholder (sizeof(TextureOpt));
+        opt = rop.llvm_texture_options_alloca ();
+        rop.ll.op_memcpy (opt, rop.ll.void_ptr (tmplvar),
+                          (int)sizeof(TextureOpt), 16);
+    } else {
+        opt = rop.ll.call_function ("osl_get_texture_options",
+                                    rop.sg_void_ptr());
+    }
+    llvm::Value* missingcolor = NULL;
+
+    // The options we know how to set, as bits.  A constant can only go
+    // into the template if no generated code has written that field
+    // yet, because the template is copied before any of that code runs.
+    enum {
+        Firstchannel = 1 << 0, Subimage = 1 << 1, Subimagename = 1 << 2,
+        Swrap = 1 << 3, Twrap = 1 << 4, Rwrap = 1 << 5,
+        Sblur = 1 << 6, Tblur = 1 << 7, Rblur = 1 << 8,
+        Swidth = 1 << 9, Twidth = 1 << 10, Rwidth = 1 << 11,
+        Fill = 1 << 12, Time = 1 << 13, Interp = 1 << 14
+    };
+    int any_set = 0;    // options given any value so far
+    int code_set = 0;   // options written by generated code
+    static_assert (sizeof(TextureOpt::Wrap) == sizeof(int) &&
+                   sizeof(TextureOpt::InterpMode) == sizeof(int),
+                   "TextureOpt enums must be int-sized");
+
+    // Set an int-valued field (also used for the enum codes).
+    auto set_int = [&](int field, size_t offset, const char *setter,
+                       const Symbol *Val, int constval) {
+        if (! Val) {   // constant code, not a symbol
+            if (bake && ! (code_set & field)) {
+                memcpy ((char *)tmpl + offset, &constval, sizeof(int));
+                any_set |= field;
+                return;
+            }
+            if (! bake && ! (any_set & field) &&
+                  ! memcmp ((const char *)&optdefaults + offset, &constval, sizeof(int)))
+                return;     // default constant
+        } else if (Val->is_constant()) {
+            int v = *(const int *)Val->data();
+            if (bake && ! (code_set & field)) {
+                memcpy ((char *)tmpl + offset, &v, sizeof(int));
+                any_set |= field;
+                return;
+            }
+            if (! bake && ! (any_set & field) &&
+                  ! memcmp ((const char *)&optdefaults + offset, &v, sizeof(int)))
+                return;     // default constant
+        }
+        llvm::Value *val = Val ? rop.llvm_load_value (*Val)
+                               : rop.ll.constant (constval);
+        if (bake)
+            rop.ll.op_store (val, rop.ll.offset_ptr (opt, (int)offset,
+                                                     rop.ll.type_int_ptr()));
+        else
+            rop.ll.call_function (setter, opt, val);
+        any_set |= field;
+        code_set |= field;
+    };
+
+    // Set a float-valued field from a float or int symbol.
+    auto set_float = [&](int field, size_t offset, const char *setter,
+                         const Symbol &Val) {
+        if (Val.is_constant()) {
+            float v = Val.typespec().is_int() ? float(*(const int *)Val.data())
+                                              : *(const float *)Val.data();
+            if (bake && ! (code_set & field)) {
+                memcpy ((char *)tmpl + offset, &v, sizeof(float));
+                any_set |= field;
+                return;
+            }
+            float def;
+            memcpy (&def, (const char *)&optdefaults + offset, sizeof(float));
+            if (! bake && ! (any_set & field) && v == def)
+                return;     // default constant
+        }
+        llvm::Value *val = rop.llvm_load_value (Val);
+        if (Val.typespec().is_int())
+            val = rop.ll.op_int_to_float (val);
+        if (bake)
+            rop.ll.op_store (val, rop.ll.offset_ptr (opt, (int)offset,
+                                                     rop.ll.type_float_ptr()));
+        else
+            rop.ll.call_function (setter, opt, val);
+        any_set |= field;
+        code_set |= field;
+    };
+
+    // Set a field from a string that must be decoded at runtime.
+    auto set_string = [&](int field, const char *setter, const Symbol &Val) {
+        rop.ll.call_function (setter, opt, rop.llvm_load_value (Val));
+        any_set |= field;
+        code_set |= field;
+    };
+
+#define OPTOFFSET(fieldname) offsetof(TextureOpt, fieldname)
 
     Opcode &op (rop.inst()->ops()[opnum]);
     for (int a = first_optional_arg;  a < op.nargs();  ++a) {
@@ -2208,121 +2371,129 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
 
         Symbol &Val (*rop.opargsym(op,a));
         TypeDesc valtype = Val.typespec().simpletype ();
-        const int *ival = Val.typespec().is_int() && Val.is_constant() ? (const int *)Val.data() : NULL;
-        const float *fval = Val.typespec().is_float() && Val.is_constant() ? (const float *)Val.data() : NULL;
-
-#define PARAM_INT(paramname)                                            \
-        if (name == Strings::paramname && valtype == TypeDesc::INT)   { \
-            if (! paramname##_set &&                                    \
-                ival && *ival == optdefaults.paramname)                 \
-                continue;     /* default constant */                    \
-            llvm::Value *val = rop.llvm_load_value (Val);               \
-            rop.ll.call_function ("osl_texture_set_" #paramname, opt, val); \
-            paramname##_set = true;                                     \
-            continue;                                                   \
-        }
+        bool numeric = (valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT);
 
-#define PARAM_FLOAT(paramname)                                          \
-        if (name == Strings::paramname &&                               \
-            (valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT)) { \
-            if (! paramname##_set &&                                    \
-                ((ival && *ival == optdefaults.paramname) ||            \
-                 (fval && *fval == optdefaults.paramname)))             \
-                continue;     /* default constant */                    \
-            llvm::Value *val = rop.llvm_load_value (Val);               \
-            if (valtype == TypeDesc::INT)                               \
-                val = rop.ll.op_int_to_float (val);                     \
-            rop.ll.call_function ("osl_texture_set_" #paramname, opt, val); \
-            paramname##_set = true;                                     \
-            continue;                                                   \
+        if (name == Strings::width && numeric) {
+            set_float (Swidth, OPTOFFSET(swidth), "osl_texture_set_swidth", Val);
+            set_float (Twidth, OPTOFFSET(twidth), "osl_texture_set_twidth", Val);
+            if (tex3d)
+                set_float (Rwidth, OPTOFFSET(rwidth), "osl_texture_set_rwidth", Val);
+            continue;
         }
-
-#define PARAM_FLOAT_STR(paramname)                                      \
-        if (name == Strings::paramname &&                               \
-            (valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT)) { \
-            if (! s##paramname##_set && ! t##paramname##_set &&         \
-                ! r##paramname##_set &&                                 \
-                ((ival && *ival == optdefaults.s##paramname) ||         \
-                 (fval && *fval == optdefaults.s##paramname)))          \
-                continue;     /* default constant */                    \
-            llvm::Value *val = rop.llvm_load_value (Val);               \
-            if (valtype == TypeDesc::INT)                               \
-                val = rop.ll.op_int_to_float (val);                     \
-            rop.ll.call_function ("osl_texture_set_st" #paramname, opt, val); \
-            if (tex3d)                                                  \
-                rop.ll.call_function ("osl_texture_set_r" #paramname, opt, val); \
-            s##paramname##_set = true;                                  \
-            t##paramname##_set = true;                                  \
-            r##paramname##_set = true;                                  \
-            continue;                                                   \
+        if (name == Strings::swidth && numeric) {
+            set_float (Swidth, OPTOFFSET(swidth), "osl_texture_set_swidth", Val);
+            continue;
         }
-
-#define PARAM_STRING_CODE(paramname,decoder,fieldname)                  \
-        if (name == Strings::paramname && valtype == TypeDesc::STRING) { \
-            if (Val.is_constant()) {                                    \
-                int code = decoder (Val.get_string());                  \
-                if (! paramname##_set && code == optdefaults.fieldname) \
-                    continue;                                           \
-                if (code >= 0) {                                        \
-                    llvm::Value *val = rop.ll.constant (code);          \
-                    rop.ll.call_function ("osl_texture_set_" #paramname "_code", opt, val); \
-                }                                                       \
-            } else {                                                    \
-                llvm::Value *val = rop.llvm_load_value (Val);           \
-                rop.ll.call_function ("osl_texture_set_" #paramname, opt, val); \
-            }                                                           \
-            paramname##_set = true;                                     \
-            continue;                                                   \
+        if (name == Strings::twidth && numeric) {
+            set_float (Twidth, OPTOFFSET(twidth), "osl_texture_set_twidth", Val);
+            continue;
+        }
+        if (name == Strings::rwidth && numeric) {
+            set_float (Rwidth, OPTOFFSET(rwidth), "osl_texture_set_rwidth", Val);
+            continue;
+        }
+        if (name == Strings::blur && numeric) {
+            set_float (Sblur, OPTOFFSET(sblur), "osl_texture_set_sblur", Val);
+            set_float (Tblur, OPTOFFSET(tblur), "osl_texture_set_tblur", Val);
+            if (tex3d)
+                set_float (Rblur, OPTOFFSET(rblur), "osl_texture_set_rblur", Val);
+            continue;
+        }
+        if (name == Strings::sblur && numeric) {
+            set_float (Sblur, OPTOFFSET(sblur), "osl_texture_set_sblur", Val);
+            continue;
+        }
+        if (name == Strings::tblur && numeric) {
+            set_float (Tblur, OPTOFFSET(tblur), "osl_texture_set_tblur", Val);
+            continue;
+        }
+        if (name == Strings::rblur && numeric) {
+            set_float (Rblur, OPTOFFSET(rblur), "osl_texture_set_rblur", Val);
+            continue;
         }
-
-        PARAM_FLOAT_STR (width)
-        PARAM_FLOAT (swidth)
-        PARAM_FLOAT (twidth)
-        PARAM_FLOAT (rwidth)
-        PARAM_FLOAT_STR (blur)
-        PARAM_FLOAT (sblur)
-        PARAM_FLOAT (tblur)
-        PARAM_FLOAT (rblur)
 
         if (name == Strings::wrap && valtype == TypeDesc::STRING) {
             if (Val.is_constant()) {
                 int mode = TextureOpt::decode_wrapmode (Val.get_string());
-                llvm::Value *val = rop.ll.constant (mode);
-                rop.ll.call_function ("osl_texture_set_stwrap_code", opt, val);
+                set_int (Swrap, OPTOFFSET(swrap), "osl_texture_set_swrap_code", NULL, mode);
+                set_int (Twrap, OPTOFFSET(twrap), "osl_texture_set_twrap_code", NULL, mode);
                 if (tex3d)
-                    rop.ll.call_function ("osl_texture_set_rwrap_code", opt, val);
+                    set_int (Rwrap, OPTOFFSET(rwrap), "osl_texture_set_rwrap_code", NULL, mode);
             } else {
-                llvm::Value *val = rop.llvm_load_value (Val);
-                rop.ll.call_function ("osl_texture_set_stwrap", opt, val);
+                set_string (Swrap, "osl_texture_set_swrap", Val);
+                set_string (Twrap, "osl_texture_set_twrap", Val);
                 if (tex3d)
-                    rop.ll.call_function ("osl_texture_set_rwrap", opt, val);
+                    set_string (Rwrap, "osl_texture_set_rwrap", Val);
             }
-            swrap_set = twrap_set = rwrap_set = true;
             continue;
         }
-        PARAM_STRING_CODE(swrap, TextureOpt::decode_wrapmode, swrap)
-        PARAM_STRING_CODE(twrap, TextureOpt::decode_wrapmode, twrap)
-        PARAM_STRING_CODE(rwrap, TextureOpt::decode_wrapmode, rwrap)
+#define PARAM_WRAP(paramname,field)                                     \
+        if (name == Strings::paramname && valtype == TypeDesc::STRING) { \
+            if (Val.is_constant())                                      \
+                set_int (field, OPTOFFSET(paramname),                   \
+                         "osl_texture_set_" #paramname "_code", NULL,   \
+                         TextureOpt::decode_wrapmode (Val.get_string())); \
+            else                                                        \
+                set_string (field, "osl_texture_set_" #paramname, Val); \
+            continue;                                                   \
+        }
+        PARAM_WRAP (swrap, Swrap)
+        PARAM_WRAP (twrap, Twrap)
+        PARAM_WRAP (rwrap, Rwrap)
+#undef PARAM_WRAP
 
-        PARAM_FLOAT (fill)
-        PARAM_FLOAT (time)
-        PARAM_INT (firstchannel)
-        PARAM_INT (subimage)
+        if (name == Strings::fill && numeric) {
+            set_float (Fill, OPTOFFSET(fill), "osl_texture_set_fill", Val);
+            continue;
+        }
+        if (name == Strings::time && numeric) {
+            set_float (Time, OPTOFFSET(time), "osl_texture_set_time", Val);
+            continue;
+        }
+        if (name == Strings::firstchannel && valtype == TypeDesc::INT) {
+            set_int (Firstchannel, OPTOFFSET(firstchannel),
+                     "osl_texture_set_firstchannel", &Val, 0);
+            continue;
+        }
+        if (name == Strings::subimage && valtype == TypeDesc::INT) {
+            set_int (Subimage, OPTOFFSET(subimage),
+                     "osl_texture_set_subimage", &Val, 0);
+            continue;
+        }
 
         if (name == Strings::subimage && valtype == TypeDesc::STRING) {
             if (Val.is_constant()) {
                 ustring v = Val.get_string();
-                if (v.empty() && ! subimage_set) {
+                if (v.empty() && ! (any_set & Subimagename)) {
                     continue;     // Ignore nulls unless they are overrides
                 }
+                // N.B. Not put in the template, which must not hold any
+                // addresses (such as the characters of a ustring).
             }
             llvm::Value *val = rop.llvm_load_value (Val);
-            rop.ll.call_function ("osl_texture_set_subimagename", opt, val);
-            subimage_set = true;
+            if (bake)
+                rop.ll.op_store (val, rop.ll.offset_ptr (opt, (int)OPTOFFSET(subimagename),
+                                                         rop.ll.type_ptr (rop.ll.type_string())));
+            else
+                rop.ll.call_function ("osl_texture_set_subimagename", opt, val);
+            any_set |= Subimagename;
+            code_set |= Subimagename;
             continue;
         }
 
-        PARAM_STRING_CODE (interp, tex_interp_to_code, interpmode)
+        if (name == Strings::interp && valtype == TypeDesc::STRING) {
+            if (Val.is_constant()) {
+                int mode = tex_interp_to_code (Val.get_string());
+                if (mode >= 0)
+                    set_int (Interp, OPTOFFSET(interpmode),
+                             "osl_texture_set_interp_code", NULL, mode);
+                else
+                    any_set |= Interp;
+            } else {
+                set_string (Interp, "osl_texture_set_interp", Val);
+            }
+            continue;
+        }
 
         if (name == Strings::alpha && valtype == TypeDesc::FLOAT) {
             alpha = rop.llvm_get_pointer (Val);
@@ -2337,42 +2508,38 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
             errormessage = rop.llvm_get_pointer (Val);
             continue;
         }
-        if (name == Strings::missingcolor &&
-                   equivalent(valtype,TypeDesc::TypeColor)) {
+        if ((name == Strings::missingcolor &&
+                 equivalent(valtype,TypeDesc::TypeColor)) ||
+            (name == Strings::missingalpha && valtype == TypeDesc::FLOAT)) {
             if (! missingcolor) {
                 // If not already done, allocate enough storage for the
-                // missingcolor value (4 floats), and call the special 
-                // function that points the TextureOpt.missingcolor to it.
+                // missingcolor value (4 floats), and point the
+                // TextureOpt.missingcolor to it.
                 missingcolor = rop.ll.op_alloca(rop.ll.type_float(), 4);
-                rop.ll.call_function ("osl_texture_set_missingcolor_arena",
-                                      opt, rop.ll.void_ptr(missingcolor));
+                if (bake)
+                    rop.ll.op_store (rop.ll.void_ptr(missingcolor),
+                                     rop.ll.offset_ptr (opt, (int)OPTOFFSET(missingcolor),
+                                                        rop.ll.type_ptr (rop.ll.type_void_ptr())));
+                else
+                    rop.ll.call_function ("osl_texture_set_missingcolor_arena",
+                                          opt, rop.ll.void_ptr(missingcolor));
             }
-            rop.ll.op_memcpy (rop.ll.void_ptr(missingcolor),
-                              rop.llvm_void_ptr(Val), (int)sizeof(Color3));
-            continue;
-        }
-        if (name == Strings::missingalpha && valtype == TypeDesc::FLOAT) {
-            if (! missingcolor) {
-                // If not already done, allocate enough storage for the
-                // missingcolor value (4 floats), and call the special 
-                // function that points the TextureOpt.missingcolor to it.
-                missingcolor = rop.ll.op_alloca(rop.ll.type_float(), 4);
-                rop.ll.call_function ("osl_texture_set_missingcolor_arena",
-                                      opt, rop.ll.void_ptr(missingcolor));
+            if (name == Strings::missingcolor) {
+                rop.ll.op_memcpy (rop.ll.void_ptr(missingcolor),
+                                  rop.llvm_void_ptr(Val), (int)sizeof(Color3));
+            } else {
+                llvm::Value *val = rop.llvm_load_value (Val);
+                if (bake)
+                    rop.ll.op_store (val, rop.ll.GEP (missingcolor, nchans));
+                else
+                    rop.ll.call_function ("osl_texture_set_missingcolor_alpha",
+                                          opt, rop.ll.constant(nchans), val);
             }
-            llvm::Value *val = rop.llvm_load_value (Val);
-            rop.ll.call_function ("osl_texture_set_missingcolor_alpha",
-                                    opt, rop.ll.constant(nchans), val);
             continue;
-
         }
         rop.shadingcontext()->errorf("Unknown texture%s optional argument: \"%s\", <%s> (%s:%d)",
                                      tex3d ? "3d" : "", name, valtype,
                                      op.sourcefile(), op.sourceline());
-#undef PARAM_INT
-#undef PARAM_FLOAT
-#undef PARAM_FLOAT_STR
-#undef PARAM_STRING_CODE
 
 #if 0
         // Helps me find any constant optional params that aren't elided
@@ -2384,12 +2551,30 @@ llvm_gen_texture_options (BackendLLVM &rop, int opnum,
         }
 #endif
     }
+#undef OPTOFFSET
 
+    if (bake)
+        rop.llvm_intern_constant_data (tmplvar, tmpl, 16);
     return opt;
 }
 
 
 
+// Pass a texture handle to the generated code by a name made from the
+// hash of its (constant) filename, so that the code can still be cached.
+static llvm::Value *
+llvm_texture_handle (BackendLLVM &rop, const Symbol &Filename,
+                     RendererServices::TextureHandle *texture_handle)
+{
+    if (! texture_handle)
+        return rop.ll.constant_ptr (NULL);
+    return rop.ll.constant_ptr (texture_handle,
+                                Strutil::sprintf ("osl.texhandle.%016x",
+                                                  Filename.get_string().hash()));
+}
+
+
+
 LLVMGEN (llvm_gen_texture)
 {
     Opcode &op (rop.inst()->ops()[opnum]);
@@ -2426,7 +2611,7 @@ LLVMGEN (llvm_gen_texture)
     llvm::Value * args[] = {
         rop.sg_void_ptr(),
         rop.llvm_load_value (Filename),
-        rop.ll.constant_ptr (texture_handle),
+        llvm_texture_handle (rop, Filename, texture_handle),
         opt,
         rop.llvm_load_value (S),
         rop.llvm_load_value (T),
@@ -2484,7 +2669,7 @@ LLVMGEN (llvm_gen_texture3d)
     llvm::Value *args[] = {
         rop.sg_void_ptr(),
         rop.llvm_load_value (Filename),
-        rop.ll.constant_ptr (texture_handle),
+        llvm_texture_handle (rop, Filename, texture_handle),
         opt,
         rop.llvm_void_ptr (P),
         // Auto derivs of P if !user_derivs
@@ -2539,7 +2724,7 @@ LLVMGEN (llvm_gen_environment)
     llvm::Value *args[] = {
         rop.sg_void_ptr(),
         rop.llvm_load_value (Filename),
-        rop.ll.constant_ptr (texture_handle),
+        llvm_texture_handle (rop, Filename, texture_handle),
         opt,
         rop.llvm_void_ptr (R),
         user_derivs ? rop.llvm_void_ptr (*rop.opargsym (op, 3)) : rop.llvm_void_ptr (R, 1),
@@ -2939,7 +3124,10 @@ LLVMGEN (llvm_gen_getattribute)
             rop.llvm_load_value (Attribute),
             rop.ll.constant ((int)array_lookup),
             rop.llvm_load_value (Index),
-            rop.ll.constant_ptr ((void *) dest_type),
+            rop.ll.constant_ptr ((void *) dest_type,
+                                Strutil::sprintf ("osl.typedesc.%d.%d.%d.%d",
+                                                  dest_type->basetype, dest_type->aggregate,
+                                                  dest_type->vecsemantics, dest_type->arraylen)),
             rop.llvm_void_ptr (Destination),
     };
     llvm::Value *r = rop.ll.call_function ("osl_get_attribute", args);
@@ -2975,7 +3163,7 @@ LLVMGEN (llvm_gen_gettextureinfo)
     llvm::Value * args[] = {
         rop.sg_void_ptr(),
         rop.llvm_load_value (Filename),
-        rop.ll.constant_ptr (texture_handle),
+        llvm_texture_handle (rop, Filename, texture_handle),
         rop.llvm_load_value (Dataname),
         // this is passes a TypeDesc to an LLVM op-code
         rop.ll.constant((int) Data.typespec().simpletype().basetype),
@@ -3280,9 +3468,12 @@ LLVMGEN (llvm_gen_closure)
 
     OSL_DASSERT (op.nargs() >= (2 + weighted + clentry->nformal));
 
+    // The renderer and the closure's callbacks are referred to by name, so
+    // that the code can still be cached (see LLVM_Util::constant_ptr).
+    llvm::Value *render_ptr = rop.ll.constant_ptr(rop.shadingsys().renderer(), "osl.renderer", rop.ll.type_void_ptr());
+
     // Call osl_allocate_closure_component(closure, id, size).  It returns
     // the memory for the closure parameter data.
-    llvm::Value *render_ptr = rop.ll.constant_ptr(rop.shadingsys().renderer(), rop.ll.type_void_ptr());
     llvm::Value *sg_ptr = rop.sg_void_ptr();
     llvm::Value *id_int = rop.ll.constant(clentry->id);
     llvm::Value *size_int = rop.ll.constant(clentry->struct_size);
@@ -3314,7 +3505,9 @@ LLVMGEN (llvm_gen_closure)
     // zero out the closure parameter memory.
     if (clentry->prepare) {
         // Call clentry->prepare(renderservices *, int id, void *mem)
-        llvm::Value *funct_ptr = rop.ll.constant_ptr((void *)clentry->prepare, rop.llvm_type_prepare_closure_func());
+        llvm::Value *funct_ptr = rop.ll.constant_ptr((void *)clentry->prepare,
+                                                     Strutil::sprintf("osl.closure_prepare.%d", clentry->id),
+                                                     rop.llvm_type_prepare_closure_func());
         llvm::Value *args[] = {render_ptr, id_int, mem_void_ptr};
         rop.ll.call_function (funct_ptr, args);
     } else {
@@ -3352,7 +3545,9 @@ LLVMGEN (llvm_gen_closure)
     // setup(render_services, id, mem_ptr).
     if (clentry->setup) {
         // Call clentry->setup(renderservices *, int id, void *mem)
-        llvm::Value *funct_ptr = rop.ll.constant_ptr((void *)clentry->setup, rop.llvm_type_setup_closure_func());
+        llvm::Value *funct_ptr = rop.ll.constant_ptr((void *)clentry->setup,
+                                                     Strutil::sprintf("osl.closure_setup.%d", clentry->id),
+                                                     rop.llvm_type_setup_closure_func());
         llvm::Value *args[] = {render_ptr, id_int, mem_void_ptr};
         rop.ll.call_function (funct_ptr, args);
     }
@@ -3473,8 +3668,8 @@ LLVMGEN (llvm_gen_pointcloud_search)
     static ustring errorfmt("Arrays too small for pointcloud lookup at (%s:%d)");
     llvm::Value *err_args[] = {
         rop.sg_void_ptr(),
-        rop.ll.constant_ptr ((void *)errorfmt.c_str()),
-        rop.ll.constant_ptr ((void *)op.sourcefile().c_str()),
+        rop.ll.constant (errorfmt),
+        rop.ll.constant (op.sourcefile()),
         rop.ll.constant (op.sourceline()),
     };
     rop.ll.call_function ("osl_error", err_args);
@@ -3533,8 +3728,8 @@ LLVMGEN (llvm_gen_pointcloud_get)
     static ustring errorfmt("Arrays too small for pointcloud attribute get at (%s:%d)");
     llvm::Value *err_args[] = {
         rop.sg_void_ptr(),
-        rop.ll.constant_ptr ((void *)errorfmt.c_str()),
-        rop.ll.constant_ptr ((void *)op.sourcefile().c_str()),
+        rop.ll.constant (errorfmt),
+        rop.ll.constant (op.sourcefile()),
         rop.ll.constant (op.sourceline()),
     };
     rop.ll.call_function ("osl_error", err_args);
@@ -3679,24 +3874,25 @@ LLVMGEN (llvm_gen_split)
              Results.typespec().is_array() &&
              Results.typespec().is_string_based());
 
-    llvm::Value *args[5];
-    args[0] = rop.llvm_load_value (Str);
-    args[1] = rop.llvm_void_ptr (Results);
+    llvm::Value *args[6];
+    args[0] = rop.sg_void_ptr ();
+    args[1] = rop.llvm_load_value (Str);
+    args[2] = rop.llvm_void_ptr (Results);
     if (op.nargs() >= 4) {
         Symbol& Sep = *rop.opargsym (op, 3);
         OSL_DASSERT(Sep.typespec().is_string());
-        args[2] = rop.llvm_load_value (Sep);
+        args[3] = rop.llvm_load_value (Sep);
     } else {
-        args[2] = rop.ll.constant ("");
+        args[3] = rop.ll.constant ("");
     }
     if (op.nargs() >= 5) {
         Symbol& Maxsplit = *rop.opargsym (op, 4);
         OSL_DASSERT(Maxsplit.typespec().is_int());
-        args[3] = rop.llvm_load_value (Maxsplit);
+        args[4] = rop.llvm_load_value (Maxsplit);
     } else {
-        args[3] = rop.ll.constant (Results.typespec().arraylength());
+        args[4] = rop.ll.constant (Results.typespec().arraylength());
     }
-    args[4] = rop.ll.constant (Results.typespec().arraylength());
+    args[5] = rop.ll.constant (Results.typespec().arraylength());
     llvm::Value *ret = rop.ll.call_function ("osl_split", args);
     rop.llvm_store_value (ret, R);
     return true;
@@ -12,6 +12,7 @@
 #include <cxxabi.h>
 #endif
 
+#include <OpenImageIO/SHA1.h>
 #include <OpenImageIO/timer.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/filesystem.h>
@@ -508,10 +509,23 @@ BackendLLVM::llvm_assign_initial_value (const Symbol& sym, bool force)
         llvm::Value* init_val = getOrAllocateCUDAVariable (sym);
         init_val = ll.ptr_cast (init_val, ll.type_void_ptr());
         ll.op_memcpy (groupdata_field_ptr (2 + userdata_index), init_val, 8, 4);
+    } else if (sym.interactive_offset() >= 0) {
+        // interactive param; memcpy its current value from the group's
+        // interactive parameter block, where ReParameter may change it.
+        // The block is found through the context at run time, so the code
+        // holds only its offset and stays cacheable and shareable.
+        TypeDesc t = sym.typespec().simpletype();
+        llvm::Value *arena = ll.call_function ("osl_get_interactive_params",
+                                               sg_void_ptr());
+        ll.op_memcpy (llvm_void_ptr (sym),
+                      ll.offset_ptr (arena, sym.interactive_offset()),
+                      t.size(), t.basesize() /*align*/);
+        if (sym.has_derivs())
+            llvm_zero_derivs (sym);
     } else if (! sym.lockgeom() && ! sym.typespec().is_closure()) {
         // geometrically-varying param; memcpy its default value
         TypeDesc t = sym.typespec().simpletype();
-        ll.op_memcpy (llvm_void_ptr (sym), ll.constant_ptr (sym.data()),
+        ll.op_memcpy (llvm_void_ptr (sym), llvm_constant_data_ptr (sym, sym.data()),
                       t.size(), t.basesize() /*align*/);
         if (sym.has_derivs())
             llvm_zero_derivs (sym);
@@ -753,9 +767,25 @@ BackendLLVM::build_llvm_code (int beginop, int endop, llvm::BasicBlock *bb)
     if (bb)
         ll.set_insert_point (bb);
 
+    // profile=2 times each run of ops from a single source line.  A new
+    // timing segment starts whenever the line changes, at the top of
+    // every block (control can arrive there from anywhere), and after
+    // any op that may run other code (a jump target or an upstream
+    // layer) before control falls through to the next op.
+    bool profile_lines = shadingsys().profile() >= 2 && ! use_optix();
+    ustring prev_file;
+    int prev_line = -1;
+
     for (int opnum = beginop;  opnum < endop;  ++opnum) {
         const Opcode& op = inst()->ops()[opnum];
         const OpDescriptor *opd = shadingsys().op_descriptor (op.opname());
+        if (profile_lines && op.sourcefile()
+              && (op.sourcefile() != prev_file || op.sourceline() != prev_line)) {
+            int site = shadingsys().profile_site (op.sourcefile(), op.sourceline());
+            ll.call_function ("osl_profile_line", sg_void_ptr(), ll.constant (site));
+            prev_file = op.sourcefile();
+            prev_line = op.sourceline();
+        }
         if (opd && opd->llvmgen) {
             if (shadingsys().debug_uninit() /* debug uninitialized vals */)
                 llvm_generate_debug_uninit (op);
@@ -784,6 +814,8 @@ BackendLLVM::build_llvm_code (int beginop, int endop, llvm::BasicBlock *bb)
         int next = op.farthest_jump ();
         if (next >= 0)
             opnum = next-1;
+        if (next >= 0 || op.opname() == op_useparam)
+            prev_line = -1;   // time the next op as a new segment
     }
     return true;
 }
@@ -1121,7 +1153,7 @@ BackendLLVM::initialize_llvm_group ()
 
     // Set up optimization passes. Don't target the host if we're building
     // for OptiX.
-    ll.setup_optimization_passes (shadingsys().llvm_optimize(),
+    ll.setup_optimization_passes (llvm_optimize_level(),
                                   shadingsys().llvm_target_host() && !use_optix());
 
     // Clear the shaderglobals and groupdata types -- they will be
@@ -1178,6 +1210,104 @@ BackendLLVM::initialize_llvm_group ()
 
 
 
+int
+BackendLLVM::llvm_optimize_level ()
+{
+    if (shadingsys().m_llvm_tiered_jit > 0 && ! use_optix())
+        return shadingsys().m_llvm_tiered_jit_level;
+    return shadingsys().llvm_optimize();
+}
+
+
+
+void
+BackendLLVM::run_tier_up ()
+{
+    OIIO::Timer timer;
+    std::string err;
+    std::string &bitcode (group().m_tierup_bitcode);
+    ll.module (ll.module_from_bitcode (bitcode.data(), bitcode.size(),
+                                       "tierup", &err));
+    if (err.length())
+        shadingcontext()->errorf("ParseBitcodeFile returned '%s'\n", err);
+    if (! ll.module() ||
+        ! ll.make_jit_execengine (&err, ll.lookup_isa_by_name(shadingsys().m_llvm_jit_target),
+                                  shadingsys().llvm_debugging_symbols(),
+                                  shadingsys().llvm_profiling_events())) {
+        // Keep running the quick code we already have.
+        shadingcontext()->errorf("Failed to re-JIT group \"%s\": %s\n",
+                                 group().name(), err);
+        bitcode.clear ();
+        return;
+    }
+    ll.InstallLazyFunctionCreator (helper_function_lookup);
+    ll.add_global_mappings (group().m_tierup_mappings);
+    ll.setup_optimization_passes (shadingsys().llvm_optimize(),
+                                  shadingsys().llvm_target_host());
+    m_stat_llvm_setup_time += timer.lap();
+
+    ll.do_optimize();
+    m_stat_llvm_opt_time += timer.lap();
+
+    // JIT everything before publishing anything.  Other threads may be
+    // running the group while we swap, and may end up calling a mix of
+    // old and new functions, which is fine: both were generated from the
+    // same module, so they agree on the groupdata layout.
+    int nlayers = group().nlayers();
+    RunLLVMGroupFunc init = (RunLLVMGroupFunc) ll.getPointerToFunction (
+        ll.module()->getFunction (group().m_tierup_init_name));
+    std::vector<RunLLVMGroupFunc> layers (nlayers, nullptr);
+    for (int layer = 0; layer < nlayers; ++layer) {
+        const std::string &name (group().m_tierup_layer_names[layer]);
+        if (name.size())
+            layers[layer] = (RunLLVMGroupFunc) ll.getPointerToFunction (
+                                ll.module()->getFunction (name));
+    }
+    // The old code stays alive with the group, in case it's still in use.
+    group().add_jit_code (ll.jit_code());
+    for (int layer = 0; layer < nlayers; ++layer)
+        if (layers[layer])
+            group().llvm_compiled_layer (layer, layers[layer]);
+    group().llvm_compiled_init (init);
+    if (! group().num_entry_layers())
+        group().llvm_compiled_version (group().llvm_compiled_layer(nlayers-1));
+
+    ll.execengine (NULL);
+    ll.module (NULL);
+    m_stat_llvm_jit_time += timer.lap();
+    m_stat_total_llvm_time = timer();
+
+    // Done with it, free the memory.
+    std::string().swap (bitcode);
+    LLVM_Util::GlobalMappings().swap (group().m_tierup_mappings);
+    group().m_tierup_layer_names.clear ();
+}
+
+
+
+
+std::string
+BackendLLVM::jit_cache_key ()
+{
+    // The module already captures everything about the group itself (the
+    // masters, instance values, connections, and what the runtime
+    // optimizer made of them), so add to it only what else influences
+    // the machine code we would generate.
+    std::string bitcode = ll.module_bitcode ();
+    std::string options = Strutil::sprintf (
+        "osl %s llvm %d isa %s opt %d fma %d aggressive %d debugsyms %d width %d",
+        OSL_LIBRARY_VERSION_STRING, OSL_LLVM_VERSION,
+        LLVM_Util::target_isa_name (ll.target_isa()),
+        llvm_optimize_level(), (int)shadingsys().m_llvm_jit_fma,
+        (int)shadingsys().m_llvm_jit_aggressive,
+        shadingsys().llvm_debugging_symbols(), shadingsys().m_vector_width);
+    OIIO::SHA1 sha (bitcode.data(), bitcode.size());
+    sha.append (options.data(), options.size());
+    return sha.digest ();
+}
+
+
+
 static void empty_group_func (void*, void*)
 {
 }
@@ -1211,15 +1341,17 @@ BackendLLVM::run ()
 #ifdef OSL_LLVM_NO_BITCODE
     ll.module (ll.new_module ("llvm_ops"));
 #else
+    // The shadeops library is parsed once per thread and cloned for each
+    // group, rather than deserialized from scratch every time.
     if (! use_optix()) {
-        ll.module (ll.module_from_bitcode ((char*)osl_llvm_compiled_ops_block,
-                                           osl_llvm_compiled_ops_size,
-                                           "llvm_ops", &err));
+        ll.module (ll.module_from_bitcode_cached ((char*)osl_llvm_compiled_ops_block,
+                                                  osl_llvm_compiled_ops_size,
+                                                  "llvm_ops", &err));
     } else {
 #ifdef OSL_LLVM_CUDA_BITCODE
-        ll.module (ll.module_from_bitcode ((char*)osl_llvm_compiled_ops_cuda_block,
-                                           osl_llvm_compiled_ops_cuda_size,
-                                           "llvm_ops", &err));
+        ll.module (ll.module_from_bitcode_cached ((char*)osl_llvm_compiled_ops_cuda_block,
+                                                  osl_llvm_compiled_ops_cuda_size,
+                                                  "llvm_ops", &err));
 #else
         OSL_ASSERT (0 && "Must generate LLVM CUDA bitcode for OptiX");
 #endif
@@ -1340,6 +1472,20 @@ BackendLLVM::run ()
         ll.prune_and_internalize_module(external_functions);
     }
 
+    // Groups that generate identical modules can share their machine
+    // code.  The only thing that differs between such modules is the names
+    // of the group's own functions, so give those canonical names.
+    bool dedup = shadingsys().m_jit_dedup && ! use_optix()
+                 && ! group().does_nothing()
+                 && ! shadingsys().llvm_debugging_symbols()
+                 && ! shadingsys().llvm_profiling_events();
+    if (dedup) {
+        init_func->setName ("osl_group_init");
+        for (int layer = 0; layer < nlayers; ++layer)
+            if (funcs[layer])
+                funcs[layer]->setName (Strutil::sprintf ("osl_group_layer_%d", layer));
+    }
+
     // Debug code to dump the pre-optimized bitcode to a file
     if (llvm_debug() >= 2 || shadingsys().llvm_output_bitcode()) {
         // Make a safe group name that doesn't have "/" in it! Also beware
@@ -1360,8 +1506,60 @@ BackendLLVM::run ()
         }
     }
 
+    bool tier_up = llvm_optimize_level() != shadingsys().llvm_optimize()
+                   && ! group().does_nothing();
+
+    std::string module_key;
+    if (dedup || ll.relocatable_constants())
+        module_key = jit_cache_key ();
+
+    // If an identical group has already been compiled in this process,
+    // just use its code.  Tiering up only ever replaces the entry points
+    // of the group that compiled it, so a group sharing it stays at the
+    // quick tier rather than keep a module around and JIT its own copy.
+    if (dedup && shadingsys().jit_dedup_lookup (module_key, group())) {
+        ll.execengine (NULL);
+        ll.module (NULL);
+        m_stat_total_llvm_time = timer();
+        return;
+    }
+
+    // With tiered JIT, hang on to the unoptimized module so that the
+    // group can be JITed again at full optimization once it proves hot.
+    if (tier_up) {
+        group().m_tierup_bitcode = ll.module_bitcode ();
+        group().m_tierup_mappings = ll.global_mappings ();
+        group().m_tierup_init_name = ll.func_name (init_func);
+        group().m_tierup_layer_names.assign (nlayers, std::string());
+        for (int layer = 0; layer < nlayers; ++layer)
+            if (funcs[layer] && group().is_entry_layer (layer))
+                group().m_tierup_layer_names[layer] = ll.func_name (funcs[layer]);
+    }
+
+    // If we've compiled this exact module before, with the same options,
+    // the JIT can load its machine code from the cache and we can skip
+    // optimization altogether.
+    bool jit_cache_hit = false;
+    if (ll.relocatable_constants()) {
+        size_t bytes = 0;
+        switch (ll.jit_object_cache (shadingsys().m_jit_cache_dir,
+                                     module_key, &bytes)) {
+        case LLVM_Util::ObjectCacheResult::Hit:
+            jit_cache_hit = true;
+            shadingsys().m_stat_jit_cache_hits += 1;
+            shadingsys().m_stat_jit_cache_bytes_loaded += (long long)bytes;
+            break;
+        case LLVM_Util::ObjectCacheResult::Miss:
+            shadingsys().m_stat_jit_cache_misses += 1;
+            break;
+        case LLVM_Util::ObjectCacheResult::Uncacheable:
+            shadingsys().m_stat_jit_cache_uncacheable += 1;
+            break;
+        }
+    }
+
     // Optimize the LLVM IR unless it's a do-nothing group.
-    if (! group().does_nothing())
+    if (! group().does_nothing() && ! jit_cache_hit)
         ll.do_optimize();
 
     m_stat_llvm_opt_time += timer.lap();
@@ -1437,6 +1635,11 @@ BackendLLVM::run ()
             group().llvm_compiled_version (NULL);
         else
             group().llvm_compiled_version (group().llvm_compiled_layer(nlayers-1));
+        group().add_jit_code (ll.jit_code());
+        if (dedup)
+            shadingsys().jit_dedup_add (module_key, group(), ll.jit_code());
+        if (tier_up)
+            group().m_tierup_countdown = std::max (1, shadingsys().m_llvm_tiered_jit);
     }
 
     // We are destroying the entire module below,
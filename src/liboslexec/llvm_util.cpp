@@ -3,6 +3,7 @@
 // https://github.com/imageworks/OpenShadingLanguage
 
 
+#include <unordered_map>
 #include <memory>
 #include <cinttypes>
 #include <OpenImageIO/fmath.h>
@@ -53,6 +54,8 @@
 #include <llvm/ExecutionEngine/GenericValue.h>
 #include <llvm/ExecutionEngine/JITEventListener.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/PrettyStackTrace.h>
@@ -70,6 +73,9 @@
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/IPO/FunctionAttrs.h>
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/ExecutionEngine/RuntimeDyld.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Object/SymbolSize.h>
 #include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar/GVN.h>
 #include <llvm/Transforms/Utils.h>
@@ -89,6 +95,10 @@
 #include <optix.h>
 #endif
 
+#ifndef _WIN32
+#include <unistd.h>   // getpid
+#endif
+
 OSL_NAMESPACE_ENTER
 
 namespace pvt {
@@ -164,6 +174,9 @@ LLVM_Util::ScopedJitMemoryUser::~ScopedJitMemoryUser()
 struct LLVM_Util::PerThreadInfo::Impl {
     Impl() {}
     ~Impl() {
+        // The parsed bitcode templates live in llvm_context, so they
+        // must go first.
+        bitcode_modules.clear();
         delete llvm_context;
         // N.B. Do NOT delete the jitmm -- another thread may need the
         // code! Don't worry, we stashed a pointer in jitmm_hold.
@@ -171,6 +184,9 @@ struct LLVM_Util::PerThreadInfo::Impl {
 
     llvm::LLVMContext* llvm_context = nullptr;
     LLVMMemoryManager* llvm_jitmm = nullptr;
+    // Fully parsed modules for module_from_bitcode_cached, keyed on the
+    // address of the bitcode they came from.
+    std::unordered_map<const char*, std::unique_ptr<llvm::Module>> bitcode_modules;
 };
 
 
@@ -285,6 +301,64 @@ public:
 
 
 
+/// ObjectCache - Serves the object code for a single module from (and
+/// saves it to) a file in an on-disk cache directory.  MCJIT asks us for
+/// the object before generating code, and notifies us once it has compiled
+/// one.
+class LLVM_Util::ObjectCache final : public llvm::ObjectCache {
+public:
+    ObjectCache (std::string dir, std::string key)
+        : m_dir(std::move(dir)), m_key(std::move(key)) {}
+
+    /// Try to read the cached object from disk, return its size or 0 if
+    /// there was nothing (usable) there.
+    size_t load () {
+        auto buf = llvm::MemoryBuffer::getFile (path());
+        if (! buf || ! *buf || (*buf)->getBufferSize() == 0)
+            return 0;
+        m_object = std::move (*buf);
+        return m_object->getBufferSize();
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject (const llvm::Module *) override {
+        // MCJIT takes ownership; there is only ever one module per engine.
+        return std::move (m_object);
+    }
+
+    void notifyObjectCompiled (const llvm::Module *,
+                               llvm::MemoryBufferRef obj) override {
+        // Write to a uniquely named temporary and rename it into place,
+        // so that concurrent writers (other threads or processes compiling
+        // the same module) never expose a partially written object.
+        if (llvm::sys::fs::create_directories (m_dir))
+            return;
+        int fd = -1;
+        llvm::SmallString<256> tmppath;
+        if (llvm::sys::fs::createUniqueFile (m_dir + "/" + m_key + "-%%%%%%.tmp",
+                                             fd, tmppath))
+            return;
+        bool ok = false;
+        {
+            llvm::raw_fd_ostream out (fd, /*shouldClose=*/true);
+            out << obj.getBuffer();
+            out.close ();
+            ok = ! out.has_error();
+            out.clear_error ();
+        }
+        if (! ok || llvm::sys::fs::rename (tmppath, path()))
+            llvm::sys::fs::remove (tmppath);
+    }
+
+private:
+    std::string path () const { return m_dir + "/" + m_key + ".o"; }
+
+    std::string m_dir;
+    std::string m_key;
+    std::unique_ptr<llvm::MemoryBuffer> m_object;
+};
+
+
+
 class LLVM_Util::IRBuilder final : public llvm::IRBuilder<llvm::ConstantFolder,
                                                llvm::IRBuilderDefaultInserter> {
     typedef llvm::IRBuilder<llvm::ConstantFolder,
@@ -320,6 +394,7 @@ LLVM_Util::LLVM_Util (const PerThreadInfo &per_thread_info,
       m_vector_width(vector_width),
       m_llvm_type_native_mask(nullptr),
       mVTuneNotifier(nullptr),
+      mPerfNotifier(nullptr),
       m_llvm_debug_builder(nullptr),
       mDebugCU(nullptr),
       mSubTypeForInlinedFunction(nullptr),
@@ -845,6 +920,35 @@ LLVM_Util::module_from_bitcode (const char *bitcode, size_t size,
 }
 
 
+
+llvm::Module *
+LLVM_Util::module_from_bitcode_cached (const char *bitcode, size_t size,
+                                       const std::string &name,
+                                       std::string *err)
+{
+    if (err)
+        err->clear();
+
+    std::unique_ptr<llvm::Module> &templ (m_thread->bitcode_modules[bitcode]);
+    if (! templ) {
+        // First request from this thread: parse the whole thing once.
+        // It can't be lazily loaded, because CloneModule needs every
+        // function body materialized.
+        llvm::MemoryBufferRef buf =
+            llvm::MemoryBufferRef(llvm::StringRef(bitcode, size), name);
+        llvm::Expected<std::unique_ptr<llvm::Module> > ModuleOrErr =
+            llvm::parseBitcodeFile (buf, context());
+        if (! ModuleOrErr) {
+            error_string(ModuleOrErr.takeError(), err);
+            m_thread->bitcode_modules.erase (bitcode);
+            return nullptr;
+        }
+        templ = std::move (*ModuleOrErr);
+    }
+    return llvm::CloneModule (*templ).release();
+}
+
+
 void
 LLVM_Util::push_function_mask(llvm::Value * startMaskValue)
 {
@@ -1319,13 +1423,105 @@ LLVM_Util::supports_isa(TargetISA target)
 
 
 
+namespace {
+
+// JIT event listener that appends a "START SIZE name" line to
+// /tmp/perf-<pid>.map for every function in each object the JIT loads.
+// That is the file perf(1) consults to name samples that land in
+// anonymous executable memory, so shader time gets attributed to the
+// group and layer whose function it was.  It needs no special build of
+// LLVM, unlike the jitdump listener.
+class PerfMapListener final : public llvm::JITEventListener {
+public:
+#if OSL_LLVM_VERSION >= 80
+    void notifyObjectLoaded (ObjectKey, const llvm::object::ObjectFile &obj,
+                             const llvm::RuntimeDyld::LoadedObjectInfo &info) override {
+        write_symbols (obj, info);
+    }
+#else
+    void NotifyObjectEmitted (const llvm::object::ObjectFile &obj,
+                              const llvm::RuntimeDyld::LoadedObjectInfo &info) override {
+        write_symbols (obj, info);
+    }
+#endif
+
+    static PerfMapListener *instance () {
+        static PerfMapListener listener;
+        return &listener;
+    }
+
+private:
+    void write_symbols (const llvm::object::ObjectFile &obj,
+                        const llvm::RuntimeDyld::LoadedObjectInfo &info)
+    {
+#ifndef _WIN32
+        // The debug copy of the object has its sections relocated to
+        // where they were loaded, so symbol addresses are the real ones.
+        llvm::object::OwningBinary<llvm::object::ObjectFile> debugobj
+            = info.getObjectForDebug (obj);
+        if (! debugobj.getBinary())
+            return;
+        OIIO::spin_lock lock (m_mutex);
+        if (! m_file) {
+            std::string filename = OIIO::Strutil::sprintf ("/tmp/perf-%d.map",
+                                                           (int)getpid());
+            m_file = fopen (filename.c_str(), "a");
+            if (! m_file)
+                return;
+        }
+        for (const auto &symsize : llvm::object::computeSymbolSizes (*debugobj.getBinary())) {
+            const llvm::object::SymbolRef &sym (symsize.first);
+            auto type = sym.getType();
+            if (! type) {
+                llvm::consumeError (type.takeError());
+                continue;
+            }
+            if (*type != llvm::object::SymbolRef::ST_Function || ! symsize.second)
+                continue;
+            auto name = sym.getName();
+            if (! name) {
+                llvm::consumeError (name.takeError());
+                continue;
+            }
+            auto addr = sym.getAddress();
+            if (! addr) {
+                llvm::consumeError (addr.takeError());
+                continue;
+            }
+            fprintf (m_file, "%llx %llx %s\n", (unsigned long long)*addr,
+                     (unsigned long long)symsize.second, name->str().c_str());
+        }
+        fflush (m_file);
+#endif
+    }
+
+    OIIO::spin_mutex m_mutex;
+    FILE *m_file = nullptr;   // Left open for the life of the process
+};
+
+}  // anonymous namespace
+
+
+
+llvm::ExecutionEngine *
+LLVM_Util::make_jit_execengine (std::string *err,
+                                TargetISA requestedISA,
+                                bool debugging_symbols,
+                                bool profiling_events)
+{
+    return make_jit_execengine (err, requestedISA, debugging_symbols,
+                                profiling_events ? 1 : 0);
+}
+
+
+
 // N.B. This method is never called for PTX generation, so don't be alarmed
 // if it's doing x86 specific things.
 llvm::ExecutionEngine *
 LLVM_Util::make_jit_execengine (std::string *err,
                                 TargetISA requestedISA,
                                 bool debugging_symbols,
-                                bool profiling_events)
+                                int profiling_events)
 {
 #if OSL_GNUC_VERSION && OSL_LLVM_VERSION < 71
     // Due to ABI breakage in LLVM 7.0.[0-1] for llvm::Optional with GCC,
@@ -1337,6 +1533,7 @@ LLVM_Util::make_jit_execengine (std::string *err,
 #endif
 
     execengine (NULL);   // delete and clear any existing engine
+    m_global_mappings.clear ();
     if (err)
         err->clear ();
     llvm::EngineBuilder engine_builder ((std::unique_ptr<llvm::Module>(module())));
@@ -1347,9 +1544,18 @@ LLVM_Util::make_jit_execengine (std::string *err,
     //engine_builder.setCodeModel(llvm::CodeModel::Default);
     engine_builder.setVerifyModules(true);
 
-    // We are actually holding a LLVMMemoryManager
+    // We are actually holding a LLVMMemoryManager -- either the shared
+    // per-thread one, or a private one whose lifetime is tied to the
+    // handle given out by jit_code().
+    LLVMMemoryManager *jitmm = m_llvm_jitmm;
+    m_jit_code.reset ();
+    if (m_own_jit_code) {
+        std::shared_ptr<LLVMMemoryManager> mm (new LLVMMemoryManager(&llvm_default_mapper));
+        jitmm = mm.get();
+        m_jit_code = std::move (mm);
+    }
     engine_builder.setMCJITMemoryManager (std::unique_ptr<llvm::RTDyldMemoryManager>
-        (new MemoryManager(m_llvm_jitmm)));
+        (new MemoryManager(jitmm)));
 
     engine_builder.setOptLevel (jit_aggressive()
                                 ? llvm::CodeGenOpt::Aggressive
@@ -1450,7 +1656,16 @@ LLVM_Util::make_jit_execengine (std::string *err,
         m_llvm_exec->RegisterJITEventListener(llvm::JITEventListener::createGDBRegistrationListener());
     }
 
-    if (profiling_events) {
+    if (profiling_events == 2 || profiling_events == 3) {
+        // Let perf(1) name the JITed functions.  LLVM's own listener writes
+        // the richer jitdump format, but only exists if LLVM was built
+        // with -DLLVM_USE_PERF=ON; otherwise fall back to a perf map.
+        if (profiling_events == 3)
+            mPerfNotifier = llvm::JITEventListener::createPerfJITEventListener();
+        if (! mPerfNotifier)
+            mPerfNotifier = PerfMapListener::instance();
+        m_llvm_exec->RegisterJITEventListener(mPerfNotifier);
+    } else if (profiling_events) {
         // These magic lines will make it so that enough symbol information
         // is injected so that running vtune will kinda tell you which shaders
         // you're in, and sometimes which function (only for functions that don't
@@ -1574,6 +1789,11 @@ LLVM_Util::execengine (llvm::ExecutionEngine *exec)
             delete mVTuneNotifier;
             mVTuneNotifier = nullptr;
         }
+        if (nullptr != mPerfNotifier) {
+            // Both perf listeners are static objects, don't delete them.
+            m_llvm_exec->UnregisterJITEventListener(mPerfNotifier);
+            mPerfNotifier = nullptr;
+        }
 
         if (debug_is_enabled()) {
             // We explicitly remove the GDB listener, so it can't be notified of the object's release.
@@ -1587,6 +1807,68 @@ LLVM_Util::execengine (llvm::ExecutionEngine *exec)
         delete m_llvm_exec;
     }
     m_llvm_exec = exec;
+    // The cache only serves the engine it was installed on
+    delete m_object_cache;
+    m_object_cache = nullptr;
+}
+
+
+
+// Does the value refer (possibly through constant expressions) to a
+// non-null absolute address baked in as an integer?
+static bool
+refers_to_absolute_address (const llvm::Value *v,
+                            std::unordered_set<const llvm::Value*> &visited)
+{
+    const llvm::ConstantExpr *ce = llvm::dyn_cast<llvm::ConstantExpr>(v);
+    if (! ce || ! visited.insert(ce).second)
+        return false;
+    if (ce->getOpcode() == llvm::Instruction::IntToPtr) {
+        const llvm::Constant *addr = ce->getOperand(0);
+        return ! addr->isNullValue();
+    }
+    for (const llvm::Use &op : ce->operands())
+        if (refers_to_absolute_address (op.get(), visited))
+            return true;
+    return false;
+}
+
+
+
+LLVM_Util::ObjectCacheResult
+LLVM_Util::jit_object_cache (string_view dir, string_view key,
+                             size_t *bytes_loaded)
+{
+    OSL_ASSERT (m_llvm_exec && "jit_object_cache requires an ExecutionEngine");
+
+    // Object code that bakes in addresses of this process's data would be
+    // garbage in any other process, so never cache such a module.
+    std::unordered_set<const llvm::Value*> visited;
+    for (const llvm::Function &func : *module()) {
+        for (const llvm::BasicBlock &bb : func) {
+            for (const llvm::Instruction &inst : bb) {
+                if (llvm::isa<llvm::IntToPtrInst>(inst) &&
+                        llvm::isa<llvm::ConstantInt>(inst.getOperand(0)) &&
+                        ! llvm::cast<llvm::ConstantInt>(inst.getOperand(0))->isZero())
+                    return ObjectCacheResult::Uncacheable;
+                for (const llvm::Use &op : inst.operands())
+                    if (refers_to_absolute_address (op.get(), visited))
+                        return ObjectCacheResult::Uncacheable;
+            }
+        }
+    }
+    for (const llvm::GlobalVariable &global : module()->globals())
+        if (global.hasInitializer() &&
+                refers_to_absolute_address (global.getInitializer(), visited))
+            return ObjectCacheResult::Uncacheable;
+
+    delete m_object_cache;
+    m_object_cache = new ObjectCache (std::string(dir), std::string(key));
+    m_llvm_exec->setObjectCache (m_object_cache);
+    size_t size = m_object_cache->load ();
+    if (bytes_loaded)
+        *bytes_loaded = size;
+    return size ? ObjectCacheResult::Hit : ObjectCacheResult::Miss;
 }
 
 
@@ -2326,6 +2608,20 @@ void
 LLVM_Util::add_function_mapping (llvm::Function *func, void *addr)
 {
     execengine()->addGlobalMapping (func, addr);
+    m_global_mappings.emplace_back (func->getName().str(), addr);
+}
+
+
+
+void
+LLVM_Util::add_global_mappings (const GlobalMappings &mappings)
+{
+    for (auto&& m : mappings) {
+        if (llvm::GlobalValue *g = module()->getNamedValue (m.first)) {
+            execengine()->addGlobalMapping (g, m.second);
+            m_global_mappings.push_back (m);
+        }
+    }
 }
 
 
@@ -2676,9 +2972,50 @@ LLVM_Util::constant_ptr (void *p, llvm::PointerType *type)
 
 
 
+llvm::Value *
+LLVM_Util::constant_ptr (void *p, string_view name, llvm::PointerType *type)
+{
+    if (! m_relocatable_constants)
+        return constant_ptr (p, type);
+    if (! type)
+        type = type_void_ptr();
+    std::string sname (name);
+    llvm::GlobalVariable *g = module()->getGlobalVariable (sname);
+    if (! g) {
+        g = new llvm::GlobalVariable (*module(), type_char(), true,
+                                      llvm::GlobalValue::ExternalLinkage,
+                                      nullptr, sname);
+        execengine()->addGlobalMapping (g, p);
+        m_global_mappings.emplace_back (sname, p);
+    }
+    return builder().CreatePointerCast (g, type, "const pointer");
+}
+
+
+
 llvm::Value *
 LLVM_Util::constant (ustring s)
 {
+    if (m_relocatable_constants && s.c_str()) {
+        // Refer to the characters through an external symbol whose name
+        // spells out the string, and tell the engine where it lives.
+        std::string name = "osl.ustr.";
+        name.reserve (name.size() + 2 * s.length());
+        static const char hexdigits[] = "0123456789abcdef";
+        for (unsigned char c : s.string()) {
+            name += hexdigits[c >> 4];
+            name += hexdigits[c & 15];
+        }
+        llvm::GlobalVariable *g = module()->getGlobalVariable (name);
+        if (! g) {
+            g = new llvm::GlobalVariable (*module(), type_char(), true,
+                                          llvm::GlobalValue::ExternalLinkage,
+                                          nullptr, name);
+            execengine()->addGlobalMapping (g, (void *)s.c_str());
+            m_global_mappings.emplace_back (name, (void *)s.c_str());
+        }
+        return builder().CreatePointerCast (g, type_string(), "ustring constant");
+    }
     // Create a const size_t with the ustring contents
     size_t bits = sizeof(size_t)*8;
     llvm::Value *str = llvm::ConstantInt::get (context(),
@@ -5421,6 +5758,17 @@ LLVM_Util::module_string()
 
 
 
+std::string
+LLVM_Util::module_bitcode ()
+{
+    std::string s;
+    llvm::raw_string_ostream stream (s);
+    llvm::WriteBitcodeToFile (*module(), stream);
+    return stream.str();
+}
+
+
+
 void
 LLVM_Util::delete_func_body (llvm::Function *func)
 {
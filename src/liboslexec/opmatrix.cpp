@@ -138,16 +138,24 @@ osl_get_matrix (void *sg_, void *r, const char *from)
         MAT(r).makeIdentity ();
         return true;
     }
+    // Shaders tend to transform to and from the same few spaces over and
+    // over, so remember what the renderer told us for this execution.
+    if (ctx->find_cached_matrix (USTR(from), sg->time, false, MAT(r)))
+        return true;
     if (USTR(from) == Strings::shader) {
         ctx->renderer()->get_matrix (sg, MAT(r), sg->shader2common, sg->time);
+        ctx->cache_matrix (USTR(from), sg->time, false, MAT(r));
         return true;
     }
     if (USTR(from) == Strings::object) {
         ctx->renderer()->get_matrix (sg, MAT(r), sg->object2common, sg->time);
+        ctx->cache_matrix (USTR(from), sg->time, false, MAT(r));
         return true;
     }
     int ok = ctx->renderer()->get_matrix (sg, MAT(r), USTR(from), sg->time);
-    if (! ok) {
+    if (ok) {
+        ctx->cache_matrix (USTR(from), sg->time, false, MAT(r));
+    } else {
         MAT(r).makeIdentity();
         ShadingContext *ctx = (ShadingContext *)((ShaderGlobals *)sg)->context;
         if (ctx->shadingsys().unknown_coordsys_error())
@@ -168,16 +176,22 @@ osl_get_inverse_matrix (void *sg_, void *r, const char *to)
         MAT(r).makeIdentity ();
         return true;
     }
+    if (ctx->find_cached_matrix (USTR(to), sg->time, true, MAT(r)))
+        return true;
     if (USTR(to) == Strings::shader) {
         ctx->renderer()->get_inverse_matrix (sg, MAT(r), sg->shader2common, sg->time);
+        ctx->cache_matrix (USTR(to), sg->time, true, MAT(r));
         return true;
     }
     if (USTR(to) == Strings::object) {
         ctx->renderer()->get_inverse_matrix (sg, MAT(r), sg->object2common, sg->time);
+        ctx->cache_matrix (USTR(to), sg->time, true, MAT(r));
         return true;
     }
     int ok = ctx->renderer()->get_inverse_matrix (sg, MAT(r), USTR(to), sg->time);
-    if (! ok) {
+    if (ok) {
+        ctx->cache_matrix (USTR(to), sg->time, true, MAT(r));
+    } else {
         MAT(r).makeIdentity ();
         ShadingContext *ctx = (ShadingContext *)((ShaderGlobals *)sg)->context;
         if (ctx->shadingsys().unknown_coordsys_error())
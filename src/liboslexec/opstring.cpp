@@ -11,6 +11,8 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include <cstdarg>
+#include <cstdio>
+#include <cstring>
 
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/filesystem.h>
@@ -27,8 +29,12 @@ namespace pvt {
 
 // Only define 2-arg version of concat, sort it out upstream
 OSL_SHADEOP const char *
-osl_concat_sss (const char *s, const char *t)
+osl_concat_sss (void *sg_, const char *s, const char *t)
 {
+    ShadingContext *ctx = ((ShaderGlobals *)sg_)->context;
+    const char *result;
+    if (ctx->find_string_op (ShadingContext::StringOpConcat, s, t, 0, 0, result))
+        return result;
     size_t sl = USTR(s).length();
     size_t tl = USTR(t).length();
     size_t len = sl + tl;
@@ -41,7 +47,9 @@ osl_concat_sss (const char *s, const char *t)
     }
     memcpy(buf     , s, sl);
     memcpy(buf + sl, t, tl);
-    return ustring(buf, len).c_str();
+    result = ctx->make_ustring (string_view (buf, len)).c_str();
+    ctx->cache_string_op (ShadingContext::StringOpConcat, s, t, 0, 0, result);
+    return result;
 }
 
 OSL_SHADEOP int
@@ -104,60 +112,134 @@ osl_stof_fs (const char *str)
 }
 
 OSL_SHADEOP const char *
-osl_substr_ssii (const char *s_, int start, int length)
+osl_substr_ssii (void *sg_, const char *s_, int start, int length)
 {
     ustring s (USTR(s_));
     int slen = int (s.length());
     if (slen == 0)
         return NULL;  // No substring of empty string
+    ShadingContext *ctx = ((ShaderGlobals *)sg_)->context;
+    const char *result;
+    if (ctx->find_string_op (ShadingContext::StringOpSubstr, s_, NULL,
+                             start, length, result))
+        return result;
     int b = start;
     if (b < 0)
         b += slen;
     b = Imath::clamp (b, 0, slen);
-    return ustring(s, b, Imath::clamp (length, 0, slen)).c_str();
+    int len = std::min (Imath::clamp (length, 0, slen), slen - b);
+    result = ctx->make_ustring (string_view (s.c_str() + b, len)).c_str();
+    ctx->cache_string_op (ShadingContext::StringOpSubstr, s_, NULL,
+                          start, length, result);
+    return result;
 }
 
 
-OSL_SHADEOP int
-osl_regex_impl (void *sg_, const char *subject_, void *results, int nresults,
-                const char *pattern, int fullmatch)
+CompiledRegex::CompiledRegex (ustring pattern)
+    : m_pattern(pattern),
+      m_literal(pattern.find_first_of ("\\^$.|?*+()[]{}") == ustring::npos)
 {
-    ShaderGlobals *sg = (ShaderGlobals *)sg_;
-    ShadingContext *ctx = sg->context;
-    const std::string &subject (ustring::from_unique(subject_).string());
-    match_results<std::string::const_iterator> mresults;
-    const regex &regex (ctx->find_regex (USTR(pattern)));
+    if (! m_literal) {
+        try {
+            m_regex.reset (new regex (pattern.c_str()));
+        } catch (const std::exception&) {
+            // Leave m_regex empty: an invalid pattern matches nothing
+        }
+    }
+}
+
+
+
+int
+CompiledRegex::match (ustring subject, int *results, int nresults,
+                      bool fullmatch) const
+{
+    if (m_literal) {
+        size_t pos = 0;
+        bool found = fullmatch ? (subject == m_pattern ||
+                                  (subject.empty() && m_pattern.empty()))
+                               : (pos = subject.find (m_pattern)) != ustring::npos;
+        // A literal pattern has no subexpressions: only the whole match
+        for (int r = 0;  r < nresults;  ++r) {
+            if (found && r < 2)
+                results[r] = int (r == 0 ? pos : pos + m_pattern.length());
+            else
+                results[r] = int (m_pattern.length());
+        }
+        return found;
+    }
+
+    if (! m_regex) {
+        for (int r = 0;  r < nresults;  ++r)
+            results[r] = int (m_pattern.length());
+        return 0;
+    }
+
+    const std::string &str (subject.string());
     if (nresults > 0) {
-        std::string::const_iterator start = subject.begin();
-        int res = fullmatch ? regex_match (subject, mresults, regex)
-                            : regex_search (subject, mresults, regex);
-        int *m = (int *)results;
+        match_results<std::string::const_iterator> mresults;
+        std::string::const_iterator start = str.begin();
+        int res = fullmatch ? regex_match (str, mresults, *m_regex)
+                            : regex_search (str, mresults, *m_regex);
         for (int r = 0;  r < nresults;  ++r) {
             if (r/2 < (int)mresults.size()) {
                 if ((r & 1) == 0)
-                    m[r] = mresults[r/2].first - start;
+                    results[r] = mresults[r/2].first - start;
                 else
-                    m[r] = mresults[r/2].second - start;
+                    results[r] = mresults[r/2].second - start;
             } else {
-                m[r] = USTR(pattern).length();
+                results[r] = m_pattern.length();
             }
         }
         return res;
     } else {
-        return fullmatch ? regex_match (subject, regex)
-                         : regex_search (subject, regex);
+        return fullmatch ? regex_match (str, *m_regex)
+                         : regex_search (str, *m_regex);
     }
 }
 
 
+
+OSL_SHADEOP int
+osl_regex_impl (void *sg_, const char *subject_, void *results, int nresults,
+                const char *pattern, int fullmatch)
+{
+    ShaderGlobals *sg = (ShaderGlobals *)sg_;
+    ShadingContext *ctx = sg->context;
+    const CompiledRegex &regex (ctx->find_regex (USTR(pattern)));
+    return regex.match (USTR(subject_), (int *)results, nresults, fullmatch);
+}
+
+
+
+// Constant patterns are compiled when the shader is JITed, and the
+// CompiledRegex passed straight in.
+OSL_SHADEOP int
+osl_regex_compiled_impl (const char *subject_, void *results, int nresults,
+                         const void *regex, int fullmatch)
+{
+    return ((const CompiledRegex *)regex)->match (USTR(subject_), (int *)results,
+                                                  nresults, fullmatch);
+}
+
+
 OSL_SHADEOP const char *
-osl_format (const char* format_str, ...)
+osl_format (ShaderGlobals *sg, const char* format_str, ...)
 {
+    // Nearly all formatted strings are short: build them on the stack,
+    // and let the context decide if it needs a new ustring for them.
+    char local_buf[256];
     va_list args;
+    va_start (args, format_str);
+    int len = vsnprintf (local_buf, sizeof(local_buf), format_str, args);
+    va_end (args);
+    if (len >= 0 && len < int(sizeof(local_buf)))
+        return sg->context->make_ustring (string_view (local_buf, len)).c_str();
+
     va_start (args, format_str);
     std::string s = Strutil::vsprintf (format_str, args);
     va_end (args);
-    return ustring(s).c_str();
+    return sg->context->make_ustring (s).c_str();
 }
 
 
@@ -221,15 +303,15 @@ osl_fprintf (ShaderGlobals* /*sg*/, const char *filename,
 
 
 OSL_SHADEOP int
-osl_split (const char *str, ustring *results, const char *sep,
-           int maxsplit, int resultslen)
+osl_split (ShaderGlobals *sg, const char *str, ustring *results,
+           const char *sep, int maxsplit, int resultslen)
 {
     maxsplit = OIIO::clamp (maxsplit, 0, resultslen);
     std::vector<std::string> splits;
     Strutil::split (USTR(str).string(), splits, USTR(sep).string(), maxsplit);
     int n = std::min (maxsplit, (int)splits.size());
     for (int i = 0;  i < n;  ++i)
-        results[i] = ustring(splits[i]);
+        results[i] = sg->context->make_ustring (splits[i]);
     return n;
 }
 
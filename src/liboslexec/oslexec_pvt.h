@@ -12,6 +12,11 @@
 #include <list>
 #include <set>
 #include <unordered_map>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <future>
+#include <atomic>
 
 #include <boost/thread/tss.hpp>   /* for thread_specific_ptr */
 
@@ -57,6 +62,9 @@ using OIIO::mutex;
 using OIIO::lock_guard;
 using OIIO::spin_mutex;
 using OIIO::spin_lock;
+using OIIO::spin_rw_mutex;
+using OIIO::spin_rw_read_lock;
+using OIIO::spin_rw_write_lock;
 using OIIO::ustringHash;
 namespace Strutil = OIIO::Strutil;
 
@@ -100,6 +108,7 @@ class ShadingSystemImpl;
 class ShaderInstance;
 typedef std::shared_ptr<ShaderInstance> ShaderInstanceRef;
 class Dictionary;
+class DictionaryMemo;
 class RuntimeOptimizer;
 class BackendLLVM;
 struct ConnectedParam;
@@ -356,6 +365,8 @@ public:
 
     int num_params () const { return m_lastparam - m_firstparam; }
 
+    int num_ops () const { return (int) m_ops.size(); }
+
     int raytype_queries () const { return m_raytype_queries; }
 
     bool range_checking() const { return m_range_checking; }
@@ -431,6 +442,35 @@ private:
 
 
 
+/// A pattern for regex_search/regex_match, compiled once and shared by
+/// every context and shader group that uses it.  Patterns that contain
+/// no special characters at all -- plain words, which are what shaders
+/// ask for most of the time -- are matched with simple string compares
+/// rather than by the regex engine.
+class CompiledRegex {
+public:
+    CompiledRegex (ustring pattern);
+
+    /// Search (or, if fullmatch is true, match the whole of) subject.
+    /// If nresults > 0, fill results[] with the begin/end offsets of the
+    /// match and its subexpressions (the pattern length for those that
+    /// did not participate).  Return 1 for a match, 0 otherwise.
+    int match (ustring subject, int *results, int nresults,
+               bool fullmatch) const;
+
+    ustring pattern () const { return m_pattern; }
+
+    /// Did the pattern compile?  (An invalid pattern never matches.)
+    bool valid () const { return m_literal || m_regex; }
+
+private:
+    ustring m_pattern;
+    bool m_literal;                   ///< No special chars in the pattern
+    std::unique_ptr<regex> m_regex;   ///< Compiled pattern if !m_literal
+};
+
+
+
 class ShadingSystemImpl
 {
 public:
@@ -458,7 +498,7 @@ public:
     bool LoadMemoryCompiledShader (string_view shadername,
                                    string_view buffer);
     bool Parameter (ShaderGroup& group, string_view name, TypeDesc t,
-                    const void *val, bool lockgeom);
+                    const void *val, bool lockgeom, bool interactive=false);
     bool Parameter (string_view name, TypeDesc t, const void *val,
                     bool lockgeom);
     bool Shader (ShaderGroup& group, string_view shaderusage,
@@ -479,6 +519,8 @@ public:
     bool ReParameter (ShaderGroup &group,
                       string_view layername, string_view paramname,
                       TypeDesc type, const void *val);
+    ShaderGroupRef PromoteInteractiveParameters (ShaderGroup &group,
+                                                 int priority);
 
     // Internal error, warning, info, and message reporting routines that
     // take printf-like arguments.
@@ -508,6 +550,20 @@ public:
 
     std::string getstats (int level=1) const;
 
+    void invalidate_attribute_cache () { ++m_attribute_cache_generation; }
+
+    /// Does the renderer answer attribute_invariance (i.e., does it
+    /// support the "attribute_invariance" feature)?
+    bool use_attribute_invariance () const { return m_use_attribute_invariance; }
+
+    /// Return the compiled form of a regex pattern, compiling it if this
+    /// is the first time any context or group has asked for it.
+    const CompiledRegex & find_regex (ustring pattern);
+
+    /// The dictionary cache (for dict_find et al.) shared by all of our
+    /// contexts, created on first use.
+    Dictionary *dictionary ();
+
     ErrorHandler &errhandler () const { return *m_err; }
 
     ShaderMaster::ref loadshader (string_view name);
@@ -523,6 +579,9 @@ public:
 
     bool execute (ShadingContext &ctx, ShaderGroup &group,
                   ShaderGlobals &ssg, bool run=true);
+    bool execute_nonblocking (ShadingContext &ctx, ShaderGroup &group,
+                              ShaderGlobals &ssg, bool &ready,
+                              int priority=0, bool run=true);
     // DEPRECATED(2.0):
     bool execute (ShadingContext *ctx, ShaderGroup &group,
                   ShaderGlobals &ssg, bool run=true);
@@ -620,7 +679,51 @@ public:
 
     int raytype_bit (ustring name);
 
-    void optimize_all_groups (int nthreads=0, int mythread=0, int totalthreads=1, bool do_jit=true);
+    void optimize_all_groups (int nthreads=0, bool do_jit=true,
+                              const ShadingSystem::Executor *executor=nullptr);
+
+    /// Call compile(group,ctx) for every complete group for which
+    /// needs_work(group) is true, spread over nthreads workers (0 = one per
+    /// hardware core) from the executor, or else from the OIIO thread pool
+    /// plus the calling thread.  Workers pull groups off a shared cursor,
+    /// optionally most expensive first, so no worker idles while another
+    /// still has a backlog.
+    void compile_groups_parallel (int nthreads, const ShadingSystem::Executor *executor,
+                                  const std::function<bool(ShaderGroup&)> &needs_work,
+                                  const std::function<void(ShaderGroup&,ShadingContext*)> &compile);
+
+    /// Queue the group for optimization and JIT by the background compile
+    /// threads.  Return true if it's already ready to run.
+    bool compile_async (ShaderGroup &group, int priority=0);
+
+    /// Remove the group from the background compile queue, returning true
+    /// if it was still waiting there.
+    bool cancel_compile_async (ShaderGroup &group);
+
+    /// The group, JITed at the quick "llvm_tiered_jit_level", has run
+    /// often enough to deserve fully optimized code: queue it for
+    /// tier_up_group on the background compile threads.
+    void request_tier_up (ShaderGroup &group);
+
+    /// Open, in the background, every texture in the optimized group's
+    /// textures_needed list that hasn't been warmed up before.  A level of
+    /// 2 also reads the coarsest MIP level of each one.  If wait is true,
+    /// don't return until this batch is done.
+    void warmup_textures (ShaderGroup &group, int level, bool wait=false);
+    int texture_warmup () const { return m_texture_warmup; }
+
+    /// Recompile a quick-JITed group at the full llvm_optimize level and
+    /// swap the new code in.
+    void tier_up_group (ShaderGroup &group, ShadingContext *ctx);
+
+    /// If a group whose generated module hashed to 'key' has already been
+    /// JITed, and its code is still alive, give the same entry points to
+    /// 'group' and return true.
+    bool jit_dedup_lookup (const std::string &key, ShaderGroup &group);
+
+    /// Remember the freshly JITed entry points of 'group' under 'key'.
+    void jit_dedup_add (const std::string &key, const ShaderGroup &group,
+                        const LLVM_Util::JitCodeHandle &code);
 
     typedef std::unordered_map<ustring,OpDescriptor,ustringHash> OpDescriptorMap;
 
@@ -644,8 +747,22 @@ public:
     /// archive.
     bool archive_shadergroup (ShaderGroup& group, string_view filename);
 
+    /// Make a new, empty group and record it in the census, without
+    /// making it the "current" group of the non-threadsafe calls.
+    ShaderGroupRef new_group (string_view groupname);
+
+    /// Build the network described by groupspec (in the format that
+    /// ShaderGroupBegin accepts) into group, reporting any errors.
+    bool parse_group_spec (ShaderGroup& group, string_view usage,
+                           string_view groupspec);
+
     void count_noise () { m_stat_noise_calls += 1; }
 
+    /// With profile=2, JITed code reports the time spent in each stretch
+    /// of ops that came from one source line.  Return the (stable) index
+    /// of the profile site for the given line, making one if needed.
+    int profile_site (ustring sourcefile, int sourceline);
+
     ColorSystem& colorsystem() { return m_colorsystem; }
 
     template <typename Color> bool
@@ -666,7 +783,7 @@ public:
         /// Ensure that the group has been JITed.
         void jit_group (ShaderGroup &group, ShadingContext *ctx);
 
-        void jit_all_groups (int nthreads=0, int mythread=0, int totalthreads=1);
+        void jit_all_groups (int nthreads=0);
     };
 
     template<int WidthT>
@@ -677,6 +794,9 @@ public:
 private:
     void printstats () const;
 
+    /// Delete the shared dictionary cache.
+    void free_dict_resources ();
+
     /// Find the index of the named layer in the shader group.
     /// If found, return the index >= 0 and put a pointer to the instance
     /// in inst; if not found, return -1 and set inst to NULL.
@@ -748,6 +868,10 @@ private:
     bool m_unknown_coordsys_error;        ///< Error to use unknown xform name?
     bool m_connection_error;              ///< Error for ConnectShaders to fail?
     bool m_greedyjit;                     ///< JIT as much as we can?
+    bool m_jit_cost_order;                ///< Compile biggest groups first?
+    int m_llvm_tiered_jit;                ///< Executions before re-JIT (0=off)
+    int m_llvm_tiered_jit_level;          ///< llvm_optimize for first JIT
+    bool m_jit_dedup;                     ///< Share code of identical groups?
     bool m_countlayerexecs;               ///< Count number of layer execs?
     bool m_relaxed_param_typecheck;       ///< Allow parameters to be set from isomorphic types (same data layout)
     int m_max_warnings_per_thread;        ///< How many warnings to display per thread before giving up?
@@ -792,6 +916,7 @@ private:
     ustring m_only_groupname;             ///< Name of sole group to compile
     ustring m_archive_groupname;          ///< Name of group to pickle/archive
     ustring m_archive_filename;           ///< Name of filename for group archive
+    ustring m_jit_cache_dir;              ///< Directory for cached JIT object code
     std::string m_searchpath;             ///< Shader search path
     std::vector<std::string> m_searchpath_dirs; ///< All searchpath dirs
     std::string m_library_searchpath;     ///< Library search path
@@ -843,6 +968,17 @@ private:
     atomic_int m_stat_global_connections; ///< Stat: global connections elim'd
     atomic_int m_stat_tex_calls_codegened;///< Stat: total texture calls
     atomic_int m_stat_tex_calls_as_handles;///< Stat: texture calls with handles
+    atomic_int m_stat_groups_tiered_up;   ///< Stat: groups re-JITed optimized
+    atomic_int m_stat_groups_deduped;     ///< Stat: groups sharing JIT code
+    atomic_int m_stat_async_jit_queued;   ///< Stat: groups queued for async JIT
+    atomic_int m_stat_async_jit_compiled; ///< Stat: groups compiled async
+    atomic_int m_stat_async_jit_cancelled; ///< Stat: async requests dropped
+    atomic_int m_stat_jit_cache_hits;     ///< Stat: groups loaded from JIT cache
+    atomic_int m_stat_jit_cache_misses;   ///< Stat: groups added to JIT cache
+    atomic_int m_stat_jit_cache_uncacheable; ///< Stat: groups not cacheable
+    atomic_ll m_stat_jit_cache_bytes_loaded; ///< Stat: bytes read from JIT cache
+    atomic_int m_stat_textures_warmed;    ///< Stat: textures opened by warmup
+    atomic_int m_stat_texture_warmup_failed; ///< Stat: warmups that failed
     double m_stat_master_load_time;       ///< Stat: time loading masters
     double m_stat_optimization_time;      ///< Stat: time spent optimizing
     double m_stat_opt_locking_time;       ///<   locking time
@@ -852,11 +988,20 @@ private:
     double m_stat_llvm_irgen_time;        ///<     llvm IR generation time
     double m_stat_llvm_opt_time;          ///<     llvm IR optimization time
     double m_stat_llvm_jit_time;          ///<     llvm JIT time
+    int m_stat_parallel_compiles;         ///< Stat: compile_groups_parallel calls
+    double m_stat_parallel_compile_time;  ///< Stat: ... their wall clock time
+    double m_stat_parallel_compile_capacity; ///< Stat: ... times # of workers
+    std::vector<double> m_stat_compile_worker_busy; ///< Stat: ... per worker
     double m_stat_inst_merge_time;        ///< Stat: time merging instances
     double m_stat_getattribute_time;      ///< Stat: time spent in getattribute
     double m_stat_getattribute_fail_time; ///< Stat: time spent in getattribute
     atomic_ll m_stat_getattribute_calls;  ///< Stat: Number of getattribute
+    atomic_ll m_stat_getattribute_cache_hits; ///< Stat: ...answered from cache
     atomic_ll m_stat_get_userdata_calls;  ///< Stat: # of get_userdata calls
+    atomic_ll m_stat_matrix_cache_hits;   ///< Stat: transforms from cache
+    atomic_ll m_stat_matrix_cache_misses; ///< Stat: ...asked of the renderer
+    atomic_ll m_stat_string_cache_hits;   ///< Stat: shadeop strings from cache
+    atomic_ll m_stat_string_cache_misses; ///< Stat: ...from the ustring table
     atomic_ll m_stat_noise_calls;         ///< Stat: # of noise calls
     long long m_stat_pointcloud_searches;
     long long m_stat_pointcloud_searches_total_results;
@@ -893,9 +1038,84 @@ private:
 
     atomic_int m_groups_to_compile_count;
     atomic_int m_threads_currently_compiling;
+
+    // Bumped by invalidate_attribute_cache; a context drops its cached
+    // attributes when this differs from the value it last saw.
+    atomic_int m_attribute_cache_generation {0};
+    bool m_use_attribute_invariance = false; ///< renderer supports it?
+
+    // Compiled regex patterns, shared by all contexts and groups.
+    typedef std::unordered_map<ustring, std::unique_ptr<CompiledRegex>, ustringHash> RegexMap;
+    RegexMap m_regex_map;
+    spin_rw_mutex m_regex_mutex;
+
+    // Parsed dictionaries and resolved dict_find/dict_value queries,
+    // shared by all contexts (see dictionary.cpp).
+    std::atomic<Dictionary *> m_dictionary {nullptr};
+    spin_mutex m_dictionary_mutex;
+
+    // Background ("async") JIT: a priority queue of groups waiting to be
+    // compiled, serviced by a lazily-started pool of worker threads.
+    struct AsyncJitRequest {
+        std::weak_ptr<ShaderGroup> group;
+        int priority;
+        long long serial;    // FIFO order among equal priorities
+        bool operator< (const AsyncJitRequest &r) const {
+            return priority < r.priority
+                   || (priority == r.priority && serial > r.serial);
+        }
+    };
+    void async_jit_worker ();
+    void start_async_jit_threads ();   // call with m_async_jit_mutex held
+    void enqueue_async_jit (ShaderGroup &group, int priority);  // ditto
+    void shutdown_async_jit_threads ();
+    std::vector<AsyncJitRequest> m_async_jit_queue;  // heap
+    std::vector<std::thread> m_async_jit_threads_pool;
+    std::mutex m_async_jit_mutex;      // guards all of the above + flags
+    std::condition_variable m_async_jit_cv;
+    long long m_async_jit_serial = 0;
+    bool m_async_jit_shutdown = false;
+    int m_async_jit_threads = 0;       ///< Number of async JIT threads
+
+    // Texture warmup: files already handed to a warmup task, and the
+    // tasks that may still be running (waited for at shutdown).
+    void warmup_texture_file (ustring filename, int level);
+    int m_texture_warmup = 0;          ///< Warm up textures_needed?
+    std::set<ustring> m_textures_warmed;
+    std::vector<std::shared_future<void>> m_texture_warmup_tasks;
+    mutex m_texture_warmup_mutex;      // guards the above two
+
+    // JIT deduplication table, keyed on the hash of each group's module.
+    // It doesn't own the code: an entry is only good as long as some
+    // group still holds the code it points to, and dead entries are swept
+    // out by jit_dedup_add whenever the table has doubled in size.
+    struct JitDedupEntry {
+        std::weak_ptr<void> code;
+        RunLLVMGroupFunc init;
+        std::vector<RunLLVMGroupFunc> layers;
+    };
+    std::unordered_map<std::string,JitDedupEntry> m_jit_dedup_table;
+    size_t m_jit_dedup_sweep_size = 64;  ///< Table size of the next sweep
+    mutex m_jit_dedup_mutex;           // guards the above two
     mutable std::map<ustring,long long> m_group_profile_times;
     // N.B. group_profile_times is protected by m_stat_mutex.
 
+    // Source lines timed by profile=2, in order of profile_site index,
+    // with their accumulated time and run counts.  Also guarded by
+    // m_stat_mutex.
+    struct ProfileSite {
+        ustring sourcefile;
+        int sourceline;
+        long long nanoseconds = 0;
+        long long runs = 0;
+    };
+    mutable std::vector<ProfileSite> m_profile_sites;
+    std::map<std::pair<ustring,int>,int> m_profile_site_index;
+    // What one osl_profile_line probe adds to the time of the line it
+    // ends (ns), measured by the first context to flush line times and
+    // subtracted from every run; -1 until then.
+    atomic_ll m_profile_line_overhead {-1};
+
     LLVM_Util::ScopedJitMemoryUser m_llvm_jit_memory_user;
 
     friend class OSL::ShadingContext;
@@ -1013,7 +1233,8 @@ public:
 
     /// Apply pending parameters
     ///
-    void parameters (const ParamValueList &params);
+    void parameters (const ParamValueList &params,
+                     const std::vector<ustring> &interactive);
 
     /// Find the named symbol, return its index in the symbol array, or
     /// -1 if not found.
@@ -1087,6 +1308,10 @@ public:
     bool userdata_params () const { return m_userdata_params; }
     void userdata_params (bool val) { m_userdata_params = val; }
 
+    /// Does this instance have parameters that were declared interactive
+    /// (editable with ReParameter after the group is optimized)?
+    bool interactive_params () const { return m_interactive_params; }
+
     /// Does this instance potentially read userdata to initialize any of
     /// its parameters?
     bool has_error_op () const { return m_has_error_op; }
@@ -1250,11 +1475,13 @@ public:
         unsigned char m_valuesource: 3;
         bool m_connected_down: 1;
         bool m_lockgeom:       1;
-        int  m_arraylen:      27;
+        bool m_interactive:    1;
+        int  m_arraylen:      26;
         int  m_data_offset;
 
         SymOverrideInfo () : m_valuesource(Symbol::DefaultVal),
-                             m_connected_down(false), m_lockgeom(true), m_arraylen(0), m_data_offset(0) { }
+                             m_connected_down(false), m_lockgeom(true),
+                             m_interactive(false), m_arraylen(0), m_data_offset(0) { }
         void valuesource (Symbol::ValueSource v) { m_valuesource = v; }
         Symbol::ValueSource valuesource () const { return (Symbol::ValueSource) m_valuesource; }
         const char *valuesourcename () const { return Symbol::valuesourcename(valuesource()); }
@@ -1263,6 +1490,8 @@ public:
         bool connected () const { return valuesource() == Symbol::ConnectedVal; }
         bool lockgeom () const { return m_lockgeom; }
         void lockgeom (bool l) { m_lockgeom = l; }
+        bool interactive () const { return m_interactive; }
+        void interactive (bool i) { m_interactive = i; }
         int  arraylen () const { return m_arraylen; }
         void arraylen (int s) { m_arraylen = s; }
         int  dataoffset () const { return m_data_offset; }
@@ -1270,6 +1499,7 @@ public:
         friend bool equivalent (const SymOverrideInfo &a, const SymOverrideInfo &b) {
             return a.valuesource() == b.valuesource() &&
                    a.lockgeom()    == b.lockgeom()    &&
+                   a.interactive() == b.interactive() &&
                    a.arraylen()    == b.arraylen();
         }
     };
@@ -1295,6 +1525,7 @@ private:
     int m_id;                           ///< Unique ID for the instance
     bool m_writes_globals;              ///< Do I have side effects?
     bool m_userdata_params;             ///< Might I read userdata for params?
+    bool m_interactive_params = false;  ///< Any interactive params?
     bool m_outgoing_connections;        ///< Any outgoing connections?
     bool m_renderer_outputs;            ///< Any outputs params render outputs?
     bool m_has_error_op;                ///< Any error ops in the code?
@@ -1431,7 +1662,7 @@ private:
 
 /// A ShaderGroup consists of one or more layers (each of which is a
 /// ShaderInstance), and the connections among them.
-class ShaderGroup {
+class ShaderGroup : public std::enable_shared_from_this<ShaderGroup> {
 public:
     ShaderGroup (string_view name);
     ShaderGroup (const ShaderGroup &g, string_view name);
@@ -1472,26 +1703,42 @@ public:
     size_t llvm_groupdata_wide_size () const { return m_llvm_groupdata_wide_size; }
     void llvm_groupdata_wide_size (size_t size) { m_llvm_groupdata_wide_size = size; }
 
+    /// Keep the machine code behind the llvm_compiled_* functions alive
+    /// for as long as this group exists.
+    void add_jit_code (const LLVM_Util::JitCodeHandle &code) {
+        if (code)
+            m_jit_code.push_back (code);
+    }
+
+    // The scalar entry points may be swapped by a tier-up while other
+    // threads are executing the group, so they are published with release
+    // stores and read with acquire loads: a thread that sees a new
+    // function also sees the code and data behind it.
     RunLLVMGroupFunc llvm_compiled_version() const {
-        return m_llvm_compiled_version;
+        return m_llvm_compiled_version.load (std::memory_order_acquire);
     }
     void llvm_compiled_version (RunLLVMGroupFunc func) {
-        m_llvm_compiled_version = func;
+        m_llvm_compiled_version.store (func, std::memory_order_release);
     }
     RunLLVMGroupFunc llvm_compiled_init() const {
-        return m_llvm_compiled_init;
+        return m_llvm_compiled_init.load (std::memory_order_acquire);
     }
     void llvm_compiled_init (RunLLVMGroupFunc func) {
-        m_llvm_compiled_init = func;
+        m_llvm_compiled_init.store (func, std::memory_order_release);
     }
     RunLLVMGroupFunc llvm_compiled_layer (int layer) const {
         return layer < (int)m_llvm_compiled_layers.size()
-                            ? m_llvm_compiled_layers[layer] : NULL;
+            ? m_llvm_compiled_layers[layer].load (std::memory_order_acquire)
+            : NULL;
     }
     void llvm_compiled_layer (int layer, RunLLVMGroupFunc func) {
-        m_llvm_compiled_layers.resize ((size_t)nlayers(), NULL);
-        if (layer < nlayers())
-            m_llvm_compiled_layers[layer] = func;
+        // Sized once, by the first JIT, before the group can execute;
+        // later stores (tier-up) never reallocate under readers.
+        if (m_llvm_compiled_layers.empty())
+            m_llvm_compiled_layers = std::vector<std::atomic<RunLLVMGroupFunc>> (
+                                         (size_t)nlayers());
+        if (layer < (int)m_llvm_compiled_layers.size())
+            m_llvm_compiled_layers[layer].store (func, std::memory_order_release);
     }
 
     // Hold onto wide versions of llvm functions side by side with scalar
@@ -1536,7 +1783,10 @@ public:
     void name (ustring name) { m_name = name; }
     ustring name () const { return m_name; }
 
-    std::string serialize () const;
+    /// Return the group spec that ShaderGroupBegin would need to recreate
+    /// this group.  If interactive is false, interactive params are
+    /// written as plain instance values.
+    std::string serialize (bool interactive=true) const;
 
     void lock () const { m_mutex.lock(); }
     void unlock () const { m_mutex.unlock(); }
@@ -1589,6 +1839,10 @@ public:
     int raytypes_on ()  const { return m_raytypes_on; }
     int raytypes_off () const { return m_raytypes_off; }
 
+    /// Return the block that the JITed code reads interactive params from
+    /// (NULL if the group has none, or is not yet optimized).
+    char *interactive_arena () const { return m_interactive_arena.get(); }
+
 private:
     // Put all the things that are read-only (after optimization) and
     // needed on every shade execution at the front of the struct, as much
@@ -1601,12 +1855,13 @@ private:
     size_t m_llvm_groupdata_wide_size = 0;    ///< Heap size needed for its wide groupdata
     int m_id;                        ///< Unique ID for the group
     int m_num_entry_layers = 0;      ///< Number of marked entry layers
-    RunLLVMGroupFunc m_llvm_compiled_version = nullptr;
-    RunLLVMGroupFunc m_llvm_compiled_init = nullptr;
-    std::vector<RunLLVMGroupFunc> m_llvm_compiled_layers;
+    std::atomic<RunLLVMGroupFunc> m_llvm_compiled_version { nullptr };
+    std::atomic<RunLLVMGroupFunc> m_llvm_compiled_init { nullptr };
+    std::vector<std::atomic<RunLLVMGroupFunc>> m_llvm_compiled_layers;
     RunLLVMGroupFuncWide m_llvm_compiled_wide_version = nullptr;
     RunLLVMGroupFuncWide m_llvm_compiled_wide_init = nullptr;
     std::vector<RunLLVMGroupFuncWide> m_llvm_compiled_wide_layers;
+    std::vector<LLVM_Util::JitCodeHandle> m_jit_code; ///< Owns JITed code
     std::vector<ShaderInstanceRef> m_layers;
     ustring m_name;
     int m_exec_repeat = 1;           ///< How many times to execute group
@@ -1632,16 +1887,40 @@ private:
     bool m_unknown_closures_needed;
     bool m_unknown_attributes_needed;
     atomic_ll m_executions {0};       ///< Number of times the group executed
-    atomic_ll m_stat_total_shading_time_ticks {0}; ///< Total shading time (ticks)
 
     // PTX assembly for compiled ShaderGroup
     std::string m_llvm_ptx_compiled_version;
 
     ParamValueList m_pending_params;      ///< Pending Parameter() values
+    std::vector<ustring> m_pending_interactive; ///< ...which are interactive
+    // Interactive params are read by the JITed code from this block, so
+    // that ReParameter can change them without recompiling.  It is laid
+    // out once the group is optimized and never reallocated after that.
+    std::unique_ptr<char[]> m_interactive_arena;
+    size_t m_interactive_arena_size = 0;
+    // The network as it was described, captured by ShaderGroupEnd before
+    // any optimization, for PromoteInteractiveParameters to rebuild from.
+    // Only kept for groups that have interactive params.
+    std::string m_original_spec;
     ustring m_group_use;                  ///< "Usage" of group
     bool m_complete = false;              ///< Successfully ShaderGroupEnd?
+    // Background JIT request state, guarded by the ShadingSystemImpl's
+    // m_async_jit_mutex.
+    bool m_async_jit_queued = false;      ///< Waiting in the async JIT queue?
+    int m_async_jit_priority = 0;         ///< ... and at what priority
+    // Tiered JIT: a group first JITed at the quick optimization level
+    // keeps what tier_up_group needs to JIT it again at full optimization
+    // (its unoptimized module and the names of the entry points to swap),
+    // and counts down executions until it asks for that.  Guarded by
+    // m_mutex, except for the countdown.
+    atomic_int m_tierup_countdown {0};    ///< Executions left before tier-up
+    std::string m_tierup_bitcode;         ///< Empty if no tier-up pending
+    LLVM_Util::GlobalMappings m_tierup_mappings;
+    std::string m_tierup_init_name;
+    std::vector<std::string> m_tierup_layer_names;
 
     friend class OSL::pvt::ShadingSystemImpl;
+    friend class OSL::pvt::RuntimeOptimizer;
     friend class OSL::pvt::BackendLLVM;
     friend class ShadingContext;
 };
@@ -1793,9 +2072,10 @@ public:
     const void *symbol_data (const Symbol &sym) const;
 
     /// Return a reference to a compiled regular expression for the
-    /// given string, being careful to cache already-created ones so we
-    /// aren't constantly compiling new ones.
-    const regex & find_regex (ustring r);
+    /// given string.  The shading system compiles each pattern once for
+    /// all contexts; we remember the ones we've already asked for so
+    /// repeat lookups don't need its lock.
+    const CompiledRegex & find_regex (ustring r);
 
     /// Return a pointer to the shading group for this context.
     ///
@@ -1853,20 +2133,105 @@ public:
 
     void incr_layers_executed () { ++m_stat_layers_executed; }
 
+    /// profile=2: charge the time since the last call to the profile site
+    /// it named, and start timing the given site (-1 just stops timing).
+    void profile_line (int site) {
+        long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (m_profile_site >= 0) {
+            if (m_profile_site >= (int)m_pending_line_times.size())
+                m_pending_line_times.resize (m_profile_site + 1);
+            m_pending_line_times[m_profile_site].first += now - m_profile_mark;
+            m_pending_line_times[m_profile_site].second += 1;
+        }
+        m_profile_site = site;
+        m_profile_mark = now;
+    }
+
     void incr_get_userdata_calls () { ++m_stat_get_userdata_calls; }
 
+    /// Look for the matrix (or inverse matrix) of the named space at the
+    /// given time among those already fetched from the renderer during
+    /// this execution.  Return true and set M if found.
+    bool find_cached_matrix (ustring space, float time, bool inverse,
+                             Matrix44 &M) {
+        for (int i = 0;  i < m_matrix_cache_used;  ++i) {
+            const MatrixCacheEntry &e (m_matrix_cache[i]);
+            if (e.space == space && e.time == time && e.inverse == inverse) {
+                M = e.M;
+                ++m_pending_matrix_cache_hits;
+                return true;
+            }
+        }
+        ++m_pending_matrix_cache_misses;
+        return false;
+    }
+
+    /// Remember a matrix successfully fetched from the renderer for the
+    /// rest of this execution.
+    void cache_matrix (ustring space, float time, bool inverse,
+                       const Matrix44 &M) {
+        int i = m_matrix_cache_used < matrix_cache_size
+              ? m_matrix_cache_used++ : (m_matrix_cache_next++ % matrix_cache_size);
+        m_matrix_cache[i] = { space, time, inverse, M };
+    }
+
+    /// Forget all cached matrices.  They are only valid for one execution
+    /// (or one batch), since the renderer's answer may depend on the
+    /// ShaderGlobals.
+    void clear_matrix_cache () { m_matrix_cache_used = 0; }
+
+    /// Return the ustring with the characters of s.  The string shadeops
+    /// (format, concat, substr, split) make their results through here:
+    /// a small table remembers the strings this context made recently,
+    /// so shaders that build the same strings point after point don't go
+    /// to the shared ustring table (and its locks) every time.
+    ustring make_ustring (string_view s);
+
+    /// Pure string ops whose results are remembered per context by
+    /// find_string_op/cache_string_op.
+    enum StringOp { StringOpConcat = 1, StringOpSubstr };
+
+    /// Look for the result of a string op with the given (already unique)
+    /// string arguments a, b and int arguments i, j among the recent ones.
+    /// Return true and set result if found.
+    bool find_string_op (StringOp op, const char *a, const char *b,
+                         int i, int j, const char *&result) {
+        const StringOpCacheEntry &e (m_string_op_cache[string_op_slot (op, a, b, i, j)]);
+        if (e.op == op && e.a == a && e.b == b && e.i == i && e.j == j) {
+            result = e.result;
+            ++m_pending_string_cache_hits;
+            return true;
+        }
+        return false;
+    }
+
+    /// Remember the result of a string op for find_string_op.
+    void cache_string_op (StringOp op, const char *a, const char *b,
+                          int i, int j, const char *result) {
+        m_string_op_cache[string_op_slot (op, a, b, i, j)]
+            = { op, a, b, i, j, result };
+    }
+
     // Clear the stats we record per-execution in this context (unlocked)
     void clear_runtime_stats () {
         m_stat_get_userdata_calls = 0;
         m_stat_layers_executed = 0;
     }
 
-    // Transfer the per-execution stats from this context to the shading
-    // system.
-    void record_runtime_stats () {
-        shadingsys().m_stat_get_userdata_calls += m_stat_get_userdata_calls;
-        shadingsys().m_stat_layers_executed += m_stat_layers_executed;
-    }
+    // Add the per-execution stats and shading time of this context into
+    // its private running totals (unlocked; nothing shared is touched).
+    void record_runtime_stats ();
+
+    // Transfer the running totals accumulated by record_runtime_stats to
+    // the shading system and reset them.  Called when the context is
+    // released or destroyed, so that profiling doesn't cost contended
+    // atomic updates on every execution.
+    void flush_runtime_stats ();
+
+    // Time back-to-back profile_line probes with nothing between them,
+    // i.e. what each probe adds to the line it ends (ns).
+    long long measure_profile_line_overhead ();
 
     bool allow_warnings() {
         if (m_max_warnings > 0) {
@@ -1923,14 +2288,114 @@ private:
     // Heap memory
     std::unique_ptr<char, decltype(&OIIO::aligned_free)> m_heap { nullptr, &OIIO::aligned_free };
     size_t m_heapsize = 0;
-    typedef std::unordered_map<ustring, std::unique_ptr<regex>, ustringHash> RegexMap;
-    RegexMap m_regex_map;               ///< Compiled regex's
+    typedef std::unordered_map<ustring, const CompiledRegex *, ustringHash> RegexMap;
+    RegexMap m_regex_map;               ///< Compiled regex's we've used
     MessageList m_messages;             ///< Message blackboard
     int m_max_warnings;                 ///< To avoid processing too many warnings
     int m_stat_get_userdata_calls;      ///< Number of calls to get_userdata
     int m_stat_layers_executed;         ///< Number of layers executed
     long long m_ticks;                  ///< Time executing the shader
 
+    // Transforms fetched from the renderer during this execution
+    struct MatrixCacheEntry {
+        ustring space;
+        float time;
+        bool inverse;
+        Matrix44 M;
+    };
+    static constexpr int matrix_cache_size = 8;
+    MatrixCacheEntry m_matrix_cache[matrix_cache_size];
+    int m_matrix_cache_used = 0;        ///< Valid entries in m_matrix_cache
+    int m_matrix_cache_next = 0;        ///< Round-robin slot to replace
+
+    // Strings recently made by the string shadeops (see make_ustring),
+    // direct-mapped by the hash of their characters
+    struct StringCacheEntry {
+        size_t hash;
+        ustring str;
+    };
+    static constexpr int string_cache_size = 256;
+    StringCacheEntry m_string_cache[string_cache_size] {};
+
+    // Recent concat/substr calls, direct-mapped by their arguments
+    struct StringOpCacheEntry {
+        int op;                         ///< StringOp, 0 for an empty slot
+        const char *a, *b;
+        int i, j;
+        const char *result;
+    };
+    static constexpr int string_op_cache_size = 256;
+    StringOpCacheEntry m_string_op_cache[string_op_cache_size] {};
+    static int string_op_slot (StringOp op, const char *a, const char *b,
+                               int i, int j) {
+        size_t h = size_t(a) ^ (size_t(b) * 31) ^ (size_t(i) * 0x9e3779b1)
+                 ^ (size_t(j) << 16) ^ size_t(op);
+        h ^= h >> 17;
+        return int ((h >> 4) & (string_op_cache_size - 1));
+    }
+
+    // How invariant the renderer said each attribute looked up so far is
+    // and, if it is, its last result (only used if the renderer supports
+    // "attribute_invariance").  Keyed on the group's id rather than its
+    // address, so a group allocated where a deleted one used to be can't
+    // see its values.  Per-object values are only valid for the objdata
+    // they were looked up with.
+    struct AttributeCacheKey {
+        int group_id;
+        ustring obj_name, attr_name;
+        TypeDesc type;
+        int index;                      ///< -1 unless an array lookup
+        bool derivs;
+        bool operator== (const AttributeCacheKey &k) const {
+            return group_id == k.group_id && obj_name == k.obj_name &&
+                   attr_name == k.attr_name && type == k.type &&
+                   index == k.index && derivs == k.derivs;
+        }
+    };
+    struct AttributeCacheKeyHash {
+        size_t operator() (const AttributeCacheKey &k) const {
+            size_t h = k.attr_name.hash() ^ (k.obj_name.hash() * 31)
+                     ^ (size_t(k.group_id) * 0x9e3779b1)
+                     ^ (size_t(k.index) << 16) ^ (size_t(k.derivs) << 15)
+                     ^ (size_t(k.type.basetype) << 8)
+                     ^ (size_t(k.type.aggregate) << 4)
+                     ^ size_t(k.type.arraylen);
+            return h ^ (h >> 17);
+        }
+    };
+    struct AttributeCacheEntry {
+        RendererServices::AttributeInvariance invariance;
+        bool valid = false;             ///< ok and the value are current
+        bool ok = false;
+        void *objdata = nullptr;        ///< Looked up with this objdata
+        size_t offset = 0;              ///< Value in m_attr_cache_data
+    };
+    // Once this many attributes are remembered, start over
+    static constexpr size_t max_cached_attributes = 256;
+    std::unordered_map<AttributeCacheKey, AttributeCacheEntry,
+                       AttributeCacheKeyHash> m_attr_cache;
+    std::vector<char> m_attr_cache_data;
+    int m_attr_cache_generation = 0;
+    // Running totals not yet transferred to the shading system
+    long long m_pending_get_userdata_calls = 0;
+    long long m_pending_layers_executed = 0;
+    long long m_pending_ticks = 0;
+    long long m_pending_matrix_cache_hits = 0;
+    long long m_pending_getattribute_calls = 0;
+    long long m_pending_getattribute_cache_hits = 0;
+    double m_pending_getattribute_time = 0;
+    double m_pending_getattribute_fail_time = 0;
+    long long m_pending_matrix_cache_misses = 0;
+    long long m_pending_string_cache_hits = 0;
+    long long m_pending_string_cache_misses = 0;
+    std::unordered_map<ustring,long long,ustringHash> m_pending_group_ticks;
+    ustring m_pending_group_name;       ///< Group of m_pending_group_slot
+    long long *m_pending_group_slot = nullptr;
+    // profile=2 per-site (nanoseconds, runs), indexed by profile site
+    std::vector<std::pair<long long,long long>> m_pending_line_times;
+    int m_profile_site = -1;            ///< Site being timed, or -1
+    long long m_profile_mark = 0;       ///< When it started (ns)
+
     TextureOpt m_textureopt;            ///< texture call options
     RendererServices::NoiseOpt m_noiseopt; ///< noise call options
     RendererServices::TraceOpt m_traceopt; ///< trace call options
@@ -1938,7 +2403,7 @@ private:
     SimplePool<20 * 1024> m_closure_pool;
     SimplePool<64 * 1024> m_scratch_pool;
 
-    Dictionary *m_dictionary;
+    DictionaryMemo *m_dictionary_memo = nullptr;  ///< Front end to shadingsys dictionary
 
     // Buffering of error messages and printfs
     struct ErrorItem
@@ -0,0 +1,456 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/imageworks/OpenShadingLanguage
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/strutil.h>
+
+#include "osoreader.h"
+
+
+OSL_NAMESPACE_ENTER
+
+namespace pvt {   // OSL::pvt
+
+
+// Binary OSO layout (native byte order):
+//
+//     OSOBinaryHeader
+//     uint32_t string_offsets[nstrings]    (into the string data)
+//     OSOBinaryRecord records[nrecords]
+//     char string_data[strings_size]       (each string NUL-terminated)
+//
+// The magic can't be mistaken for the start of a text oso file, and the
+// hash covers everything that follows the header.
+
+namespace {
+
+static const char osob_magic[8] = { '\211', 'O', 'S', 'O', '\r', '\n', '\032', '\n' };
+static const uint32_t osob_version = 1;
+
+struct OSOBinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nstrings;
+    uint32_t nrecords;
+    uint32_t strings_size;
+    uint64_t hash;
+};
+
+static_assert (sizeof(OSOBinaryHeader) == 32, "unexpected OSOBinaryHeader size");
+static_assert (sizeof(OSOBinaryRecord) == 20, "unexpected OSOBinaryRecord size");
+
+enum RecordKind {
+    RecVersion = 1,      // a = specid, b = major, c = minor
+    RecShader,           // a = shader type, b = name
+    RecSymbol,           // a = name, b = array length, c = struct name or -1
+    RecDefaultInt,       // a = value
+    RecDefaultFloat,     // a = bits of the value
+    RecDefaultString,    // a = value
+    RecParameterDone,
+    RecHint,             // a = hint
+    RecCodemarker,       // a = name
+    RecCodeend,
+    RecInstruction,      // a = label, b = opcode
+    RecInstructionArg,   // a = name
+    RecInstructionJump,  // a = target
+    RecInstructionEnd
+};
+
+}  // anonymous namespace
+
+
+
+bool
+OSOReader::is_binary (const char *data, size_t size)
+{
+    return size >= sizeof(OSOBinaryHeader)
+        && ! memcmp (data, osob_magic, sizeof(osob_magic));
+}
+
+
+
+bool
+OSOReader::parse_binary (const char *data, size_t size, string_view what)
+{
+    // Validate everything up front, so the replay below needs no checks
+    // beyond the string indices of each record.
+    const OSOBinaryHeader *h = (const OSOBinaryHeader *)data;
+    if (! is_binary (data, size) || h->version != osob_version) {
+        m_err.error ("%s is not binary oso this version of OSL can read",
+                     what);
+        return false;
+    }
+    size_t payload = size - sizeof(OSOBinaryHeader);
+    size_t offsets_size = size_t(h->nstrings) * sizeof(uint32_t);
+    size_t records_size = size_t(h->nrecords) * sizeof(OSOBinaryRecord);
+    if (offsets_size + records_size + h->strings_size != payload
+        || OIIO::Strutil::strhash (string_view (data + sizeof(OSOBinaryHeader),
+                                                payload)) != h->hash) {
+        m_err.error ("Corrupt binary oso %s", what);
+        return false;
+    }
+    const uint32_t *offsets = (const uint32_t *)(data + sizeof(OSOBinaryHeader));
+    const OSOBinaryRecord *records = (const OSOBinaryRecord *)(data + sizeof(OSOBinaryHeader) + offsets_size);
+    const char *stringdata = (const char *)records + records_size;
+    if (h->strings_size && stringdata[h->strings_size - 1] != 0) {
+        m_err.error ("Corrupt binary oso %s", what);
+        return false;
+    }
+
+    // Each distinct string becomes a ustring once.  The text parser hands
+    // out ustring characters, so callbacks may rely on that.
+    std::vector<const char *> strings (h->nstrings);
+    for (uint32_t i = 0;  i < h->nstrings;  ++i) {
+        if (offsets[i] >= h->strings_size) {
+            m_err.error ("Corrupt binary oso %s", what);
+            return false;
+        }
+        strings[i] = ustring (stringdata + offsets[i]).c_str();
+    }
+    auto str = [&](int32_t index) -> const char * {
+        return (index >= 0 && uint32_t(index) < h->nstrings) ? strings[index] : nullptr;
+    };
+
+    for (uint32_t r = 0;  r < h->nrecords;  ++r) {
+        const OSOBinaryRecord &rec (records[r]);
+        bool ok = true;
+        switch (rec.kind) {
+        case RecVersion:
+            if ((ok = str(rec.a)))
+                version (str(rec.a), rec.b, rec.c);
+            break;
+        case RecShader:
+            if ((ok = str(rec.a) && str(rec.b)))
+                shader (str(rec.a), str(rec.b));
+            break;
+        case RecSymbol: {
+            if (! (ok = str(rec.a) && (rec.c < 0 || str(rec.c))))
+                break;
+            if ((SymType)rec.symtype == SymTypeTemp && stop_parsing_at_temp_symbols())
+                return true;
+            TypeSpec typespec;
+            if (rec.c >= 0)
+                typespec = TypeSpec (str(rec.c), 0);
+            else
+                typespec = TypeSpec (TypeDesc (TypeDesc::BASETYPE(rec.basetype),
+                                               TypeDesc::AGGREGATE(rec.aggregate),
+                                               TypeDesc::VECSEMANTICS(rec.vecsemantics)),
+                                     rec.closure != 0);
+            current_typespec (typespec);
+            typespec.make_array (rec.b);
+            symbol ((SymType)rec.symtype, typespec, str(rec.a));
+            break;
+        }
+        case RecDefaultInt:
+            symdefault (int(rec.a));
+            break;
+        case RecDefaultFloat: {
+            float f;
+            memcpy (&f, &rec.a, sizeof(float));
+            symdefault (f);
+            break;
+        }
+        case RecDefaultString:
+            if ((ok = str(rec.a)))
+                symdefault (str(rec.a));
+            break;
+        case RecParameterDone:
+            parameter_done ();
+            break;
+        case RecHint:
+            if ((ok = str(rec.a)))
+                hint (str(rec.a));
+            break;
+        case RecCodemarker:
+            if (! (ok = str(rec.a)))
+                break;
+            if (! parse_code_section())
+                return true;
+            codemarker (str(rec.a));
+            break;
+        case RecCodeend:
+            codeend ();
+            break;
+        case RecInstruction:
+            if ((ok = str(rec.b)))
+                instruction (rec.a, str(rec.b));
+            break;
+        case RecInstructionArg:
+            if ((ok = str(rec.a)))
+                instruction_arg (str(rec.a));
+            break;
+        case RecInstructionJump:
+            instruction_jump (rec.a);
+            break;
+        case RecInstructionEnd:
+            instruction_end ();
+            break;
+        default:
+            ok = false;
+        }
+        if (! ok) {
+            m_err.error ("Corrupt binary oso %s (record %d)", what, (int)r);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+bool
+OSOReader::parse_binary_file (const std::string &filename, bool &is_binary_file)
+{
+    is_binary_file = false;
+    char magic[sizeof(OSOBinaryHeader)];
+    {
+        FILE *f = OIIO::Filesystem::fopen (filename, "rb");
+        if (! f)
+            return false;
+        size_t n = fread (magic, 1, sizeof(magic), f);
+        fclose (f);
+        if (! is_binary (magic, n))
+            return false;
+    }
+    is_binary_file = true;
+
+#ifndef _WIN32
+    int fd = ::open (filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_err.error ("File %s not found", filename.c_str());
+        return false;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat (fd, &st) == 0 && st.st_size > 0)
+        map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (map == MAP_FAILED) {
+        m_err.error ("Could not map %s", filename.c_str());
+        return false;
+    }
+    bool ok = parse_binary ((const char *)map, st.st_size, filename);
+    munmap (map, st.st_size);
+    return ok;
+#else
+    // No shared mapping here, just read the file into memory
+    std::ifstream in;
+    OIIO::Filesystem::open (in, filename, std::ios::in | std::ios::binary);
+    std::string buffer ((std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>());
+    if (! in.good() && ! in.eof()) {
+        m_err.error ("Could not read %s", filename.c_str());
+        return false;
+    }
+    return parse_binary (buffer.data(), buffer.size(), filename);
+#endif
+}
+
+
+
+bool
+OSOBinaryWriter::convert (const std::string &text, std::string &binary,
+                          ErrorHandler *errhandler)
+{
+    OSOBinaryWriter writer (errhandler);
+    if (! writer.parse_memory (text))
+        return false;
+    binary = writer.binary ();
+    return true;
+}
+
+
+
+std::string
+OSOBinaryWriter::binary () const
+{
+    std::vector<uint32_t> offsets;
+    std::string stringdata;
+    for (auto&& s : m_strings) {
+        offsets.push_back ((uint32_t)stringdata.size());
+        stringdata.append (s.c_str(), s.size() + 1);
+    }
+
+    OSOBinaryHeader h;
+    memcpy (h.magic, osob_magic, sizeof(osob_magic));
+    h.version = osob_version;
+    h.nstrings = (uint32_t)offsets.size();
+    h.nrecords = (uint32_t)m_records.size();
+    h.strings_size = (uint32_t)stringdata.size();
+
+    std::string out (sizeof(h), '\0');
+    out.append ((const char *)offsets.data(), offsets.size() * sizeof(uint32_t));
+    out.append ((const char *)m_records.data(), m_records.size() * sizeof(OSOBinaryRecord));
+    out.append (stringdata);
+    h.hash = OIIO::Strutil::strhash (string_view (out.data() + sizeof(h),
+                                                  out.size() - sizeof(h)));
+    memcpy (&out[0], &h, sizeof(h));
+    return out;
+}
+
+
+
+int
+OSOBinaryWriter::string_index (string_view s)
+{
+    auto inserted = m_string_index.emplace (s, (int)m_strings.size());
+    if (inserted.second)
+        m_strings.emplace_back (s);
+    return inserted.first->second;
+}
+
+
+
+OSOBinaryRecord &
+OSOBinaryWriter::add (int kind, int a, int b, int c)
+{
+    OSOBinaryRecord rec;
+    memset (&rec, 0, sizeof(rec));
+    rec.kind = (uint8_t)kind;
+    rec.a = a;
+    rec.b = b;
+    rec.c = c;
+    m_records.push_back (rec);
+    return m_records.back();
+}
+
+
+
+void
+OSOBinaryWriter::version (const char *specid, int major, int minor)
+{
+    add (RecVersion, string_index (specid), major, minor);
+}
+
+
+
+void
+OSOBinaryWriter::shader (const char *shadertype, const char *name)
+{
+    add (RecShader, string_index (shadertype), string_index (name));
+}
+
+
+
+void
+OSOBinaryWriter::symbol (SymType symtype, TypeSpec typespec, const char *name)
+{
+    int structname = -1;
+    if (typespec.is_structure_based())
+        structname = string_index (typespec.structspec()->name());
+    const TypeDesc &t (typespec.simpletype());
+    OSOBinaryRecord &rec (add (RecSymbol, string_index (name), t.arraylen,
+                               structname));
+    rec.symtype = (uint8_t)symtype;
+    rec.basetype = t.basetype;
+    rec.aggregate = t.aggregate;
+    rec.vecsemantics = t.vecsemantics;
+    rec.closure = typespec.is_closure_based();
+}
+
+
+
+void
+OSOBinaryWriter::symdefault (int def)
+{
+    add (RecDefaultInt, def);
+}
+
+
+
+void
+OSOBinaryWriter::symdefault (float def)
+{
+    int bits;
+    memcpy (&bits, &def, sizeof(float));
+    add (RecDefaultFloat, bits);
+}
+
+
+
+void
+OSOBinaryWriter::symdefault (const char *def)
+{
+    add (RecDefaultString, string_index (def));
+}
+
+
+
+void
+OSOBinaryWriter::parameter_done ()
+{
+    add (RecParameterDone);
+}
+
+
+
+void
+OSOBinaryWriter::hint (string_view hintstring)
+{
+    add (RecHint, string_index (hintstring));
+}
+
+
+
+void
+OSOBinaryWriter::codemarker (const char *name)
+{
+    add (RecCodemarker, string_index (name));
+}
+
+
+
+void
+OSOBinaryWriter::codeend ()
+{
+    add (RecCodeend);
+}
+
+
+
+void
+OSOBinaryWriter::instruction (int label, const char *opcode)
+{
+    add (RecInstruction, label, string_index (opcode));
+}
+
+
+
+void
+OSOBinaryWriter::instruction_arg (const char *name)
+{
+    add (RecInstructionArg, string_index (name));
+}
+
+
+
+void
+OSOBinaryWriter::instruction_jump (int target)
+{
+    add (RecInstructionJump, target);
+}
+
+
+
+void
+OSOBinaryWriter::instruction_end ()
+{
+    add (RecInstructionEnd);
+}
+
+
+}; // namespace pvt
+OSL_NAMESPACE_EXIT
@@ -7,6 +7,9 @@
 #include <OSL/platform.h>
 #include "osl_pvt.h"
 
+#include <unordered_map>
+#include <vector>
+
 #include <OpenImageIO/thread.h>
 #include <OpenImageIO/string_view.h>
 
@@ -42,6 +45,20 @@ public:
     /// an unrecoverable error reading.
     virtual bool parse_memory (const std::string &buffer);
 
+    /// Does the buffer hold binary OSO (see OSOBinaryWriter) rather than
+    /// text?  Both parse_file and parse_memory accept either form.
+    static bool is_binary (const char *data, size_t size);
+
+    /// Make the callbacks for binary OSO held in memory, exactly as the
+    /// text parser would for the OSO it was converted from.  'what' names
+    /// the source for error messages.
+    bool parse_binary (const char *data, size_t size, string_view what);
+
+    /// If the file holds binary OSO, set is_binary, memory-map the file
+    /// and parse it with parse_binary, returning whether that succeeded.
+    /// Otherwise set is_binary to false and return false.
+    bool parse_binary_file (const std::string &filename, bool &is_binary);
+
     /// Declare the shader version.
     ///
     virtual void version (const char *specid, int major, int minor) { }
@@ -134,5 +151,65 @@ private:
 OSL_PRAGMA_WARNING_POP
 
 
+
+/// One callback in binary OSO.  The symbol type fields are used only by
+/// symbol records; a, b and c hold ints, float bits, or string indices,
+/// depending on the kind of record.
+struct OSOBinaryRecord {
+    uint8_t kind;
+    uint8_t symtype;
+    uint8_t basetype;
+    uint8_t aggregate;
+    uint8_t vecsemantics;
+    uint8_t closure;
+    uint16_t unused;
+    int32_t a, b, c;
+};
+
+
+
+/// OSOReader that records every callback made while parsing text OSO and
+/// can then write it back out as binary OSO: a header with a format
+/// version and a hash of the contents, a table of unique strings, and a
+/// flat array of OSOBinaryRecords that parse_binary replays without any
+/// lexing, number parsing, or per-token ustring creation.
+class OSOBinaryWriter final : public OSOReader {
+public:
+    OSOBinaryWriter (ErrorHandler *errhandler = NULL) : OSOReader (errhandler) { }
+
+    /// Convert text OSO to binary OSO.  Return false if the text could not
+    /// be parsed.
+    static bool convert (const std::string &text, std::string &binary,
+                         ErrorHandler *errhandler = NULL);
+
+    /// Return the binary form of everything recorded so far.
+    std::string binary () const;
+
+    void version (const char *specid, int major, int minor) override;
+    void shader (const char *shadertype, const char *name) override;
+    void symbol (SymType symtype, TypeSpec typespec, const char *name) override;
+    void symdefault (int def) override;
+    void symdefault (float def) override;
+    void symdefault (const char *def) override;
+    void parameter_done () override;
+    void hint (string_view hintstring) override;
+    void codemarker (const char *name) override;
+    void codeend () override;
+    void instruction (int label, const char *opcode) override;
+    void instruction_arg (const char *name) override;
+    void instruction_jump (int target) override;
+    void instruction_end () override;
+
+private:
+    int string_index (string_view s);
+    OSOBinaryRecord &add (int kind, int a = 0, int b = 0, int c = 0);
+
+    std::vector<std::string> m_strings;
+    std::unordered_map<std::string,int> m_string_index;
+    std::vector<OSOBinaryRecord> m_records;
+};
+
+
+
 }; // namespace pvt
 OSL_NAMESPACE_EXIT
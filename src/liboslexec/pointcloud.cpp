@@ -3,6 +3,18 @@
 // https://github.com/imageworks/OpenShadingLanguage
 
 #include <cstdarg>
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <OpenImageIO/filesystem.h>
 
 #include "oslexec_pvt.h"
 using namespace OSL;
@@ -10,13 +22,579 @@ using namespace OSL::pvt;
 
 #ifdef USE_PARTIO
 #include <Partio.h>
-#include <unordered_map>
 #endif
 
 
 
 namespace { // anon
 
+// Helper: number of base values
+inline int
+basevals (TypeDesc t)
+{
+    return t.numelements() * int(t.aggregate);
+}
+
+
+
+bool
+compatiblePartioType (TypeDesc partio_type, TypeDesc osl_element_type)
+{
+    // Matching types (treating all VEC3 aggregates as equivalent)...
+    if (equivalent (partio_type, osl_element_type))
+        return true;
+
+    // Consider arrays and aggregates as interchangeable, as long as the
+    // totals are the same.
+    if (partio_type.basetype == osl_element_type.basetype &&
+        basevals(partio_type) == basevals(osl_element_type))
+        return true;
+
+    // The Partio file may contain an array size that OSL can't exactly
+    // represent, for example the partio type may be float[4], and the
+    // OSL array will be float[] but the element type will be just float
+    // because OSL doesn't permit multi-dimensional arrays.
+    // Just allow it anyway and fill in the OSL array.
+    if (TypeDesc::BASETYPE(partio_type.basetype) == osl_element_type)
+        return true;
+
+    return false;
+}
+
+
+
+// Fill in the derivatives of the distances to the found points, given
+// their positions and the (already square rooted) distances.
+void
+distance_derivs (const OSL::Vec3 &center, int count,
+                 const OSL::Vec3 *positions, float *out_distances,
+                 int derivs_offset)
+{
+    const OSL::Vec3 &dCdx = (&center)[1];
+    const OSL::Vec3 &dCdy = (&center)[2];
+    float *d_distance_dx = out_distances + derivs_offset;
+    float *d_distance_dy = out_distances + derivs_offset * 2;
+    for (int i = 0; i < count; ++i) {
+        if (out_distances[i] > 0) {
+            d_distance_dx[i] = 1.0f / out_distances[i] *
+                                    ((center.x - positions[i].x) * dCdx.x +
+                                     (center.y - positions[i].y) * dCdx.y +
+                                     (center.z - positions[i].z) * dCdx.z);
+            d_distance_dy[i] = 1.0f / out_distances[i] *
+                                    ((center.x - positions[i].x) * dCdy.x +
+                                     (center.y - positions[i].y) * dCdy.y +
+                                     (center.z - positions[i].z) * dCdy.z);
+        } else {
+            // distance is 0, derivs would be infinite which could cause trouble downstream
+            d_distance_dx[i] = 0;
+            d_distance_dy[i] = 0;
+        }
+    }
+}
+
+
+
+// Native OSL point clouds (".oslpc" files).
+//
+// The points are stored in the order of an implicit, balanced k-d tree:
+// the node for the range [lo,hi) is the point at (lo+hi)/2, with the
+// points of its left subtree before it and those of its right subtree
+// after it, and the split axis of every node is kept in its own array.
+// Attributes are stored one array per attribute, in the same order, so
+// the tree needs no node records or indirection at all. The file is
+// memory mapped read-only, which lets all the processes on a machine
+// share its pages, and queries never take a lock.
+//
+// All offsets are in bytes from the start of the file, 8 byte aligned.
+struct OslpcHeader {
+    char magic[8];              // "OSLPC" followed by NULs
+    uint32_t version;
+    uint32_t nattribs;
+    uint64_t npoints;
+    uint64_t attribs_offset;    // OslpcAttrib[nattribs]
+    uint64_t axes_offset;       // uint8_t[npoints] split axis of each node
+    uint64_t strings_offset;    // NUL terminated names and string values
+    uint64_t strings_size;
+};
+
+struct OslpcAttrib {
+    uint32_t name;              // offset of the name in the string table
+    uint8_t basetype;
+    uint8_t aggregate;
+    uint8_t vecsemantics;
+    uint8_t pad;
+    int32_t arraylen;
+    uint32_t pad2;
+    uint64_t data_offset;       // npoints values, strings as uint32 offsets
+};
+
+static const char oslpc_magic[8] = { 'O', 'S', 'L', 'P', 'C', 0, 0, 0 };
+static const uint32_t oslpc_version = 1;
+static ustring u_position ("position");
+
+
+
+inline bool
+is_native_pointcloud (ustring filename)
+{
+    return OIIO::Strutil::iends_with (filename, ".oslpc");
+}
+
+
+
+// Bytes used by one value of type t in a native point cloud
+inline size_t
+oslpc_value_size (TypeDesc t)
+{
+    return t.basetype == TypeDesc::STRING ? sizeof(uint32_t) : t.size();
+}
+
+
+
+class NativePointCloud {
+public:
+    NativePointCloud (ustring filename, bool write)
+        : m_filename(filename), m_write(write) { }
+    ~NativePointCloud ();
+
+    // Find or open the cloud.  Returns NULL if it can't be read, or if
+    // it is wanted for writing but was already opened for reading.
+    static NativePointCloud *get (ustring filename, bool write = false);
+
+    // Is this a cloud that was successfully mapped for reading?
+    bool readable () const { return m_header != nullptr; }
+
+    size_t size () const { return m_header ? m_header->npoints : 0; }
+
+    // A candidate point found by search: (squared distance, index)
+    typedef std::pair<float,size_t> Found;
+
+    // Find the max_points nearest points to center that are closer than
+    // radius, returning their indices and squared distances (ascending if
+    // sort is true) and how many were found.  The caller supplies room
+    // for max_points candidates in heap.
+    int search (const Vec3 &center, float radius, int max_points, bool sort,
+                size_t *indices, float *dist2, Found *heap) const;
+
+    // Look up an attribute by name, returning its type in *type.
+    const OslpcAttrib *attribute (ustring name, TypeDesc *type) const;
+
+    const char *attribute_data (const OslpcAttrib *a) const {
+        return m_data + a->data_offset;
+    }
+    const Vec3 *positions () const { return m_positions; }
+    const char *string (uint32_t offset) const {
+        return offset < m_header->strings_size ? m_data + m_header->strings_offset + offset : "";
+    }
+
+    // Load and validate the file, returning false on failure
+    bool open ();
+
+    // Add one point to a cloud being written
+    bool add_point (const Vec3 &pos, int nattribs, const ustring *names,
+                    const TypeDesc *types, const void **data);
+
+    // Build the tree and save the points added to a cloud being written
+    bool save () const;
+
+    ustring m_filename;
+    bool m_write;
+    spin_mutex m_mutex;   // serializes add_point
+
+private:
+    // Memory mapping (or, where we can't map, a copy) of the file
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    std::unique_ptr<char[]> m_copy;
+    const OslpcHeader *m_header = nullptr;
+    const uint8_t *m_axes = nullptr;
+    const Vec3 *m_positions = nullptr;
+    typedef std::unordered_map<ustring, const OslpcAttrib *, ustringHash> AttributeMap;
+    AttributeMap m_attributes;
+
+    // Points being written
+    struct Column {
+        ustring name;
+        TypeDesc type;
+        std::vector<char> data;   // strings are stored as ustring
+    };
+    std::vector<Vec3> m_new_points;
+    std::vector<Column> m_columns;
+};
+
+
+typedef std::unordered_map<ustring, std::shared_ptr<NativePointCloud>, ustringHash> NativePointCloudMap;
+static NativePointCloudMap native_pointclouds;
+static spin_rw_mutex native_pointcloudmap_mutex;
+
+
+
+NativePointCloud *
+NativePointCloud::get (ustring filename, bool write)
+{
+    if (filename.empty())
+        return NULL;
+    {
+        // Almost every call finds a cloud that is already there
+        spin_rw_read_lock lock (native_pointcloudmap_mutex);
+        NativePointCloudMap::const_iterator found = native_pointclouds.find(filename);
+        if (found != native_pointclouds.end())
+            return (write && !found->second->m_write) ? NULL : found->second.get();
+    }
+    spin_rw_write_lock lock (native_pointcloudmap_mutex);
+    NativePointCloudMap::const_iterator found = native_pointclouds.find(filename);
+    if (found != native_pointclouds.end())
+        return (write && !found->second->m_write) ? NULL : found->second.get();
+    // Not found. Create a new one.
+    std::shared_ptr<NativePointCloud> pc (new NativePointCloud (filename, write));
+    if (!write && !pc->open())
+        return NULL;
+    native_pointclouds[filename] = pc;
+    return pc.get();
+}
+
+
+
+NativePointCloud::~NativePointCloud ()
+{
+    // Save the file if we wrote to it
+    if (m_write && !m_filename.empty())
+        save ();
+#ifndef _WIN32
+    if (m_data && !m_copy)
+        munmap ((void *)m_data, m_size);
+#endif
+}
+
+
+
+bool
+NativePointCloud::open ()
+{
+#ifndef _WIN32
+    int fd = ::open (m_filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat (fd, &st) == 0 && st.st_size > 0) {
+        void *map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            m_data = (const char *)map;
+            m_size = st.st_size;
+        }
+    }
+    ::close (fd);
+#else
+    // No shared mapping here, just read the file into memory
+    std::ifstream in;
+    OIIO::Filesystem::open (in, m_filename.string(), std::ios::in | std::ios::binary);
+    if (in) {
+        in.seekg (0, std::ios::end);
+        m_size = size_t(in.tellg());
+        in.seekg (0, std::ios::beg);
+        m_copy.reset (new char[m_size]);
+        if (in.read (m_copy.get(), m_size))
+            m_data = m_copy.get();
+    }
+#endif
+    if (!m_data || m_size < sizeof(OslpcHeader))
+        return false;
+
+    // Validate everything we will index so that queries need no checks
+    const OslpcHeader *h = (const OslpcHeader *)m_data;
+    if (memcmp (h->magic, oslpc_magic, sizeof(oslpc_magic)) || h->version != oslpc_version)
+        return false;
+    auto inside = [&](uint64_t offset, uint64_t bytes) {
+        return offset <= m_size && bytes <= m_size - offset;
+    };
+    if (h->npoints > m_size ||
+        !inside (h->attribs_offset, uint64_t(h->nattribs) * sizeof(OslpcAttrib)) ||
+        !inside (h->axes_offset, h->npoints) ||
+        !inside (h->strings_offset, h->strings_size) ||
+        (h->strings_size && m_data[h->strings_offset + h->strings_size - 1] != 0))
+        return false;
+    const OslpcAttrib *attribs = (const OslpcAttrib *)(m_data + h->attribs_offset);
+    for (uint32_t i = 0; i < h->nattribs; ++i) {
+        const OslpcAttrib &a (attribs[i]);
+        // Only types that TypeDesc (and the string table) can describe;
+        // anything else would make the sizes below meaningless.
+        bool is_numeric = a.basetype >= TypeDesc::UINT8 && a.basetype <= TypeDesc::DOUBLE;
+        bool is_string = a.basetype == TypeDesc::STRING &&
+                         a.aggregate == TypeDesc::SCALAR && a.arraylen == 0;
+        bool aggregate_ok = a.aggregate == TypeDesc::SCALAR || a.aggregate == TypeDesc::VEC2 ||
+                            a.aggregate == TypeDesc::VEC3 || a.aggregate == TypeDesc::VEC4 ||
+                            a.aggregate == TypeDesc::MATRIX33 || a.aggregate == TypeDesc::MATRIX44;
+        if (!(is_numeric || is_string) || !aggregate_ok || a.arraylen < 0)
+            return false;
+        TypeDesc type (TypeDesc::BASETYPE(a.basetype), TypeDesc::AGGREGATE(a.aggregate),
+                       TypeDesc::VECSEMANTICS(a.vecsemantics), a.arraylen);
+        uint64_t value_size = oslpc_value_size(type);
+        if (a.name >= h->strings_size || (a.data_offset & 3) ||
+            h->npoints > m_size / value_size ||
+            !inside (a.data_offset, h->npoints * value_size))
+            return false;
+        m_attributes[ustring(m_data + h->strings_offset + a.name)] = &a;
+    }
+    // search() indexes positions by the split axes
+    const uint8_t *axes = (const uint8_t *)(m_data + h->axes_offset);
+    for (uint64_t i = 0; i < h->npoints; ++i)
+        if (axes[i] > 2)
+            return false;
+    m_header = h;
+    m_axes = axes;
+    TypeDesc ptype;
+    const OslpcAttrib *pos = attribute (u_position, &ptype);
+    if (!pos || ptype.basetype != TypeDesc::FLOAT || basevals(ptype) != 3) {
+        m_header = nullptr;
+        return false;
+    }
+    m_positions = (const Vec3 *)attribute_data (pos);
+    return true;
+}
+
+
+
+const OslpcAttrib *
+NativePointCloud::attribute (ustring name, TypeDesc *type) const
+{
+    AttributeMap::const_iterator found = m_attributes.find (name);
+    if (found == m_attributes.end())
+        return nullptr;
+    const OslpcAttrib &a (*found->second);
+    *type = TypeDesc (TypeDesc::BASETYPE(a.basetype), TypeDesc::AGGREGATE(a.aggregate),
+                      TypeDesc::VECSEMANTICS(a.vecsemantics), a.arraylen);
+    return found->second;
+}
+
+
+
+int
+NativePointCloud::search (const Vec3 &center, float radius, int max_points,
+                          bool sort, size_t *indices, float *dist2,
+                          Found *heap) const
+{
+    if (max_points <= 0 || !m_header)
+        return 0;
+    // heap is a max-heap of the best points so far, ordered by (distance,
+    // index) so that ties resolve the same way every time.
+    int count = 0;
+    float maxdist2 = radius * radius;
+
+    // Subtrees still to visit, with their squared distance to the query
+    struct Range { size_t lo, hi; float dist2; };
+    Range stack[128];
+    int sp = 0;
+    stack[sp++] = Range { 0, size_t(m_header->npoints), 0.0f };
+    while (sp) {
+        Range r = stack[--sp];
+        if (r.dist2 >= maxdist2)
+            continue;   // the search sphere shrank since this was pushed
+        while (r.lo < r.hi) {
+            size_t mid = (r.lo + r.hi) / 2;
+            const Vec3 &p (m_positions[mid]);
+            float d2 = (p - center).length2();
+            if (d2 < maxdist2) {
+                if (count < max_points) {
+                    heap[count++] = Found (d2, mid);
+                    std::push_heap (heap, heap + count);
+                } else if (Found (d2, mid) < heap[0]) {
+                    std::pop_heap (heap, heap + count);
+                    heap[count-1] = Found (d2, mid);
+                    std::push_heap (heap, heap + count);
+                }
+                if (count == max_points)
+                    maxdist2 = heap[0].first;
+            }
+            // Descend into the side of the split the center is on, and
+            // come back for the other side if the sphere crosses it.
+            int axis = m_axes[mid];
+            float diff = center[axis] - p[axis];
+            Range left { r.lo, mid, r.dist2 }, right { mid + 1, r.hi, r.dist2 };
+            Range &nearside (diff < 0 ? left : right);
+            Range &farside (diff < 0 ? right : left);
+            farside.dist2 = std::max (r.dist2, diff * diff);
+            // Only siblings of the current path are ever on the stack, so
+            // it never gets deeper than the tree
+            if (farside.lo < farside.hi && farside.dist2 < maxdist2)
+                stack[sp++] = farside;
+            r = nearside;
+        }
+    }
+    if (sort)
+        std::sort_heap (heap, heap + count);
+    for (int i = 0; i < count; ++i) {
+        dist2[i] = heap[i].first;
+        indices[i] = heap[i].second;
+    }
+    return count;
+}
+
+
+
+bool
+NativePointCloud::add_point (const Vec3 &pos, int nattribs, const ustring *names,
+                             const TypeDesc *types, const void **data)
+{
+    size_t n = m_new_points.size();
+    m_new_points.push_back (pos);
+    bool ok = true;
+    for (int i = 0;  i < nattribs;  ++i) {
+        if (names[i] == u_position)
+            continue;   // positions are always written from P
+        TypeDesc t = types[i];
+        if (t.basetype == TypeDesc::STRING && t.arraylen) {
+            ok = false;   // only single strings are supported
+            continue;
+        }
+        Column *col = nullptr;
+        for (auto &c : m_columns)
+            if (c.name == names[i])
+                col = &c;
+        if (!col) {
+            m_columns.emplace_back ();
+            col = &m_columns.back();
+            col->name = names[i];
+            col->type = t;
+        } else if (!equivalent (col->type, t)) {
+            ok = false;
+            continue;
+        }
+        size_t size = col->type.size();
+        col->data.resize ((n + 1) * size);   // zero fills skipped points
+        memcpy (&col->data[n * size], data[i], size);
+    }
+    return ok;
+}
+
+
+
+// Reorder perm[lo,hi) into the implicit k-d tree layout described above
+static void
+build_kdtree (const std::vector<Vec3> &points, std::vector<size_t> &perm,
+              std::vector<uint8_t> &axes, size_t lo, size_t hi)
+{
+    while (lo < hi) {
+        Vec3 bmin = points[perm[lo]], bmax = bmin;
+        for (size_t i = lo + 1; i < hi; ++i) {
+            const Vec3 &p (points[perm[i]]);
+            bmin.x = std::min (bmin.x, p.x);  bmax.x = std::max (bmax.x, p.x);
+            bmin.y = std::min (bmin.y, p.y);  bmax.y = std::max (bmax.y, p.y);
+            bmin.z = std::min (bmin.z, p.z);  bmax.z = std::max (bmax.z, p.z);
+        }
+        Vec3 extent = bmax - bmin;
+        int axis = extent.x >= extent.y ? (extent.x >= extent.z ? 0 : 2)
+                                        : (extent.y >= extent.z ? 1 : 2);
+        size_t mid = (lo + hi) / 2;
+        std::nth_element (perm.begin() + lo, perm.begin() + mid, perm.begin() + hi,
+                          [&](size_t a, size_t b) {
+                              return points[a][axis] < points[b][axis];
+                          });
+        axes[mid] = uint8_t(axis);
+        build_kdtree (points, perm, axes, lo, mid);
+        lo = mid + 1;
+    }
+}
+
+
+
+bool
+NativePointCloud::save () const
+{
+    const size_t n = m_new_points.size();
+    std::vector<size_t> perm (n);
+    for (size_t i = 0; i < n; ++i)
+        perm[i] = i;
+    std::vector<uint8_t> axes (n, 0);
+    build_kdtree (m_new_points, perm, axes, 0, n);
+
+    // String table: the empty string at offset 0 (also what points that
+    // never set a string attribute read as), then names and values
+    std::string strings (1, '\0');
+    std::unordered_map<ustring, uint32_t, ustringHash> string_offsets;
+    string_offsets[ustring()] = 0;
+    auto add_string = [&](ustring s) {
+        auto found = string_offsets.find (s);
+        if (found != string_offsets.end())
+            return found->second;
+        uint32_t offset = uint32_t(strings.size());
+        strings.append (s.c_str(), s.length());
+        strings.push_back (0);
+        string_offsets[s] = offset;
+        return offset;
+    };
+
+    auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+    OslpcHeader header;
+    memset (&header, 0, sizeof(header));
+    memcpy (header.magic, oslpc_magic, sizeof(oslpc_magic));
+    header.version = oslpc_version;
+    header.nattribs = uint32_t(m_columns.size() + 1);
+    header.npoints = n;
+    header.attribs_offset = sizeof(OslpcHeader);
+    header.axes_offset = header.attribs_offset + header.nattribs * sizeof(OslpcAttrib);
+
+    // Attribute table, with "position" always first
+    std::vector<OslpcAttrib> attribs (header.nattribs);
+    uint64_t offset = align (header.axes_offset + n);
+    for (size_t c = 0; c < attribs.size(); ++c) {
+        OslpcAttrib &a (attribs[c]);
+        memset (&a, 0, sizeof(a));
+        TypeDesc t = c ? m_columns[c-1].type : TypeDesc(TypeDesc::FLOAT, TypeDesc::VEC3, TypeDesc::POINT);
+        a.name = add_string (c ? m_columns[c-1].name : u_position);
+        a.basetype = t.basetype;
+        a.aggregate = t.aggregate;
+        a.vecsemantics = t.vecsemantics;
+        a.arraylen = t.arraylen;
+        a.data_offset = offset;
+        offset = align (offset + n * oslpc_value_size(t));
+    }
+
+    // Attribute values, in tree order
+    std::vector<std::vector<char>> values (attribs.size());
+    for (size_t c = 0; c < attribs.size(); ++c) {
+        const Column *col = c ? &m_columns[c-1] : nullptr;
+        TypeDesc t = col ? col->type : TypeDesc(TypeDesc::FLOAT, TypeDesc::VEC3);
+        size_t insize = t.size(), outsize = oslpc_value_size(t);
+        values[c].resize (n * outsize, 0);
+        for (size_t i = 0; i < n; ++i) {
+            size_t src = perm[i];
+            char *dst = &values[c][i * outsize];
+            if (!col) {
+                memcpy (dst, &m_new_points[src], outsize);
+            } else if ((src + 1) * insize > col->data.size()) {
+                // point written without this attribute: leave zeroes
+            } else if (t.basetype == TypeDesc::STRING) {
+                uint32_t so = add_string (*(const ustring *)&col->data[src * insize]);
+                memcpy (dst, &so, sizeof(so));
+            } else {
+                memcpy (dst, &col->data[src * insize], outsize);
+            }
+        }
+    }
+    header.strings_offset = offset;
+    header.strings_size = strings.size();
+
+    FILE *file = OIIO::Filesystem::fopen (m_filename.string(), "wb");
+    if (!file)
+        return false;
+    auto write_at = [&](uint64_t pos, const void *data, size_t size) {
+        static const char zeros[8] = { 0 };
+        long here = ftell (file);
+        if (here >= 0 && uint64_t(here) < pos)
+            fwrite (zeros, 1, pos - here, file);   // alignment padding
+        return fwrite (data, 1, size, file) == size;
+    };
+    bool ok = write_at (0, &header, sizeof(header))
+           && write_at (header.attribs_offset, attribs.data(), attribs.size() * sizeof(OslpcAttrib))
+           && write_at (header.axes_offset, axes.data(), n);
+    for (size_t c = 0; ok && c < attribs.size(); ++c)
+        ok = write_at (attribs[c].data_offset, values[c].data(), values[c].size());
+    ok = ok && write_at (header.strings_offset, strings.data(), strings.size());
+    ok = (fclose (file) == 0) && ok;
+    return ok;
+}
+
+
 #ifdef USE_PARTIO
 
 class PointCloud {
@@ -50,8 +628,7 @@ public:
 typedef std::unordered_map<ustring, std::shared_ptr<PointCloud>, ustringHash> PointCloudMap;
 // See above note about shared_ptr vs unique_ptr.
 static PointCloudMap pointclouds;
-static spin_mutex pointcloudmap_mutex;
-static ustring u_position ("position");
+static spin_rw_mutex pointcloudmap_mutex;
 
 
 // some helper classes to make the sort easy
@@ -69,7 +646,14 @@ PointCloud::get (ustring filename, bool write)
 {
     if (filename.empty())
         return NULL;
-    spin_lock lock (pointcloudmap_mutex);
+    {
+        // Almost every call finds a cloud that is already there
+        spin_rw_read_lock lock (pointcloudmap_mutex);
+        PointCloudMap::const_iterator found = pointclouds.find(filename);
+        if (found != pointclouds.end())
+            return found->second.get();
+    }
+    spin_rw_write_lock lock (pointcloudmap_mutex);
     PointCloudMap::const_iterator found = pointclouds.find(filename);
     if (found != pointclouds.end())
         return found->second.get();
@@ -139,41 +723,6 @@ PartioType (TypeDesc t)
 
 
 
-// Helper: number of base values
-inline int
-basevals (TypeDesc t)
-{
-    return t.numelements() * int(t.aggregate);
-}
-
-
-
-bool
-compatiblePartioType (TypeDesc partio_type, TypeDesc osl_element_type)
-{
-    // Matching types (treating all VEC3 aggregates as equivalent)...
-    if (equivalent (partio_type, osl_element_type))
-        return true;
-
-    // Consider arrays and aggregates as interchangeable, as long as the
-    // totals are the same.
-    if (partio_type.basetype == osl_element_type.basetype &&
-        basevals(partio_type) == basevals(osl_element_type))
-        return true;
-
-    // The Partio file may contain an array size that OSL can't exactly
-    // represent, for example the partio type may be float[4], and the
-    // OSL array will be float[] but the element type will be just float
-    // because OSL doesn't permit multi-dimensional arrays.
-    // Just allow it anyway and fill in the OSL array.
-    if (TypeDesc::BASETYPE(partio_type.basetype) == osl_element_type)
-        return true;
-
-    return false;
-}
-
-
-
 TypeDesc
 TypeDescOfPartioType (const Partio::ParticleAttribute *ptype)
 {
@@ -216,9 +765,40 @@ RendererServices::pointcloud_search (ShaderGlobals *sg,
                                      size_t *out_indices,
                                      float *out_distances, int derivs_offset)
 {
-#ifdef USE_PARTIO
     if (filename.empty())
         return 0;
+    if (is_native_pointcloud(filename)) {
+        const NativePointCloud *pc = NativePointCloud::get(filename);
+        if (pc == NULL || ! pc->readable()) { // The file failed to load
+            sg->context->errorf("pointcloud_search: could not open \"%s\"", filename);
+            return 0;
+        }
+        if (pc->size() == 0 || max_points <= 0)
+            return 0;
+        float *dist2 = out_distances;
+        if (! dist2)  // If not supplied, allocate our own
+            dist2 = (float *)sg->context->alloc_scratch (max_points*sizeof(float), sizeof(float));
+        // max_points comes from the shader, so keep the candidates in
+        // the context's scratch memory rather than on the stack
+        NativePointCloud::Found *heap = (NativePointCloud::Found *)
+            sg->context->alloc_scratch (max_points * sizeof(NativePointCloud::Found),
+                                        alignof(NativePointCloud::Found));
+        int count = pc->search (center, radius, max_points, sort, out_indices,
+                                dist2, heap);
+        if (out_distances) {
+            // Convert the squared distances to straight distances
+            for (int i = 0; i < count; ++i)
+                out_distances[i] = sqrtf(dist2[i]);
+            if (derivs_offset) {
+                OSL::Vec3 *positions = (OSL::Vec3 *) sg->context->alloc_scratch (sizeof(OSL::Vec3) * count, sizeof(float));
+                for (int i = 0; i < count; ++i)
+                    positions[i] = pc->positions()[out_indices[i]];
+                distance_derivs (center, count, positions, out_distances, derivs_offset);
+            }
+        }
+        return count;
+    }
+#ifdef USE_PARTIO
     PointCloud *pc = PointCloud::get(filename);
     if (pc == NULL) { // The file failed to load
         sg->context->errorf("pointcloud_search: could not open \"%s\"", filename);
@@ -239,9 +819,12 @@ RendererServices::pointcloud_search (ShaderGlobals *sg,
     // found point's positions.
     Partio::ParticleAttribute *pos_attr = NULL;
     if (derivs_offset) {
-        pos_attr = pc->m_attributes[u_position].get();
-        if (! pos_attr)
+        // N.B. find, not operator[], which would insert while other
+        // threads are searching the same cloud
+        PointCloud::AttributeMap::const_iterator found = pc->m_attributes.find(u_position);
+        if (found == pc->m_attributes.end())
             return 0;   // No "position" attribute -- fail
+        pos_attr = found->second.get();
     }
 
     static_assert (sizeof(size_t) == sizeof(Partio::ParticleIndex),
@@ -283,26 +866,7 @@ RendererServices::pointcloud_search (ShaderGlobals *sg,
             OSL::Vec3 *positions = (OSL::Vec3 *) sg->context->alloc_scratch (sizeof(OSL::Vec3) * count, sizeof(float));
             // FIXME(Partio): this function really should be marked as const because it is just a wrapper of a private const method
             const_cast<Partio::ParticlesData*>(cloud)->data (*pos_attr, count, indices, true, (void *)positions);
-            const OSL::Vec3 &dCdx = (&center)[1];
-            const OSL::Vec3 &dCdy = (&center)[2];
-            float *d_distance_dx = out_distances + derivs_offset;
-            float *d_distance_dy = out_distances + derivs_offset * 2;
-            for (int i = 0; i < count; ++i) {
-                if (out_distances[i] > 0) {
-                    d_distance_dx[i] = 1.0f / out_distances[i] *
-                                            ((center.x - positions[i].x) * dCdx.x +
-                                             (center.y - positions[i].y) * dCdx.y +
-                                             (center.z - positions[i].z) * dCdx.z);
-                    d_distance_dy[i] = 1.0f / out_distances[i] *
-                                            ((center.x - positions[i].x) * dCdy.x +
-                                             (center.y - positions[i].y) * dCdy.y +
-                                             (center.z - positions[i].z) * dCdy.z);
-                } else {
-                    // distance is 0, derivs would be infinite which could cause trouble downstream
-                    d_distance_dx[i] = 0;
-                    d_distance_dy[i] = 0;
-                }
-            }
+            distance_derivs (center, count, positions, out_distances, derivs_offset);
         }
     }
     return count;
@@ -319,10 +883,55 @@ RendererServices::pointcloud_get (ShaderGlobals *sg,
                                   ustring attr_name, TypeDesc attr_type,
                                   void *out_data)
 {
-#ifdef USE_PARTIO
     if (! count)
         return 1;  // always succeed if not asking for any data
 
+    if (is_native_pointcloud(filename)) {
+        const NativePointCloud *pc = NativePointCloud::get(filename);
+        if (pc == NULL || ! pc->readable()) { // The file failed to load
+            sg->context->errorf("pointcloud_get: could not open \"%s\"", filename);
+            return 0;
+        }
+        TypeDesc cloud_type;
+        const OslpcAttrib *attr = pc->attribute (attr_name, &cloud_type);
+        if (! attr) {
+            sg->context->errorf("Accessing unexisting attribute %s in pointcloud \"%s\"", attr_name, filename);
+            return 0;
+        }
+        TypeDesc element_type = attr_type.elementtype ();
+        if (!compatiblePartioType(cloud_type, element_type)) {
+            sg->context->errorf("Type of attribute \"%s\" : %s not compatible with OSL's %s in \"%s\" pointcloud",
+                                attr_name, cloud_type, element_type, filename);
+            return 0;
+        }
+        int maxn = basevals(attr_type) / basevals(cloud_type);
+        if (maxn < count) {
+            sg->context->errorf("Point cloud attribute \"%s\" : %s with retrieval count %d will not fit in %s",
+                                attr_name, cloud_type, count, attr_type);
+            count = maxn;
+        }
+        const char *data = pc->attribute_data (attr);
+        size_t npoints = pc->size();
+        if (cloud_type.basetype == TypeDesc::STRING) {
+            for (int i = 0; i < count; ++i) {
+                uint32_t offset = 0;
+                if (indices[i] < npoints)
+                    memcpy (&offset, data + indices[i] * sizeof(uint32_t), sizeof(uint32_t));
+                ((ustring *)out_data)[i] = indices[i] < npoints ? ustring(pc->string(offset)) : ustring();
+            }
+        } else {
+            size_t size = cloud_type.size();
+            for (int i = 0; i < count; ++i) {
+                if (indices[i] < npoints)
+                    memcpy ((char *)out_data + i * size, data + indices[i] * size, size);
+                else
+                    memset ((char *)out_data + i * size, 0, size);
+            }
+        }
+        return 1;
+    }
+
+#ifdef USE_PARTIO
     PointCloud *pc = PointCloud::get(filename);
     if (pc == NULL) { // The file failed to load
         sg->context->errorf("pointcloud_get: could not open \"%s\"", filename);
@@ -336,7 +945,8 @@ RendererServices::pointcloud_get (ShaderGlobals *sg,
     }
 
     // lookup the ParticleAttribute pointer needed for a query
-    Partio::ParticleAttribute *attr = pc->m_attributes[attr_name].get();
+    PointCloud::AttributeMap::const_iterator found = pc->m_attributes.find(attr_name);
+    Partio::ParticleAttribute *attr = found != pc->m_attributes.end() ? found->second.get() : NULL;
     if (! attr) {
         sg->context->errorf("Accessing unexisting attribute %s in pointcloud \"%s\"", attr_name, filename);
         return 0;
@@ -401,15 +1011,24 @@ RendererServices::pointcloud_get (ShaderGlobals *sg,
 
 
 bool
-RendererServices::pointcloud_write (ShaderGlobals* /*sg*/,
+RendererServices::pointcloud_write (ShaderGlobals *sg,
                                     ustring filename, const OSL::Vec3 &pos,
                                     int nattribs, const ustring *names,
                                     const TypeDesc *types,
                                     const void **data)
 {
-#ifdef USE_PARTIO
     if (filename.empty())
         return false;
+    if (is_native_pointcloud(filename)) {
+        NativePointCloud *pc = NativePointCloud::get(filename, true /* create file to write */);
+        if (pc == NULL) {
+            sg->context->errorf("pointcloud_write: \"%s\" is already open for reading", filename);
+            return false;
+        }
+        spin_lock lock (pc->m_mutex);
+        return pc->add_point (pos, nattribs, names, types, data);
+    }
+#ifdef USE_PARTIO
     PointCloud *pc = PointCloud::get(filename, true /* create file to write */);
     spin_lock lock (pc->m_mutex);
     Partio::ParticlesDataMutable *cloud = pc->write_access();
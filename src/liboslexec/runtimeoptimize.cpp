@@ -6,6 +6,7 @@
 #include <cstdio>
 #include <cmath>
 
+#include <OpenImageIO/fmath.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/timer.h>
 #include <OpenImageIO/thread.h>
@@ -848,6 +849,8 @@ RuntimeOptimizer::simplify_params ()
             continue;  // Skip non-params
         if (! s->lockgeom())
             continue;  // Don't mess with params that can change with the geom
+        if (s->interactive())
+            continue;  // ...or that may be edited after optimization
         if (s->typespec().is_structure() || s->typespec().is_closure_based())
             continue;  // We don't mess with struct placeholders or closures
 
@@ -888,6 +891,7 @@ RuntimeOptimizer::simplify_params ()
                     if ((src->symtype() == SymTypeGlobal ||
                          src->symtype() == SymTypeConst ||
                          (src->symtype() == SymTypeParam && src->lockgeom() &&
+                          ! src->interactive() &&
                           (src->valuesource() == Symbol::DefaultVal ||
                            src->valuesource() == Symbol::InstanceVal)))
                         && !src->everwritten()
@@ -921,7 +925,7 @@ RuntimeOptimizer::simplify_params ()
                     // examining.
                     ShaderInstance *uplayer = group()[c.srclayer];
                     Symbol *srcsym = uplayer->symbol(c.src.param);
-                    if (!srcsym->lockgeom())
+                    if (!srcsym->lockgeom() || srcsym->interactive())
                         continue; // Not if it can be overridden by geometry
 
                     // Is the source symbol known to be a global, from
@@ -2102,6 +2106,7 @@ RuntimeOptimizer::optimize_ops (int beginop, int endop,
             for (int i = inst()->firstparam();  i < inst()->lastparam();  ++i) {
                 Symbol *s (inst()->symbol(i));
                 if (s->symtype() == SymTypeOutputParam && s->lockgeom() &&
+                      ! s->interactive() &&
                       (s->valuesource() == Symbol::DefaultVal ||
                        s->valuesource() == Symbol::InstanceVal) &&
                       ! s->has_init_ops() &&
@@ -3251,6 +3256,35 @@ RuntimeOptimizer::run ()
     }
     group().does_nothing (does_nothing);
 
+    // Lay out the block that the JITed code will read interactive params
+    // from, and seed it with their current values.
+    size_t arena_size = 0;
+    for (int layer = 0;  layer < nlayers;  ++layer) {
+        set_inst (layer);
+        if (inst()->unused() || ! inst()->interactive_params())
+            continue;
+        FOREACH_PARAM (Symbol &s, inst()) {
+            if (s.interactive() && ! s.connected()) {
+                size_t align = s.typespec().simpletype().basesize();
+                arena_size = OIIO::round_to_multiple (arena_size, align);
+                s.interactive_offset ((int) arena_size);
+                arena_size += s.size();
+            }
+        }
+    }
+    group().m_interactive_arena_size = arena_size;
+    group().m_interactive_arena.reset (arena_size ? new char[arena_size] : nullptr);
+    for (int layer = 0;  layer < nlayers;  ++layer) {
+        set_inst (layer);
+        if (inst()->unused() || ! inst()->interactive_params())
+            continue;
+        FOREACH_PARAM (Symbol &s, inst()) {
+            if (s.interactive_offset() >= 0)
+                memcpy (group().m_interactive_arena.get() + s.interactive_offset(),
+                        s.data(), s.size());
+        }
+    }
+
     m_stat_specialization_time = rop_timer();
     {
         // adjust memory stats
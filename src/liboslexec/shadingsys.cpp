@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/imageworks/OpenShadingLanguage
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <cstdio>
@@ -155,6 +156,15 @@ ShadingSystem::Parameter (ShaderGroup& group, string_view name, TypeDesc t,
 
 
 
+bool
+ShadingSystem::Parameter (ShaderGroup& group, string_view name, TypeDesc t,
+                          const void *val, bool lockgeom, bool interactive)
+{
+    return m_impl->Parameter (group, name, t, val, lockgeom, interactive);
+}
+
+
+
 bool
 ShadingSystem::Parameter (string_view name, TypeDesc t, const void *val,
                           bool lockgeom)
@@ -212,6 +222,15 @@ ShadingSystem::ReParameter (ShaderGroup &group, string_view layername,
 
 
 
+ShaderGroupRef
+ShadingSystem::PromoteInteractiveParameters (ShaderGroup &group,
+                                             int priority)
+{
+    return m_impl->PromoteInteractiveParameters (group, priority);
+}
+
+
+
 PerThreadInfo *
 ShadingSystem::create_thread_info ()
 {
@@ -543,6 +562,14 @@ ShadingSystem::getstats (int level) const
 
 
 
+void
+ShadingSystem::invalidate_attribute_cache ()
+{
+    m_impl->invalidate_attribute_cache ();
+}
+
+
+
 void
 ShadingSystem::register_closure (string_view name, int id,
                                  const ClosureParam *params,
@@ -621,7 +648,54 @@ ShadingSystem::raytype_bit (ustring name)
 void
 ShadingSystem::optimize_all_groups (int nthreads, bool do_jit)
 {
-    return m_impl->optimize_all_groups (nthreads, 0 /*mythread*/, 1 /*totalthreads*/, do_jit);
+    return m_impl->optimize_all_groups (nthreads, do_jit);
+}
+
+
+
+void
+ShadingSystem::optimize_all_groups (const Executor &executor, int nthreads,
+                                    bool do_jit)
+{
+    return m_impl->optimize_all_groups (nthreads, do_jit, &executor);
+}
+
+
+
+bool
+ShadingSystem::compile_async (ShaderGroup *group, int priority)
+{
+    return group ? m_impl->compile_async (*group, priority) : false;
+}
+
+
+
+bool
+ShadingSystem::cancel_compile_async (ShaderGroup *group)
+{
+    return group ? m_impl->cancel_compile_async (*group) : false;
+}
+
+
+
+bool
+ShadingSystem::warmup_textures (ShaderGroup *group, bool wait)
+{
+    if (! group || ! group->optimized())
+        return false;
+    m_impl->warmup_textures (*group, std::max (1, m_impl->texture_warmup()), wait);
+    return true;
+}
+
+
+
+bool
+ShadingSystem::execute_nonblocking (ShadingContext &ctx, ShaderGroup &group,
+                                    ShaderGlobals &globals, bool &ready,
+                                    int priority, bool run)
+{
+    return m_impl->execute_nonblocking (ctx, group, globals, ready,
+                                        priority, run);
 }
 
 
@@ -699,7 +773,7 @@ template<int WidthT>
 void
 ShadingSystem::BatchedExecutor<WidthT>::jit_all_groups (int nthreads)
 {
-    OSL_ASSERT(0 && "To Be Implemented");
+    m_shading_system.m_impl->template batched<WidthT>().jit_all_groups (nthreads);
 }
 
 // Explicitly instantiate
@@ -863,7 +937,9 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_error_repeats(false),
       m_range_checking(true),
       m_unknown_coordsys_error(true), m_connection_error(true),
-      m_greedyjit(false), m_countlayerexecs(false),
+      m_greedyjit(false), m_jit_cost_order(true),
+      m_llvm_tiered_jit(0), m_llvm_tiered_jit_level(11), m_jit_dedup(true),
+      m_countlayerexecs(false),
       m_relaxed_param_typecheck(false),
       m_max_warnings_per_thread(100),
       m_profile(0),
@@ -908,6 +984,8 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_stat_total_llvm_time(0),
       m_stat_llvm_setup_time(0), m_stat_llvm_irgen_time(0),
       m_stat_llvm_opt_time(0), m_stat_llvm_jit_time(0),
+      m_stat_parallel_compiles(0), m_stat_parallel_compile_time(0),
+      m_stat_parallel_compile_capacity(0),
       m_stat_inst_merge_time(0),
       m_stat_max_llvm_local_mem(0)
 {
@@ -932,12 +1010,28 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
     m_stat_global_connections = 0;
     m_stat_tex_calls_codegened = 0;
     m_stat_tex_calls_as_handles = 0;
+    m_stat_groups_tiered_up = 0;
+    m_stat_groups_deduped = 0;
+    m_stat_async_jit_queued = 0;
+    m_stat_async_jit_compiled = 0;
+    m_stat_async_jit_cancelled = 0;
+    m_stat_jit_cache_hits = 0;
+    m_stat_jit_cache_misses = 0;
+    m_stat_jit_cache_uncacheable = 0;
+    m_stat_jit_cache_bytes_loaded = 0;
+    m_stat_textures_warmed = 0;
+    m_stat_texture_warmup_failed = 0;
     m_stat_master_load_time = 0;
     m_stat_optimization_time = 0;
     m_stat_getattribute_time = 0;
     m_stat_getattribute_fail_time = 0;
     m_stat_getattribute_calls = 0;
+    m_stat_getattribute_cache_hits = 0;
     m_stat_get_userdata_calls = 0;
+    m_stat_matrix_cache_hits = 0;
+    m_stat_matrix_cache_misses = 0;
+    m_stat_string_cache_hits = 0;
+    m_stat_string_cache_misses = 0;
     m_stat_noise_calls = 0;
     m_stat_pointcloud_searches = 0;
     m_stat_pointcloud_searches_total_results = 0;
@@ -957,6 +1051,9 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
         m_err = & ErrorHandler::default_handler ();
     }
 
+    // Only renderers that opt in pay for the getattribute cache.
+    m_use_attribute_invariance = renderer->supports ("attribute_invariance");
+
     // If client didn't supply a texture system, use the one already held
     // by the renderer (if it returns one).
     if (! m_texturesys)
@@ -1047,7 +1144,7 @@ shading_system_setup_op_descriptors (ShadingSystemImpl::OpDescriptorMap& op_desc
     OP (compassign,  compassign,          compassign,    false,     0);
     OP (compl,       unary_op,            compl,         true,      0);
     OP (compref,     compref,             compref,       true,      0);
-    OP (concat,      generic,             concat,        true,      0);
+    OP (concat,      string_op,           concat,        true,      0);
     OP (continue,    loopmod_op,          none,          false,     0);
     OP (cos,         generic,             cos,           true,      0);
     OP (cosh,        generic,             none,          true,      0);
@@ -1134,8 +1231,8 @@ shading_system_setup_op_descriptors (ShadingSystemImpl::OpDescriptorMap& op_desc
     OP (psnoise,     noise,               noise,         true,      0);
     OP (radians,     generic,             radians,       true,      0);
     OP (raytype,     raytype,             raytype,       true,      0);
-    OP (regex_match, regex,               none,          false,     0);
-    OP (regex_search, regex,              regex_search,  false,     0);
+    OP (regex_match, regex,               regex,         false,     0);
+    OP (regex_search, regex,              regex,         false,     0);
     OP (return,      return,              none,          false,     0);
     OP (round,       generic,             none,          true,      0);
     OP (select,      select,              select,        true,      0);
@@ -1160,7 +1257,7 @@ shading_system_setup_op_descriptors (ShadingSystemImpl::OpDescriptorMap& op_desc
     OP2(strtof,stof, generic,             stof,          true,      0);
     OP2(strtoi,stoi, generic,             stoi,          true,      0);
     OP (sub,         sub,                 sub,           true,      0);
-    OP (substr,      generic,             substr,        true,      0);
+    OP (substr,      string_op,           substr,        true,      0);
     OP (surfacearea, get_simple_SG_field, none,          true,      0);
     OP (tan,         generic,             none,          true,      0);
     OP (tanh,        generic,             none,          true,      0);
@@ -1240,6 +1337,12 @@ ShadingSystemImpl::query_closure(const char **name, int *id,
 
 ShadingSystemImpl::~ShadingSystemImpl ()
 {
+    // Stop the background compile threads before tearing anything down
+    // that they might be using.
+    shutdown_async_jit_threads ();
+    for (auto &t : m_texture_warmup_tasks)
+        t.wait ();
+
     size_t ngroups = m_all_shader_groups.size();
     for (size_t i = 0;  i < ngroups;  ++i) {
         if (ShaderGroupRef g = m_all_shader_groups[i].lock()) {
@@ -1253,6 +1356,7 @@ ShadingSystemImpl::~ShadingSystemImpl ()
     }
 
     printstats ();
+    free_dict_resources ();
     // N.B. just let m_texsys go -- if we asked for one to be created,
     // we asked for a shared one.
 
@@ -1381,6 +1485,12 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
     ATTR_SET ("unknown_coordsys_error", int, m_unknown_coordsys_error);
     ATTR_SET ("connection_error", int, m_connection_error);
     ATTR_SET ("greedyjit", int, m_greedyjit);
+    ATTR_SET ("async_jit_threads", int, m_async_jit_threads);
+    ATTR_SET ("texture_warmup", int, m_texture_warmup);
+    ATTR_SET ("jit_cost_order", int, m_jit_cost_order);
+    ATTR_SET ("llvm_tiered_jit", int, m_llvm_tiered_jit);
+    ATTR_SET ("llvm_tiered_jit_level", int, m_llvm_tiered_jit_level);
+    ATTR_SET ("jit_dedup", int, m_jit_dedup);
     ATTR_SET ("relaxed_param_typecheck", int, m_relaxed_param_typecheck);
     ATTR_SET ("countlayerexecs", int, m_countlayerexecs);
     ATTR_SET ("max_warnings_per_thread", int, m_max_warnings_per_thread);
@@ -1401,6 +1511,7 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
     ATTR_SET_STRING ("only_groupname", m_only_groupname);
     ATTR_SET_STRING ("archive_groupname", m_archive_groupname);
     ATTR_SET_STRING ("archive_filename", m_archive_filename);
+    ATTR_SET_STRING ("jit_cache_dir", m_jit_cache_dir);
 
     // cases for special handling
     if (name == "searchpath:shader" && type == TypeDesc::STRING) {
@@ -1532,6 +1643,12 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("unknown_coordsys_error", int, m_unknown_coordsys_error);
     ATTR_DECODE ("connection_error", int, m_connection_error);
     ATTR_DECODE ("greedyjit", int, m_greedyjit);
+    ATTR_DECODE ("async_jit_threads", int, m_async_jit_threads);
+    ATTR_DECODE ("texture_warmup", int, m_texture_warmup);
+    ATTR_DECODE ("jit_cost_order", int, m_jit_cost_order);
+    ATTR_DECODE ("llvm_tiered_jit", int, m_llvm_tiered_jit);
+    ATTR_DECODE ("llvm_tiered_jit_level", int, m_llvm_tiered_jit_level);
+    ATTR_DECODE ("jit_dedup", int, m_jit_dedup);
     ATTR_DECODE ("countlayerexecs", int, m_countlayerexecs);
     ATTR_DECODE ("relaxed_param_typecheck", int, m_relaxed_param_typecheck);
     ATTR_DECODE ("max_warnings_per_thread", int, m_max_warnings_per_thread);
@@ -1543,6 +1660,7 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE_STRING ("only_groupname", m_only_groupname);
     ATTR_DECODE_STRING ("archive_groupname", m_archive_groupname);
     ATTR_DECODE_STRING ("archive_filename", m_archive_filename);
+    ATTR_DECODE_STRING ("jit_cache_dir", m_jit_cache_dir);
     ATTR_DECODE ("max_local_mem_KB", int, m_max_local_mem_KB);
     ATTR_DECODE ("compile_report", int, m_compile_report);
     ATTR_DECODE ("buffer_printf", int, m_buffer_printf);
@@ -1574,6 +1692,17 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("stat:global_connections", int, m_stat_global_connections);
     ATTR_DECODE ("stat:tex_calls_codegened", int, m_stat_tex_calls_codegened);
     ATTR_DECODE ("stat:tex_calls_as_handles", int, m_stat_tex_calls_as_handles);
+    ATTR_DECODE ("stat:groups_tiered_up", int, m_stat_groups_tiered_up);
+    ATTR_DECODE ("stat:groups_deduped", int, m_stat_groups_deduped);
+    ATTR_DECODE ("stat:async_jit_queued", int, m_stat_async_jit_queued);
+    ATTR_DECODE ("stat:async_jit_compiled", int, m_stat_async_jit_compiled);
+    ATTR_DECODE ("stat:async_jit_cancelled", int, m_stat_async_jit_cancelled);
+    ATTR_DECODE ("stat:jit_cache_hits", int, m_stat_jit_cache_hits);
+    ATTR_DECODE ("stat:jit_cache_misses", int, m_stat_jit_cache_misses);
+    ATTR_DECODE ("stat:jit_cache_uncacheable", int, m_stat_jit_cache_uncacheable);
+    ATTR_DECODE ("stat:jit_cache_bytes_loaded", long long, m_stat_jit_cache_bytes_loaded);
+    ATTR_DECODE ("stat:textures_warmed", int, m_stat_textures_warmed);
+    ATTR_DECODE ("stat:texture_warmup_failed", int, m_stat_texture_warmup_failed);
     ATTR_DECODE ("stat:master_load_time", float, m_stat_master_load_time);
     ATTR_DECODE ("stat:optimization_time", float, m_stat_optimization_time);
     ATTR_DECODE ("stat:opt_locking_time", float, m_stat_opt_locking_time);
@@ -1583,9 +1712,26 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("stat:llvm_irgen_time", float, m_stat_llvm_irgen_time);
     ATTR_DECODE ("stat:llvm_opt_time", float, m_stat_llvm_opt_time);
     ATTR_DECODE ("stat:llvm_jit_time", float, m_stat_llvm_jit_time);
+    ATTR_DECODE ("stat:parallel_compile_time", float, m_stat_parallel_compile_time);
+    if (name == "stat:parallel_compile_utilization" && type == TypeDesc::TypeFloat) {
+        spin_lock lock (m_stat_mutex);
+        double busy = 0.0;
+        for (double b : m_stat_compile_worker_busy)
+            busy += b;
+        *(float *)val = m_stat_parallel_compile_capacity > 0.0
+                      ? float(busy / m_stat_parallel_compile_capacity) : 0.0f;
+        return true;
+    }
     ATTR_DECODE ("stat:inst_merge_time", float, m_stat_inst_merge_time);
     ATTR_DECODE ("stat:getattribute_calls", long long, m_stat_getattribute_calls);
+    ATTR_DECODE ("stat:getattribute_cache_hits", long long, m_stat_getattribute_cache_hits);
+    ATTR_DECODE ("stat:getattribute_time", float, m_stat_getattribute_time);
+    ATTR_DECODE ("stat:getattribute_fail_time", float, m_stat_getattribute_fail_time);
     ATTR_DECODE ("stat:get_userdata_calls", long long, m_stat_get_userdata_calls);
+    ATTR_DECODE ("stat:matrix_cache_hits", long long, m_stat_matrix_cache_hits);
+    ATTR_DECODE ("stat:matrix_cache_misses", long long, m_stat_matrix_cache_misses);
+    ATTR_DECODE ("stat:string_cache_hits", long long, m_stat_string_cache_hits);
+    ATTR_DECODE ("stat:string_cache_misses", long long, m_stat_string_cache_misses);
     ATTR_DECODE ("stat:noise_calls", long long, m_stat_noise_calls);
     ATTR_DECODE ("stat:pointcloud_searches", long long, m_stat_pointcloud_searches);
     ATTR_DECODE ("stat:pointcloud_gets", long long, m_stat_pointcloud_gets);
@@ -1686,6 +1832,14 @@ ShadingSystemImpl::attribute (ShaderGroup *group, string_view name,
             group->m_renderer_outputs.emplace_back(((const char **)val)[i]);
         return true;
     }
+    if (name == "tier_up_pending" && type == TypeDesc::TypeInt) {
+        // tier_up_group holds the group's mutex while it re-JITs, so this
+        // also waits for a tier-up that is already under way.
+        lock_guard lock (group->m_mutex);
+        *(int *)val = ! group->m_tierup_bitcode.empty() &&
+                      group->m_tierup_countdown <= 0;
+        return true;
+    }
     if (name == "entry_layers" && type.basetype == TypeDesc::STRING) {
         group->clear_entry_layers ();
         for (int i = 0;  i < (int)type.numelements();  ++i)
@@ -1993,6 +2147,24 @@ struct group_time_compare { // So looking forward to C++11 lambdas!
 
 
 
+int
+ShadingSystemImpl::profile_site (ustring sourcefile, int sourceline)
+{
+    spin_lock lock (m_stat_mutex);
+    auto found = m_profile_site_index.find (std::make_pair (sourcefile, sourceline));
+    if (found != m_profile_site_index.end())
+        return found->second;
+    int site = (int) m_profile_sites.size();
+    ProfileSite p;
+    p.sourcefile = sourcefile;
+    p.sourceline = sourceline;
+    m_profile_sites.push_back (p);
+    m_profile_site_index[std::make_pair (sourcefile, sourceline)] = site;
+    return site;
+}
+
+
+
 std::string
 ShadingSystemImpl::getstats (int level) const
 {
@@ -2038,6 +2210,12 @@ ShadingSystemImpl::getstats (int level) const
     BOOLOPT (error_repeats);
     BOOLOPT (range_checking);
     BOOLOPT (greedyjit);
+    BOOLOPT (jit_cost_order);
+    INTOPT (async_jit_threads);
+    INTOPT (texture_warmup);
+    INTOPT (llvm_tiered_jit);
+    INTOPT (llvm_tiered_jit_level);
+    BOOLOPT (jit_dedup);
     BOOLOPT (countlayerexecs);
     BOOLOPT (opt_simplify_param);
     BOOLOPT (opt_constant_fold);
@@ -2071,6 +2249,7 @@ ShadingSystemImpl::getstats (int level) const
     STROPT (debug_layername);
     STROPT (archive_groupname);
     STROPT (archive_filename);
+    STROPT (jit_cache_dir);
 #undef BOOLOPT
 #undef INTOPT
 #undef STROPT
@@ -2181,20 +2360,63 @@ ShadingSystemImpl::getstats (int level) const
         out << "    LLVM JIT:                  "
             << Strutil::timeintervalformat (m_stat_llvm_jit_time, 2) << "\n";
     }
+    if (m_stat_parallel_compiles) {
+        spin_lock lock (m_stat_mutex);
+        out << "    parallel compiles:         " << m_stat_parallel_compiles
+            << " (" << Strutil::timeintervalformat (m_stat_parallel_compile_time, 2)
+            << " wall clock)\n";
+        for (size_t t = 0;  t < m_stat_compile_worker_busy.size();  ++t) {
+            double busy = m_stat_compile_worker_busy[t];
+            out << Strutil::sprintf ("      worker %2d busy:         %s (%.0f%%)\n",
+                                     (int)t, Strutil::timeintervalformat (busy, 2),
+                                     100.0 * busy / std::max (m_stat_parallel_compile_time, 1e-9));
+        }
+    }
 
     out << "  Texture calls compiled: "
         << (int)m_stat_tex_calls_codegened
         << " (" << (int)m_stat_tex_calls_as_handles << " used handles)\n";
+    out << "  Groups sharing JITed code of an identical group: "
+        << (int)m_stat_groups_deduped << "\n";
+    if (m_llvm_tiered_jit)
+        out << "  Groups re-JITed fully optimized: "
+            << (int)m_stat_groups_tiered_up << "\n";
+    if (m_stat_async_jit_queued)
+        out << Strutil::sprintf ("  Async JIT: %d queued, %d compiled, %d cancelled\n",
+                                 (int)m_stat_async_jit_queued,
+                                 (int)m_stat_async_jit_compiled,
+                                 (int)m_stat_async_jit_cancelled);
+    if (m_stat_textures_warmed || m_stat_texture_warmup_failed)
+        out << Strutil::sprintf ("  Textures warmed up: %d (%d failed)\n",
+                                 (int)m_stat_textures_warmed,
+                                 (int)m_stat_texture_warmup_failed);
+    if (m_jit_cache_dir.size()) {
+        out << Strutil::sprintf ("  JIT cache: %d hits (%s loaded), %d misses, %d uncacheable\n",
+                                 (int)m_stat_jit_cache_hits,
+                                 Strutil::memformat (m_stat_jit_cache_bytes_loaded),
+                                 (int)m_stat_jit_cache_misses,
+                                 (int)m_stat_jit_cache_uncacheable);
+    }
     out << "  Regex's compiled: " << m_stat_regexes << "\n";
     out << "  Largest generated function local memory size: "
         << m_stat_max_llvm_local_mem/1024 << " KB\n";
-    if (m_stat_getattribute_calls) {
+    if (m_stat_getattribute_calls || m_stat_getattribute_cache_hits) {
         out << "  getattribute calls: " << m_stat_getattribute_calls << " ("
             << Strutil::timeintervalformat (m_stat_getattribute_time, 2) << ")\n";
         out << "     (fail time "
             << Strutil::timeintervalformat (m_stat_getattribute_fail_time, 2) << ")\n";
+        out << "     (plus " << m_stat_getattribute_cache_hits
+            << " answered from the invariant attribute cache)\n";
     }
     out << "  Number of get_userdata calls: " << m_stat_get_userdata_calls << "\n";
+    if (long long lookups = m_stat_matrix_cache_hits + m_stat_matrix_cache_misses) {
+        out << Strutil::sprintf ("  Transform lookups: %lld (%.1f%% from the per-execution cache)\n",
+                                 lookups, 100.0 * m_stat_matrix_cache_hits / lookups);
+    }
+    if (long long made = m_stat_string_cache_hits + m_stat_string_cache_misses) {
+        out << Strutil::sprintf ("  Strings made by string ops: %lld (%.1f%% from the per-context cache)\n",
+                                 made, 100.0 * m_stat_string_cache_hits / made);
+    }
     if (profile() > 1)
         out << "  Number of noise calls: " << m_stat_noise_calls << "\n";
     if (m_stat_pointcloud_searches || m_stat_pointcloud_writes) {
@@ -2228,17 +2450,6 @@ ShadingSystemImpl::getstats (int level) const
         out << "    Total shader execution time: "
             << Strutil::timeintervalformat(OIIO::Timer::seconds(m_stat_total_shading_time_ticks), 2)
             << " (sum of all threads)\n";
-        // Account for times of any groups that haven't yet been destroyed
-        {
-            spin_lock lock (m_all_shader_groups_mutex);
-            for (auto&& grp : m_all_shader_groups) {
-                if (ShaderGroupRef g = grp.lock()) {
-                    long long ticks = g->m_stat_total_shading_time_ticks;
-                    m_group_profile_times[g->name()] += ticks;
-                    g->m_stat_total_shading_time_ticks -= ticks;
-                }
-            }
-        }
         {
             spin_lock lock (m_stat_mutex);
             std::vector<GroupTimeVal> grouptimes;
@@ -2257,6 +2468,31 @@ ShadingSystemImpl::getstats (int level) const
                     << ' ' << (i->first.size() ? i->first.c_str() : "<unnamed group>") << "\n";
             }
         }
+        if (m_profile > 1) {
+            spin_lock lock (m_stat_mutex);
+            std::vector<const ProfileSite *> lines;
+            long long total = 0;
+            for (auto&& site : m_profile_sites) {
+                total += site.nanoseconds;
+                if (site.runs)
+                    lines.push_back (&site);
+            }
+            std::sort (lines.begin(), lines.end(),
+                       [](const ProfileSite *a, const ProfileSite *b) {
+                           return a->nanoseconds > b->nanoseconds;
+                       });
+            if (lines.size() > 20)
+                lines.resize (20);
+            if (lines.size())
+                out << Strutil::sprintf ("    Most expensive shader source lines "
+                                         "(less %lld ns probe overhead per run):\n",
+                                         (long long)m_profile_line_overhead);
+            for (auto site : lines)
+                out << Strutil::sprintf ("      %s %5.1f%%  %s:%d (%lld runs)\n",
+                          Strutil::timeintervalformat (site->nanoseconds * 1.0e-9, 2),
+                          100.0 * site->nanoseconds / total,
+                          site->sourcefile, site->sourceline, site->runs);
+        }
 
     }
 
@@ -2286,7 +2522,8 @@ ShadingSystemImpl::Parameter (string_view name, TypeDesc t, const void *val,
 
 bool
 ShadingSystemImpl::Parameter (ShaderGroup& group, string_view name,
-                              TypeDesc t, const void *val, bool lockgeom)
+                              TypeDesc t, const void *val, bool lockgeom,
+                              bool interactive)
 {
     // We work very hard not to do extra copies of the data.  First,
     // grow the pending list by one (empty) slot...
@@ -2297,13 +2534,15 @@ ShadingSystemImpl::Parameter (ShaderGroup& group, string_view name,
     // param's interpolation to VERTEX rather than the default CONSTANT.
     if (lockgeom == false)
         group.m_pending_params.back().interp (OIIO::ParamValue::INTERP_VERTEX);
+    else if (interactive)
+        group.m_pending_interactive.emplace_back (name);
     return true;
 }
 
 
 
 ShaderGroupRef
-ShadingSystemImpl::ShaderGroupBegin (string_view groupname)
+ShadingSystemImpl::new_group (string_view groupname)
 {
     ShaderGroupRef group (new ShaderGroup(groupname));
     group->m_exec_repeat = m_exec_repeat;
@@ -2312,13 +2551,22 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname)
         spin_lock lock (m_all_shader_groups_mutex);
         m_all_shader_groups.push_back (group);
         ++m_groups_to_compile_count;
-        m_curgroup = group;
     }
     return group;
 }
 
 
 
+ShaderGroupRef
+ShadingSystemImpl::ShaderGroupBegin (string_view groupname)
+{
+    ShaderGroupRef group = new_group (groupname);
+    m_curgroup = group;
+    return group;
+}
+
+
+
 bool
 ShadingSystemImpl::ShaderGroupEnd (void)
 {
@@ -2341,6 +2589,15 @@ ShadingSystemImpl::ShaderGroupEnd (ShaderGroup& group)
     // up as a major bottleneck, I'm inclined to play it safe.
     lock_guard lock (m_mutex);
 
+    // Remember the network as described, before merging and optimizing
+    // change it, in case PromoteInteractiveParameters needs to rebuild it.
+    for (int layer = 0, n = group.nlayers(); layer < n; ++layer) {
+        if (group[layer] && group[layer]->interactive_params()) {
+            group.m_original_spec = group.serialize (false);
+            break;
+        }
+    }
+
     // Mark the layers that can be run lazily
     if (! group.m_group_use.empty()) {
         int nlayers = group.nlayers ();
@@ -2423,9 +2680,10 @@ ShadingSystemImpl::Shader (ShaderGroup& group, string_view shaderusage,
     }
 
     ShaderInstanceRef instance (new ShaderInstance (master, layername));
-    instance->parameters (group.m_pending_params);
+    instance->parameters (group.m_pending_params, group.m_pending_interactive);
     group.m_pending_params.clear ();
     group.m_pending_params.shrink_to_fit ();
+    group.m_pending_interactive.clear ();
 
     if (group.m_group_use.empty()) {
         // First in a group
@@ -2576,6 +2834,17 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
                                      string_view groupspec)
 {
     ShaderGroupRef g = ShaderGroupBegin (groupname);
+    if (! parse_group_spec (*g, usage, groupspec))
+        return ShaderGroupRef();
+    return g;
+}
+
+
+
+bool
+ShadingSystemImpl::parse_group_spec (ShaderGroup& group, string_view usage,
+                                     string_view groupspec)
+{
     bool err = false;
     std::string errdesc;
     string_view errstatement;
@@ -2597,7 +2866,7 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
             string_view shadername = Strutil::parse_identifier (p);
             Strutil::skip_whitespace (p);
             string_view layername = Strutil::parse_until (p, " \t\r\n,;");
-            bool ok = Shader (*g, usage, shadername, layername);
+            bool ok = Shader (group, usage, shadername, layername);
             if (!ok) {
                 errstatement = pstart;
                 err = true;
@@ -2617,7 +2886,7 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
             string_view lay2 = Strutil::parse_until (p, " \t\r\n.");
             Strutil::parse_char (p, '.');
             string_view param2 = Strutil::parse_until (p, " \t\r\n,;");
-            bool ok = ConnectShaders (*g, lay1, param1, lay2, param2);
+            bool ok = ConnectShaders (group, lay1, param1, lay2, param2);
             if (!ok) {
                 errstatement = pstart;
                 err = true;
@@ -2683,6 +2952,7 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
         }
         string_view paramname (paramname_string);
         int lockgeom = m_lockgeom_default;
+        int interactive = 0;
         // For speed, reserve space. Note that for "unsized" arrays, we only
         // preallocate 1 slot and let it grow as needed. That's ok. For
         // everything else, we will reserve the right amount up front.
@@ -2782,6 +3052,12 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
                         errdesc = Strutil::sprintf ("hint %s expected int value", hint_name);
                         break;
                     }
+                } else if (hint_name == "interactive" && hint_type == TypeDesc::INT) {
+                    if (! Strutil::parse_int (p, interactive)) {
+                        err = true;
+                        errdesc = Strutil::sprintf ("hint %s expected int value", hint_name);
+                        break;
+                    }
                 } else {
                     err = true;
                     errdesc = Strutil::sprintf ("unknown hint '%s %s'",
@@ -2800,11 +3076,14 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
 
         bool ok = true;
         if (type.basetype == TypeDesc::INT) {
-            ok = Parameter (*g, paramname, type, &intvals[0], lockgeom);
+            ok = Parameter (group, paramname, type, &intvals[0], lockgeom,
+                            interactive);
         } else if (type.basetype == TypeDesc::FLOAT) {
-            ok = Parameter (*g, paramname, type, &floatvals[0], lockgeom);
+            ok = Parameter (group, paramname, type, &floatvals[0], lockgeom,
+                            interactive);
         } else if (type.basetype == TypeDesc::STRING) {
-            ok = Parameter (*g, paramname, type, &stringvals[0], lockgeom);
+            ok = Parameter (group, paramname, type, &stringvals[0], lockgeom,
+                            interactive);
         }
         if (!ok) {
             errstatement = pstart;
@@ -2830,7 +3109,7 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
         std::string msg = Strutil::sprintf(
                 "ShaderGroupBegin: error parsing group description: %s\n"
                 "        group: %s",
-                errdesc, g->name());
+                errdesc, group.name());
         if (errstatement.empty()) {
             size_t offset = p.data() - groupspec.data();
             size_t begin_stmt = std::min (groupspec.find_last_of (';', offset),
@@ -2844,10 +3123,10 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
         errorf("%s", msg);
         if (debug())
             infof("Broken group was:\n---%s\n---\n", groupspec);
-        return ShaderGroupRef();
+        return false;
     }
 
-    return g;
+    return true;
 }
 
 
@@ -2886,17 +3165,99 @@ ShadingSystemImpl::ReParameter (ShaderGroup &group, string_view layername_,
         return false;
 
     // Can't change param value if the group has already been optimized,
-    // unless that parameter is marked lockgeom=0.
-    if (group.optimized() && sym->lockgeom())
+    // unless that parameter is marked lockgeom=0 or interactive.
+    if (group.optimized() && sym->lockgeom() && ! sym->interactive())
         return false;
 
     // Do the deed
     memcpy (sym->data(), val, type.size());
+    // The JITed code reads interactive params from the group's block, so
+    // the change takes effect on the next execution without recompiling.
+    if (sym->interactive_offset() >= 0 && group.m_interactive_arena)
+        memcpy (group.m_interactive_arena.get() + sym->interactive_offset(),
+                val, type.size());
     return true;
 }
 
 
 
+ShaderGroupRef
+ShadingSystemImpl::PromoteInteractiveParameters (ShaderGroup &group,
+                                                 int priority)
+{
+    // Rebuild the network as it was originally described, with the current
+    // values of the interactive params as ordinary instance values that the
+    // optimizer is free to fold, and queue it for background compilation.
+    // The new group is never made the "current" group of the
+    // non-threadsafe group construction calls.
+    if (group.m_original_spec.empty()) {
+        errorf ("PromoteInteractiveParameters: group \"%s\" has no "
+                "interactive parameters", group.name());
+        return ShaderGroupRef();
+    }
+    ShaderGroupRef newgroup = new_group (group.name());
+    if (! parse_group_spec (*newgroup, group.m_group_use,
+                            group.m_original_spec))
+        return ShaderGroupRef();
+    {
+        lock_guard lock (group.m_mutex);
+        newgroup->m_renderer_outputs = group.m_renderer_outputs;
+        newgroup->m_exec_repeat = group.m_exec_repeat;
+        newgroup->m_raytypes_on = group.m_raytypes_on;
+        newgroup->m_raytypes_off = group.m_raytypes_off;
+        const char *arena = group.interactive_arena();
+        for (int i = 0, e = std::min (group.nlayers(), newgroup->nlayers());
+             i < e;  ++i) {
+            ShaderInstance *oldinst = group[i];
+            ShaderInstance *newinst = (*newgroup)[i];
+            newinst->entry_layer (oldinst->entry_layer());
+            if (! arena || ! oldinst->interactive_params())
+                continue;
+            // Layers are rebuilt in the same order from the same masters,
+            // so param indices match.  Take the current values from the
+            // block that ReParameter writes.
+            for (int p = oldinst->firstparam();  p < oldinst->lastparam();  ++p) {
+                const Symbol *sym = oldinst->symbol (p);
+                if (sym && sym->interactive_offset() >= 0)
+                    memcpy (newinst->param_storage (p),
+                            arena + sym->interactive_offset(), sym->size());
+            }
+        }
+    }
+    if (! ShaderGroupEnd (*newgroup))
+        return ShaderGroupRef();
+    compile_async (*newgroup, priority);
+    return newgroup;
+}
+
+
+
+const CompiledRegex &
+ShadingSystemImpl::find_regex (ustring pattern)
+{
+    {
+        spin_rw_read_lock lock (m_regex_mutex);
+        RegexMap::const_iterator found = m_regex_map.find (pattern);
+        if (found != m_regex_map.end())
+            return *found->second;
+    }
+
+    // Compile it without holding the lock; if another thread beat us to
+    // it, theirs wins and ours is discarded.
+    std::unique_ptr<CompiledRegex> regex (new CompiledRegex (pattern));
+    spin_rw_write_lock lock (m_regex_mutex);
+    std::unique_ptr<CompiledRegex> &slot (m_regex_map[pattern]);
+    if (! slot) {
+        if (! regex->valid())
+            errorf ("Invalid regex pattern \"%s\"", pattern);
+        slot = std::move (regex);
+        m_stat_regexes += 1;
+    }
+    return *slot;
+}
+
+
+
 PerThreadInfo *
 ShadingSystemImpl::create_thread_info()
 {
@@ -2941,6 +3302,7 @@ ShadingSystemImpl::release_context (ShadingContext *ctx)
     if (! ctx)
         return;
     ctx->process_errors ();
+    ctx->flush_runtime_stats ();
     ctx->thread_info()->context_pool.push (ctx);
 }
 
@@ -2955,6 +3317,22 @@ ShadingSystemImpl::execute (ShadingContext &ctx, ShaderGroup &group,
 
 
 
+bool
+ShadingSystemImpl::execute_nonblocking (ShadingContext &ctx,
+                                        ShaderGroup &group,
+                                        ShaderGlobals &ssg, bool &ready,
+                                        int priority, bool run)
+{
+    // Empty groups need no compilation, just let execute() deal with them.
+    ready = group.jitted() || group.nlayers() == 0
+            || compile_async (group, priority);
+    if (! ready)
+        return false;
+    return ctx.execute (group, ssg, run);
+}
+
+
+
 // Deprecated
 bool
 ShadingSystemImpl::execute (ShadingContext *ctx, ShaderGroup &group,
@@ -3145,6 +3523,92 @@ ShadingSystemImpl::is_renderer_output (ustring layername, ustring paramname,
 
 
 
+bool
+ShadingSystemImpl::jit_dedup_lookup (const std::string &key,
+                                     ShaderGroup &group)
+{
+    lock_guard lock (m_jit_dedup_mutex);
+    auto found = m_jit_dedup_table.find (key);
+    if (found == m_jit_dedup_table.end())
+        return false;
+    LLVM_Util::JitCodeHandle code = found->second.code.lock();
+    if (! code) {
+        // Every group using that code is gone, and so is the code.
+        m_jit_dedup_table.erase (found);
+        return false;
+    }
+    // Identical modules have identical layer functions, so the layer
+    // numbering matches too.
+    const JitDedupEntry &e (found->second);
+    group.llvm_compiled_init (e.init);
+    for (int layer = 0, n = (int)e.layers.size(); layer < n; ++layer)
+        if (e.layers[layer])
+            group.llvm_compiled_layer (layer, e.layers[layer]);
+    if (group.num_entry_layers())
+        group.llvm_compiled_version (NULL);
+    else
+        group.llvm_compiled_version (group.llvm_compiled_layer(group.nlayers()-1));
+    group.add_jit_code (code);
+    ++m_stat_groups_deduped;
+    return true;
+}
+
+
+
+void
+ShadingSystemImpl::jit_dedup_add (const std::string &key,
+                                  const ShaderGroup &group,
+                                  const LLVM_Util::JitCodeHandle &code)
+{
+    if (! code)
+        return;
+    JitDedupEntry e;
+    e.code = code;
+    e.init = group.llvm_compiled_init();
+    e.layers.resize (group.nlayers(), nullptr);
+    for (int layer = 0, n = group.nlayers(); layer < n; ++layer)
+        e.layers[layer] = group.llvm_compiled_layer (layer);
+    lock_guard lock (m_jit_dedup_mutex);
+    // A lookup of the same key notices when the code of an entry is gone,
+    // but keys that are never asked for again would pile up, so sweep out
+    // all dead entries whenever the table has doubled since the last
+    // sweep (amortized constant time per add).
+    if (m_jit_dedup_table.size() >= m_jit_dedup_sweep_size) {
+        for (auto i = m_jit_dedup_table.begin(); i != m_jit_dedup_table.end(); ) {
+            if (i->second.code.expired())
+                i = m_jit_dedup_table.erase (i);
+            else
+                ++i;
+        }
+        m_jit_dedup_sweep_size = std::max (size_t(64), 2 * m_jit_dedup_table.size());
+    }
+    m_jit_dedup_table[key] = std::move (e);
+}
+
+
+
+void
+ShadingSystemImpl::tier_up_group (ShaderGroup &group, ShadingContext *ctx)
+{
+    OIIO::Timer timer;
+    lock_guard lock (group.m_mutex);
+    if (group.m_tierup_bitcode.empty())
+        return;   // Not quick-JITed, or already recompiled
+
+    BackendLLVM lljitter (*this, group, ctx);
+    lljitter.run_tier_up ();
+    ++m_stat_groups_tiered_up;
+
+    spin_lock stat_lock (m_stat_mutex);
+    m_stat_optimization_time += timer();
+    m_stat_total_llvm_time += lljitter.m_stat_total_llvm_time;
+    m_stat_llvm_setup_time += lljitter.m_stat_llvm_setup_time;
+    m_stat_llvm_opt_time += lljitter.m_stat_llvm_opt_time;
+    m_stat_llvm_jit_time += lljitter.m_stat_llvm_jit_time;
+}
+
+
+
 void
 ShadingSystemImpl::group_post_jit_cleanup (ShaderGroup &group)
 {
@@ -3261,6 +3725,8 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
             group.m_attribute_scopes.push_back (f.scope);
         }
         group.m_optimized = true;
+        if (m_texture_warmup && group.m_textures_needed.size())
+            warmup_textures (group, m_texture_warmup);
 
         spin_lock stat_lock (m_stat_mutex);
         if (!need_jit) {
@@ -3275,6 +3741,9 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
     if (need_jit) {
         BackendLLVM lljitter (*this, group, ctx);
         lljitter.run ();
+        // N.B. If tiered JIT is on, run() armed m_tierup_countdown, and
+        // ShadingContext::execute_init will call request_tier_up once
+        // the group has been executed that many times.
 
         // NOTE: it is now possible to optimize and not JIT
         // which would leave the cleanup to happen
@@ -3379,104 +3848,361 @@ ShadingSystemImpl::Batched<WidthT>::jit_group (ShaderGroup &group, ShadingContex
 }
 
 
-static void optimize_all_groups_wrapper (ShadingSystemImpl *ss, int mythread, int totalthreads, bool do_jit)
+// Rough estimate of how much work it is to optimize and JIT a group.
+static size_t
+group_compile_cost (const ShaderGroup &group)
 {
-    ss->optimize_all_groups (1, mythread, totalthreads, do_jit);
+    size_t cost = 0;
+    for (int layer = 0, n = group.nlayers();  layer < n;  ++layer) {
+        const ShaderInstance *inst = group[layer];
+        cost += inst->ops().size() ? inst->ops().size()
+                                   : (size_t)inst->master()->num_ops();
+    }
+    return cost;
 }
 
-template<int WidthT>
-static void batched_jit_all_groups_wrapper (ShadingSystemImpl *ss, int mythread, int totalthreads)
+
+
+void
+ShadingSystemImpl::compile_groups_parallel (int nthreads,
+        const ShadingSystem::Executor *executor,
+        const std::function<bool(ShaderGroup&)> &needs_work,
+        const std::function<void(ShaderGroup&,ShadingContext*)> &compile)
 {
-    ss->batched<WidthT>().jit_all_groups(1, mythread, totalthreads);
+    // Take a snapshot of the groups that need compiling.
+    std::vector<ShaderGroupRef> groups;
+    {
+        spin_lock lock (m_all_shader_groups_mutex);
+        groups.reserve (m_all_shader_groups.size());
+        for (auto&& g : m_all_shader_groups) {
+            ShaderGroupRef group = g.lock();
+            if (group && group->m_complete && needs_work (*group))
+                groups.push_back (group);
+        }
+    }
+    if (groups.empty())
+        return;
+    if (m_jit_cost_order) {
+        // Start the big ones first, so that the stragglers at the end
+        // are the cheap groups.
+        std::vector<std::pair<size_t,ShaderGroupRef> > bycost;
+        bycost.reserve (groups.size());
+        for (auto&& g : groups)
+            bycost.emplace_back (group_compile_cost (*g), g);
+        std::stable_sort (bycost.begin(), bycost.end(),
+                          [](const std::pair<size_t,ShaderGroupRef> &a,
+                             const std::pair<size_t,ShaderGroupRef> &b) {
+                              return a.first > b.first;
+                          });
+        for (size_t i = 0;  i < groups.size();  ++i)
+            groups[i] = bycost[i].second;
+    }
+
+    if (nthreads < 1)  // threads <= 0 means use all hardware available
+        nthreads = (int)std::thread::hardware_concurrency();
+    nthreads = OIIO::clamp (nthreads, 1, (int)groups.size());
+
+    std::atomic<size_t> cursor (0);
+    std::atomic<int> nextworker (0);
+    std::vector<double> busy (nthreads, 0.0);
+    auto work = [&]() {
+        int w = nextworker++;
+        if (w >= nthreads)
+            return;   // the executor started more workers than we asked for
+        OIIO::Timer timer;
+        PerThreadInfo* threadinfo = create_thread_info();
+        ShadingContext* ctx = get_context(threadinfo);
+        for (size_t i;  (i = cursor++) < groups.size();  )
+            compile (*groups[i], ctx);
+        release_context(ctx);
+        destroy_thread_info(threadinfo);
+        busy[w] = timer();
+    };
+
+    OIIO::Timer timer;
+    if (executor) {
+        (*executor) (nthreads, work);
+    } else if (nthreads == 1) {
+        work ();
+    } else {
+        // Persistent pool threads do most of the work, and the calling
+        // thread pitches in rather than just waiting.
+        OIIO::thread_pool *pool = OIIO::default_thread_pool();
+        OIIO::task_set tasks (pool);
+        for (int t = 1;  t < nthreads;  ++t)
+            tasks.push (pool->push ([&](int /*id*/){ work(); }));
+        work ();
+        tasks.wait ();
+    }
+    double wall = timer();
+
+    spin_lock stat_lock (m_stat_mutex);
+    ++m_stat_parallel_compiles;
+    m_stat_parallel_compile_time += wall;
+    m_stat_parallel_compile_capacity += wall * nthreads;
+    if (m_stat_compile_worker_busy.size() < busy.size())
+        m_stat_compile_worker_busy.resize (busy.size(), 0.0);
+    for (size_t t = 0;  t < busy.size();  ++t)
+        m_stat_compile_worker_busy[t] += busy[t];
 }
 
+
+
 void
-ShadingSystemImpl::optimize_all_groups (int nthreads, int mythread, int totalthreads, bool do_jit)
+ShadingSystemImpl::optimize_all_groups (int nthreads, bool do_jit,
+                                        const ShadingSystem::Executor *executor)
 {
-    // Spawn a bunch of threads to do this in parallel -- just call this
-    // routine again (with threads=1) for each thread.
-    if (nthreads < 1)  // threads <= 0 means use all hardware available
-        nthreads = std::min ((int)std::thread::hardware_concurrency(),
-                             (int)m_groups_to_compile_count);
-    if (nthreads > 1) {
-        if (m_threads_currently_compiling)
-            return;   // never mind, somebody else spawned the JIT threads
-        OIIO::thread_group threads;
-        m_threads_currently_compiling += nthreads;
-        for (int t = 0;  t < nthreads;  ++t)
-            threads.add_thread (new std::thread (optimize_all_groups_wrapper, this, t, nthreads, do_jit));
-        threads.join_all ();
-        m_threads_currently_compiling -= nthreads;
+    if (nthreads != 1 && m_threads_currently_compiling)
+        return;   // never mind, somebody else spawned the JIT threads
+    m_threads_currently_compiling += 1;
+    compile_groups_parallel (nthreads, executor,
+        [=](ShaderGroup &group) {
+            return ! group.optimized() || (do_jit && ! group.jitted());
+        },
+        [=](ShaderGroup &group, ShadingContext *ctx) {
+            optimize_group (group, ctx, do_jit);
+        });
+    m_threads_currently_compiling -= 1;
+}
+
+bool
+ShadingSystemImpl::compile_async (ShaderGroup &group, int priority)
+{
+    if (group.jitted())
+        return true;
+    std::lock_guard<std::mutex> lock (m_async_jit_mutex);
+    enqueue_async_jit (group, priority);
+    return false;
+}
+
+
+
+void
+ShadingSystemImpl::request_tier_up (ShaderGroup &group)
+{
+    // Groups that can't run at all yet are more urgent than groups that
+    // merely could run faster, so tier-ups go to the back of the queue.
+    std::lock_guard<std::mutex> lock (m_async_jit_mutex);
+    enqueue_async_jit (group, std::numeric_limits<int>::min());
+}
+
+
+
+void
+ShadingSystemImpl::enqueue_async_jit (ShaderGroup &group, int priority)
+{
+    // N.B. Caller holds m_async_jit_mutex.
+    if (m_async_jit_shutdown)
         return;
-    }
+    if (group.m_async_jit_queued && group.m_async_jit_priority >= priority)
+        return;   // already waiting, at least as urgently
+    // Requeue with a bumped priority.  Any stale entry for the group still
+    // in the heap is harmless: the worker will find it already compiled.
+    std::weak_ptr<ShaderGroup> groupref;
+    try {
+        groupref = group.shared_from_this();
+    } catch (const std::bad_weak_ptr &) {
+        return;   // Not owned by a ShaderGroupRef, can't track it
+    }
+    group.m_async_jit_queued = true;
+    group.m_async_jit_priority = priority;
+    m_async_jit_queue.push_back ({ groupref, priority, m_async_jit_serial++ });
+    std::push_heap (m_async_jit_queue.begin(), m_async_jit_queue.end());
+    ++m_stat_async_jit_queued;
+    start_async_jit_threads ();
+    m_async_jit_cv.notify_one ();
+}
+
+
+
+bool
+ShadingSystemImpl::cancel_compile_async (ShaderGroup &group)
+{
+    std::lock_guard<std::mutex> lock (m_async_jit_mutex);
+    if (! group.m_async_jit_queued)
+        return false;
+    group.m_async_jit_queued = false;
+    auto e = std::remove_if (m_async_jit_queue.begin(), m_async_jit_queue.end(),
+                             [&](const AsyncJitRequest &r) {
+                                 auto g = r.group.lock();
+                                 return !g || g.get() == &group;
+                             });
+    m_async_jit_queue.erase (e, m_async_jit_queue.end());
+    std::make_heap (m_async_jit_queue.begin(), m_async_jit_queue.end());
+    ++m_stat_async_jit_cancelled;
+    return true;
+}
+
+
+
+void
+ShadingSystemImpl::start_async_jit_threads ()
+{
+    // N.B. Caller holds m_async_jit_mutex.
+    if (m_async_jit_threads_pool.size())
+        return;
+    int nthreads = m_async_jit_threads;
+    if (nthreads < 1)
+        nthreads = std::max (1, (int)std::thread::hardware_concurrency());
+    for (int t = 0;  t < nthreads;  ++t)
+        m_async_jit_threads_pool.emplace_back (&ShadingSystemImpl::async_jit_worker, this);
+}
 
-    // And here's the single thread case
-    size_t ngroups = 0;
+
+
+void
+ShadingSystemImpl::shutdown_async_jit_threads ()
+{
     {
-        spin_lock lock (m_all_shader_groups_mutex);
-        ngroups = m_all_shader_groups.size();
-    }
+        std::lock_guard<std::mutex> lock (m_async_jit_mutex);
+        m_async_jit_shutdown = true;
+        m_async_jit_queue.clear ();
+    }
+    m_async_jit_cv.notify_all ();
+    for (auto &t : m_async_jit_threads_pool)
+        t.join ();
+    m_async_jit_threads_pool.clear ();
+}
+
+
+
+void
+ShadingSystemImpl::async_jit_worker ()
+{
     PerThreadInfo* threadinfo = create_thread_info();
     ShadingContext* ctx = get_context(threadinfo);
-    for (size_t i = 0;  i < ngroups;  ++i) {
-        // Assign to threads based on mod of totalthreads
-        if ((i % totalthreads) == (unsigned)mythread) {
-            ShaderGroupRef group;
-            {
-                spin_lock lock (m_all_shader_groups_mutex);
-                group = m_all_shader_groups[i].lock();
+    for (;;) {
+        ShaderGroupRef group;
+        {
+            std::unique_lock<std::mutex> lock (m_async_jit_mutex);
+            m_async_jit_cv.wait (lock, [&]{
+                return m_async_jit_shutdown || m_async_jit_queue.size();
+            });
+            if (m_async_jit_shutdown)
+                break;
+            std::pop_heap (m_async_jit_queue.begin(), m_async_jit_queue.end());
+            AsyncJitRequest req = m_async_jit_queue.back();
+            m_async_jit_queue.pop_back ();
+            group = req.group.lock();
+            if (! group) {
+                // The group was destroyed while it waited; nothing to do.
+                ++m_stat_async_jit_cancelled;
+                continue;
             }
-            if (group && group->m_complete)
-                optimize_group (*group, ctx, do_jit);
+            if (! group->m_async_jit_queued)
+                continue;   // stale entry, already serviced or cancelled
+            group->m_async_jit_queued = false;
+        }
+        if (group->m_complete && ! group->jitted()) {
+            optimize_group (*group, ctx, true);
+            ++m_stat_async_jit_compiled;
+        } else if (group->jitted()) {
+            tier_up_group (*group, ctx);
         }
     }
     release_context(ctx);
     destroy_thread_info(threadinfo);
 }
 
-template<int WidthT>
+
+
 void
-ShadingSystemImpl::Batched<WidthT>::jit_all_groups (int nthreads, int mythread, int totalthreads)
+ShadingSystemImpl::warmup_textures (ShaderGroup &group, int level, bool wait)
 {
-    // Spawn a bunch of threads to do this in parallel -- just call this
-    // routine again (with threads=1) for each thread.
-    if (nthreads < 1)  // threads <= 0 means use all hardware available
-        nthreads = std::min ((int)std::thread::hardware_concurrency(),
-                             (int)m_ssi.m_groups_to_compile_count);
-    if (nthreads > 1) {
-        if (m_ssi.m_threads_currently_compiling)
-            return;   // never mind, somebody else spawned the JIT threads
-        OIIO::thread_group threads;
-        m_ssi.m_threads_currently_compiling += nthreads;
-        for (int t = 0;  t < nthreads;  ++t)
-            threads.add_thread (new std::thread (batched_jit_all_groups_wrapper<WidthT>, &m_ssi, t, nthreads));
-        threads.join_all ();
-        m_ssi.m_threads_currently_compiling -= nthreads;
-        return;
+    // Only the files nobody has asked for before get a task.  The names
+    // are copied, so the group may go away while its warmup is running.
+    std::vector<ustring> files;
+    std::vector<std::shared_future<void>> pending;
+    {
+        lock_guard lock (m_texture_warmup_mutex);
+        for (ustring f : group.m_textures_needed)
+            if (m_textures_warmed.insert (f).second)
+                files.push_back (f);
+        // Forget about the tasks that have already finished.
+        auto done = [](const std::shared_future<void> &t) {
+            return t.wait_for (std::chrono::seconds(0)) == std::future_status::ready;
+        };
+        m_texture_warmup_tasks.erase (std::remove_if (m_texture_warmup_tasks.begin(),
+                                                      m_texture_warmup_tasks.end(), done),
+                                      m_texture_warmup_tasks.end());
+        if (files.size()) {
+            std::shared_future<void> task = OIIO::default_thread_pool()->push ([=](int /*id*/){
+                for (ustring f : files)
+                    warmup_texture_file (f, level);
+            }).share();
+            m_texture_warmup_tasks.push_back (task);
+        }
+        // Some of this group's files may be in a task started for an
+        // earlier group, so waiting means waiting for all of them.
+        if (wait)
+            pending = m_texture_warmup_tasks;
     }
+    for (auto &t : pending)
+        t.wait ();
+}
 
-    // And here's the single thread case
-    size_t ngroups = 0;
-    {
-        spin_lock lock (m_ssi.m_all_shader_groups_mutex);
-        ngroups = m_ssi.m_all_shader_groups.size();
+
+
+void
+ShadingSystemImpl::warmup_texture_file (ustring filename, int level)
+{
+    // Getting the handle and asking whether the file exists is enough to
+    // make the TextureSystem open it and read its header.
+    static ustring exists_name ("exists"), miplevels ("miplevels");
+    TextureSystem *ts = texturesys();
+    TextureSystem::TextureHandle *handle = ts->get_texture_handle (filename);
+    int exists = 0;
+    ImageSpec spec;
+    if (! handle
+        || ! ts->get_texture_info (handle, nullptr, 0, exists_name,
+                                   TypeDesc::TypeInt, &exists)
+        || ! exists
+        || ! ts->get_imagespec (handle, nullptr, 0, spec)) {
+        (void) ts->geterror ();   // Errors belong to the shader that uses it
+        ++m_stat_texture_warmup_failed;
+        return;
     }
-    PerThreadInfo* threadinfo = m_ssi.create_thread_info();
-    ShadingContext* ctx = m_ssi.get_context(threadinfo);
-    for (size_t i = 0;  i < ngroups;  ++i) {
-        // Assign to threads based on mod of totalthreads
-        if ((i % totalthreads) == (unsigned)mythread) {
-            ShaderGroupRef group;
-            {
-                spin_lock lock (m_ssi.m_all_shader_groups_mutex);
-                group = m_ssi.m_all_shader_groups[i].lock();
-            }
-            if (group)
-                jit_group (*group, ctx);
-        }
+    ++m_stat_textures_warmed;
+    if (level < 2)
+        return;
+
+    // Read the coarsest MIP level, which lookups with big filter widths
+    // go to first.  An image with no MIP levels is skipped: reading all of
+    // it now is no better than letting the first lookup do it.
+    int nmiplevels = 0;
+    if (! ts->get_texture_info (handle, nullptr, 0, miplevels,
+                                TypeDesc::TypeInt, &nmiplevels)
+        || nmiplevels < 2) {
+        (void) ts->geterror ();
+        return;
     }
-    m_ssi.release_context(ctx);
-    m_ssi.destroy_thread_info(threadinfo);
+    int m = nmiplevels - 1;
+    int w = std::max (1, spec.width >> m);
+    int h = std::max (1, spec.height >> m);
+    int d = std::max (1, spec.depth >> m);
+    std::vector<float> texels (size_t(w) * h * d * spec.nchannels);
+    TextureOpt opt;
+    if (! ts->get_texels (handle, nullptr, opt, m, 0, w, 0, h, 0, d,
+                          0, spec.nchannels, TypeDesc::FLOAT, texels.data()))
+        (void) ts->geterror ();
+}
+
+
+
+template<int WidthT>
+void
+ShadingSystemImpl::Batched<WidthT>::jit_all_groups (int nthreads)
+{
+    if (nthreads != 1 && m_ssi.m_threads_currently_compiling)
+        return;   // never mind, somebody else spawned the JIT threads
+    m_ssi.m_threads_currently_compiling += 1;
+    Batched<WidthT> self (*this);
+    m_ssi.compile_groups_parallel (nthreads, nullptr,
+        [](ShaderGroup &group) { return ! group.batch_jitted(); },
+        [=](ShaderGroup &group, ShadingContext *ctx) mutable {
+            self.jit_group (group, ctx);
+        });
+    m_ssi.m_threads_currently_compiling -= 1;
 }
 
 // Explicitly instantiate, although might need to specialize on target
@@ -4064,3 +4790,14 @@ osl_bind_interpolated_param (void *sg_, const void *name, long long type,
     }
     return 0;  // no such user data
 }
+
+
+
+// Return the block that the running group's interactive params are read
+// from.
+OSL_SHADEOP void *
+osl_get_interactive_params (void *sg_)
+{
+    ShaderGlobals *sg = (ShaderGlobals *)sg_;
+    return sg->context->group()->interactive_arena();
+}
@@ -15,6 +15,8 @@
 
 #include <OSL/oslcomp.h>
 #include <OSL/oslexec.h>
+
+#include "osoreader.h"
 using namespace OSL;
 
 
@@ -40,6 +42,7 @@ usage()
            "\t-Werror        Treat all warnings as errors\n"
            "\t-embed-source  Embed preprocessed source in the oso file\n"
            "\t-buffer        (debugging) Force compile from buffer\n"
+           "\t-binary-oso    Write binary oso, which loads faster than text\n"
            "\t-MD, -MMD      Write a depfile containing headers used, to a file\n"
            "\t-M, -MM        Like -MD, but write depfile to stdout\n"
            "\t-MF filename   Specify the name of the depfile to output (for -MD, -MMD)\n"
@@ -110,6 +113,8 @@ main(int argc, const char* argv[])
     std::vector<std::string> args;
     bool quiet               = false;
     bool compile_from_buffer = false;
+    bool binary_oso          = false;
+    bool writes_oso          = true;
     std::string shader_path;
 
     // Parse arguments from command line
@@ -125,7 +130,8 @@ main(int argc, const char* argv[])
                    || !strcmp(argv[a], "-MM")
                    || !strcmp(argv[a], "--user-dependencies")) {
             args.emplace_back(argv[a]);
-            quiet = true;
+            quiet      = true;
+            writes_oso = false;
         } else if (!strcmp(argv[a], "-v") || !strcmp(argv[a], "-d")
                    || !strcmp(argv[a], "-O") || !strcmp(argv[a], "-O0")
                    || !strcmp(argv[a], "-O1") || !strcmp(argv[a], "-O2")
@@ -156,6 +162,9 @@ main(int argc, const char* argv[])
             args.emplace_back(argv[a]);
         } else if (!strcmp(argv[a], "-buffer")) {
             compile_from_buffer = true;
+        } else if (!strcmp(argv[a], "-binary-oso")
+                   || !strcmp(argv[a], "--binary-oso")) {
+            binary_oso = true;
         } else {
             // Shader to compile
             shader_path = argv[a];
@@ -191,6 +200,23 @@ main(int argc, const char* argv[])
         ok = compiler.compile(shader_path, args);
     }
 
+    if (ok && binary_oso && writes_oso) {
+        // Replace the text oso just written with its binary form
+        std::string osotext, osobinary;
+        ok = OIIO::Filesystem::read_text_file(compiler.output_filename(),
+                                              osotext)
+             && pvt::OSOBinaryWriter::convert(osotext, osobinary,
+                                              &default_oslc_error_handler);
+        if (ok) {
+            OIIO::ofstream file;
+            OIIO::Filesystem::open(file, compiler.output_filename(),
+                                   std::ios::out | std::ios::binary);
+            if (file)
+                file.write(osobinary.data(), osobinary.size());
+            ok = file.good();
+        }
+    }
+
     if (ok) {
         if (!quiet)
             std::cout << "Compiled " << shader_path << " -> "
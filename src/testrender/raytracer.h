@@ -5,9 +5,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <limits>
 #include <vector>
 
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/simd.h>
 
 #include <OSL/dual_vec.h>
 #include <OSL/oslconfig.h>
@@ -387,6 +390,21 @@ private:
 
 
 
+// Node of the bounding volume hierarchy used by Scene::intersect. Nodes
+// are stored depth-first, so the left child of an interior node always
+// immediately follows it and only the right child needs an index. The
+// fourth lane of the bounds is zero so the box test can run on SIMD float4.
+struct BVHNode {
+    float lo[4];
+    float hi[4];
+    int offset;   // interior: index of right child, leaf: first bvh_prims entry
+    int count;    // number of primitives in a leaf, 0 for interior nodes
+    int axis;     // split axis of an interior node (picks near child first)
+    int pad;
+};
+
+
+
 struct Scene {
     void add_sphere(const Sphere& s) {
         spheres.push_back(s);
@@ -400,25 +418,81 @@ struct Scene {
         return spheres.size() + quads.size();
     }
 
+    // Build the BVH and the list of light sources. Must be called after
+    // all primitives have been added; until then intersect() falls back to
+    // testing every primitive.
+    void prepare() {
+        const int n = num_prims();
+        std::vector<BuildPrim> prims(n);
+        lights.clear();
+        for (int i = 0; i < n; i++) {
+            BuildPrim& b = prims[i];
+            b.id = i;
+            getBounds(i, b.lo[0], b.lo[1], b.lo[2], b.hi[0], b.hi[1], b.hi[2]);
+            // pad the bounds slightly so that flat quads and grazing hits
+            // on box faces are not lost to rounding in the slab test
+            for (int a = 0; a < 3; a++) {
+                float eps = 1e-5f * std::max(1.0f, std::max(fabsf(b.lo[a]), fabsf(b.hi[a])));
+                b.lo[a] -= eps;
+                b.hi[a] += eps;
+                b.c[a] = 0.5f * (b.lo[a] + b.hi[a]);
+            }
+            if (islight(i))
+                lights.push_back(i);
+        }
+        bvh_nodes.clear();
+        bvh_prims.clear();
+        bvh_nodes.reserve(2 * n);
+        bvh_prims.reserve(n);
+        if (n)
+            build_node(prims, 0, n, 0);
+    }
+
     bool intersect(const Ray& r, Dual2<float>& t, int& primID) const {
-        const int ns = spheres.size();
-        const int nq = quads.size();
         const int self = primID; // remember which object we started from
         t = std::numeric_limits<float>::infinity();
         primID = -1; // reset ID
-        for (int i = 0; i < ns; i++) {
-            Dual2<float> d = spheres[i].intersect(r, self == i);
-            if (d.val() > 0 && d.val() < t.val()) { // found valid hit?
-                t = d;
-                primID = i;
-            }
+        if (bvh_nodes.empty()) {
+            for (int i = 0, n = num_prims(); i < n; i++)
+                intersect_prim(r, i, self, t, primID);
+            return primID >= 0;
         }
-        for (int i = 0; i < nq; i++) {
-            Dual2<float> d = quads[i].intersect(r, self == (i + ns));
-            if (d.val() > 0 && d.val() < t.val()) { // found valid hit?
-                t = d;
-                primID = i + ns;
+
+        typedef OIIO::simd::float4 simd4;
+        const Vec3& o = r.origin.val();
+        const Vec3& d = r.direction.val();
+        const simd4 org(o.x, o.y, o.z, 0.0f);
+        const simd4 idir(safe_rcp(d.x), safe_rcp(d.y), safe_rcp(d.z), 1.0f);
+        const bool negdir[3] = { d.x < 0, d.y < 0, d.z < 0 };
+
+        int stack[BVH_MAX_DEPTH + 1];
+        int sp = 0, node = 0;
+        for (;;) {
+            const BVHNode& bn = bvh_nodes[node];
+            // slab test against the current closest hit; ties are kept so
+            // that equal distance hits resolve by primID like a linear scan
+            simd4 t0 = (simd4(bn.lo) - org) * idir;
+            simd4 t1 = (simd4(bn.hi) - org) * idir;
+            float tnear = OIIO::simd::reduce_max(OIIO::simd::min(t0, t1));
+            float tfar = OIIO::simd::reduce_min(
+                OIIO::simd::insert<3>(OIIO::simd::max(t0, t1), t.val()));
+            if (tnear <= tfar) {
+                if (bn.count > 0) {
+                    for (int i = bn.offset, e = bn.offset + bn.count; i < e; i++)
+                        intersect_prim(r, bvh_prims[i], self, t, primID);
+                } else {
+                    // visit the child on the near side of the split first
+                    int first = node + 1, second = bn.offset;
+                    if (negdir[bn.axis])
+                        std::swap(first, second);
+                    stack[sp++] = second;
+                    node = first;
+                    continue;
+                }
             }
+            if (sp == 0)
+                break;
+            node = stack[--sp];
         }
         return primID >= 0;
     }
@@ -472,13 +546,176 @@ struct Scene {
         return quads[primID].islight();
     }
 
+    void getBounds(int primID, float &minx, float &miny, float &minz,
+                   float &maxx, float &maxy, float &maxz) const {
+        if (primID < int(spheres.size()))
+            return spheres[primID].getBounds(minx, miny, minz, maxx, maxy, maxz);
+        primID -= spheres.size();
+        return quads[primID].getBounds(minx, miny, minz, maxx, maxy, maxz);
+    }
+
     std::vector<Sphere> spheres;
     std::vector<Quad> quads;
+    std::vector<int> lights;            // primIDs of all light sources
+    std::vector<BVHNode> bvh_nodes;     // depth-first, root at index 0
+    std::vector<int> bvh_prims;         // primIDs referenced by the leaves
 #ifdef OSL_USE_OPTIX
 #if (OPTIX_VERSION < 70000)
     std::vector<optix::Material> optix_mtls;
 #endif
 #endif
+
+private:
+    enum { BVH_NUM_BINS = 16, BVH_MAX_LEAF = 4, BVH_MAX_DEPTH = 48 };
+
+    struct BuildPrim {
+        float lo[3], hi[3], c[3];
+        int id;
+    };
+
+    static float safe_rcp(float x) {
+        // keep the slab test free of inf * 0 for axis aligned rays
+        const float tiny = 1e-20f;
+        return 1.0f / (fabsf(x) > tiny ? x : (x < 0 ? -tiny : tiny));
+    }
+
+    static float half_area(const float lo[3], const float hi[3]) {
+        float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+
+    void intersect_prim(const Ray& r, int id, int self, Dual2<float>& t, int& primID) const {
+        const int ns = spheres.size();
+        Dual2<float> d = id < ns ? spheres[id].intersect(r, self == id)
+                                 : quads[id - ns].intersect(r, self == id);
+        if (d.val() > 0 && (d.val() < t.val() || (d.val() == t.val() && id < primID))) {
+            t = d; // found valid hit
+            primID = id;
+        }
+    }
+
+    // Recursively build the subtree for prims[begin,end) using binned SAH
+    // splits on the axis of largest centroid extent, and return the index
+    // of its root node.
+    int build_node(std::vector<BuildPrim>& prims, int begin, int end, int depth) {
+        const float inf = std::numeric_limits<float>::infinity();
+        float lo[3] = { inf, inf, inf }, hi[3] = { -inf, -inf, -inf };
+        float clo[3] = { inf, inf, inf }, chi[3] = { -inf, -inf, -inf };
+        for (int i = begin; i < end; i++) {
+            for (int a = 0; a < 3; a++) {
+                lo[a]  = std::min(lo[a], prims[i].lo[a]);
+                hi[a]  = std::max(hi[a], prims[i].hi[a]);
+                clo[a] = std::min(clo[a], prims[i].c[a]);
+                chi[a] = std::max(chi[a], prims[i].c[a]);
+            }
+        }
+        const int index = bvh_nodes.size();
+        bvh_nodes.push_back(BVHNode());
+        BVHNode& bn = bvh_nodes.back();
+        for (int a = 0; a < 3; a++) {
+            bn.lo[a] = lo[a];
+            bn.hi[a] = hi[a];
+        }
+        bn.lo[3] = bn.hi[3] = 0.0f;
+        bn.pad = 0;
+
+        const int count = end - begin;
+        int axis = 0;
+        for (int a = 1; a < 3; a++)
+            if (chi[a] - clo[a] > chi[axis] - clo[axis])
+                axis = a;
+        const float extent = chi[axis] - clo[axis];
+
+        int mid = -1;
+        if (count > 1 && depth < BVH_MAX_DEPTH) {
+            if (extent > 0) {
+                struct Bin {
+                    float lo[3], hi[3];
+                    int count;
+                } bins[BVH_NUM_BINS];
+                for (auto& b : bins) {
+                    b.lo[0] = b.lo[1] = b.lo[2] = inf;
+                    b.hi[0] = b.hi[1] = b.hi[2] = -inf;
+                    b.count = 0;
+                }
+                const float scale = BVH_NUM_BINS / extent;
+                auto binof = [&](const BuildPrim& p) {
+                    return std::min(BVH_NUM_BINS - 1, int((p.c[axis] - clo[axis]) * scale));
+                };
+                for (int i = begin; i < end; i++) {
+                    Bin& b = bins[binof(prims[i])];
+                    b.count++;
+                    for (int a = 0; a < 3; a++) {
+                        b.lo[a] = std::min(b.lo[a], prims[i].lo[a]);
+                        b.hi[a] = std::max(b.hi[a], prims[i].hi[a]);
+                    }
+                }
+                // sweep from the right to get the cost of every right side
+                float right_cost[BVH_NUM_BINS];
+                float rlo[3] = { inf, inf, inf }, rhi[3] = { -inf, -inf, -inf };
+                int rcount = 0;
+                for (int s = BVH_NUM_BINS - 1; s > 0; s--) {
+                    rcount += bins[s].count;
+                    for (int a = 0; a < 3; a++) {
+                        rlo[a] = std::min(rlo[a], bins[s].lo[a]);
+                        rhi[a] = std::max(rhi[a], bins[s].hi[a]);
+                    }
+                    right_cost[s] = rcount ? rcount * half_area(rlo, rhi) : 0.0f;
+                }
+                // then from the left, picking the cheapest split plane
+                float llo[3] = { inf, inf, inf }, lhi[3] = { -inf, -inf, -inf };
+                int lcount = 0, best_split = -1;
+                float best_cost = inf;
+                for (int s = 1; s < BVH_NUM_BINS; s++) {
+                    lcount += bins[s - 1].count;
+                    for (int a = 0; a < 3; a++) {
+                        llo[a] = std::min(llo[a], bins[s - 1].lo[a]);
+                        lhi[a] = std::max(lhi[a], bins[s - 1].hi[a]);
+                    }
+                    if (lcount == 0 || lcount == count)
+                        continue;
+                    float cost = lcount * half_area(llo, lhi) + right_cost[s];
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_split = s;
+                    }
+                }
+                // SAH with unit traversal and intersection costs
+                float leaf_cost = count * half_area(lo, hi);
+                float split_cost = half_area(lo, hi) + best_cost;
+                if (best_split > 0 && (split_cost < leaf_cost || count > BVH_MAX_LEAF)) {
+                    mid = std::partition(prims.begin() + begin, prims.begin() + end,
+                                         [&](const BuildPrim& p) { return binof(p) < best_split; })
+                          - prims.begin();
+                }
+            }
+            if (mid < 0 && count > BVH_MAX_LEAF) {
+                // no useful plane (e.g. coincident centroids): split at the median
+                mid = begin + count / 2;
+                std::nth_element(prims.begin() + begin, prims.begin() + mid,
+                                 prims.begin() + end,
+                                 [&](const BuildPrim& a, const BuildPrim& b) {
+                                     return a.c[axis] < b.c[axis];
+                                 });
+            }
+        }
+
+        if (mid < 0) {
+            bn.offset = bvh_prims.size();
+            bn.count = count;
+            bn.axis = 0;
+            for (int i = begin; i < end; i++)
+                bvh_prims.push_back(prims[i].id);
+            return index;
+        }
+        bn.count = 0;
+        bn.axis = axis;
+        build_node(prims, begin, mid, depth + 1);
+        int right = build_node(prims, mid, end, depth + 1);
+        // bn may have been invalidated by the recursive push_backs
+        bvh_nodes[index].offset = right;
+        return index;
+    }
 };
 
 OSL_NAMESPACE_EXIT
@@ -823,9 +823,8 @@ Color3 SimpleRaytracer::subpixel_radiance(float x, float y, Sampler& sampler, Sh
         }
 
         // trace one ray to each light
-        for (int lid = 0; lid < scene.num_prims(); lid++) {
+        for (int lid : scene.lights) {
             if (lid == id) continue; // skip self
-            if (!scene.islight(lid)) continue; // doesn't want to be sampled as a light
             int shaderID = scene.shaderid(lid);
             if (shaderID < 0 || !m_shaders[shaderID]) continue; // no shader attached to this light
             // sample a random direction towards the object
@@ -865,16 +864,22 @@ Color3 SimpleRaytracer::subpixel_radiance(float x, float y, Sampler& sampler, Sh
     return path_radiance;
 }
 
+static Vec3 pixel_jitter(Sampler& sampler)
+{
+    // jitter pixel coordinate [0,1)^2
+    Vec3 j = sampler.get();
+    // warp distribution to approximate a tent filter [-1,+1)^2
+    j.x *= 2; j.x = j.x < 1 ? sqrtf(j.x) - 1 : 1 - sqrtf(2 - j.x);
+    j.y *= 2; j.y = j.y < 1 ? sqrtf(j.y) - 1 : 1 - sqrtf(2 - j.y);
+    return j;
+}
+
 Color3 SimpleRaytracer::antialias_pixel(int x, int y, ShadingContext* ctx)
 {
     Color3 result(0, 0, 0);
     for (int si = 0, n = aa * aa; si < n; si++) {
         Sampler sampler(x, y, si);
-        // jitter pixel coordinate [0,1)^2
-        Vec3 j = sampler.get();
-        // warp distribution to approximate a tent filter [-1,+1)^2
-        j.x *= 2; j.x = j.x < 1 ? sqrtf(j.x) - 1 : 1 - sqrtf(2 - j.x);
-        j.y *= 2; j.y = j.y < 1 ? sqrtf(j.y) - 1 : 1 - sqrtf(2 - j.y);
+        Vec3 j = pixel_jitter(sampler);
         // trace eye ray (apply jitter from center of the pixel)
         Color3 r = subpixel_radiance(x + 0.5f + j.x, y + 0.5f + j.y, sampler, ctx);
         // mix in result via lerp for numerical stability
@@ -884,6 +889,255 @@ Color3 SimpleRaytracer::antialias_pixel(int x, int y, ShadingContext* ctx)
 }
 
 
+// Number of paths the wavefront integrator keeps in flight per thread.
+static const int WavefrontSize = 4096;
+
+// One camera path of the wavefront integrator, carrying everything that
+// subpixel_radiance keeps in locals from one bounce to the next.
+struct SimpleRaytracer::WavefrontPath {
+    WavefrontPath(int pixel, const Ray& ray, const Sampler& sampler)
+        : ray(ray), sampler(sampler), pixel(pixel) {}
+
+    Ray ray;
+    Sampler sampler;
+    Color3 weight { 1, 1, 1 };
+    Color3 radiance { 0, 0, 0 };
+    Dual2<float> t;
+    float bsdf_pdf = std::numeric_limits<float>::infinity();
+    int pixel;                  // index of the pixel within the batch
+    int id = -1;                // primitive hit by the current ray
+    int prev_id = -1;           // primitive the current ray left from
+    bool flip = false;
+    bool active = true;
+};
+
+// A shadow ray queued by the shading stage for next event estimation.
+struct SimpleRaytracer::ShadowQuery {
+    ShadowQuery(const Ray& ray, const Color3& contrib, int path, int self, int lid)
+        : ray(ray), contrib(contrib), path(path), self(self), lid(lid) {}
+
+    Ray ray;
+    Color3 contrib;             // path throughput times bsdf and MIS weight
+    Color3 Le { 0, 0, 0 };      // emission found at the light
+    Dual2<float> t;
+    int path;
+    int self;                   // primitive the shadow ray leaves from
+    int lid;                    // light to reach, or -1 for the background
+    bool visible = false;
+};
+
+
+
+void
+SimpleRaytracer::shade_wavefront_path(WavefrontPath& path, int pathindex,
+                                      int bounce, std::vector<ShadowQuery>& shadows,
+                                      ShadingContext* ctx)
+{
+    const int id = path.id;
+    ShaderGlobals sg;
+    globals_from_hit(sg, path.ray, path.t, id, path.flip);
+    int shaderID = scene.shaderid(id);
+
+    // execute shader and process the resulting list of closures
+    shadingsys->execute (*ctx, *m_shaders[shaderID], sg);
+    ShadingResult result;
+    bool last_bounce = bounce == max_bounces;
+    process_closure(result, sg.Ci, last_bounce);
+
+    // add self-emission
+    float k = 1;
+    if (scene.islight(id)) {
+        // figure out the probability of reaching this point
+        float light_pdf = scene.shapepdf(id, path.ray.origin.val(), sg.P);
+        k = MIS::power_heuristic<MIS::WEIGHT_EVAL>(path.bsdf_pdf, light_pdf);
+    }
+    path.radiance += path.weight * k * result.Le;
+
+    // last bounce? nothing left to do
+    if (last_bounce) {
+        path.active = false;
+        return;
+    }
+
+    // build internal pdf for sampling between bsdf closures
+    result.bsdf.prepare(sg, path.weight, bounce >= rr_depth);
+
+    // get three random numbers
+    Vec3 s = path.sampler.get();
+    float xi = s.x;
+    float yi = s.y;
+    float zi = s.z;
+
+    // queue the shadow rays, they are traced together once every path
+    // of this bounce has been shaded
+    if (backgroundResolution > 0) {
+        Dual2<Vec3> bg_dir;
+        float bg_pdf = 0, bsdf_pdf = 0;
+        Vec3 bg = background.sample(xi, yi, bg_dir, bg_pdf);
+        Color3 bsdf_weight = result.bsdf.eval(sg, bg_dir.val(), bsdf_pdf);
+        Color3 contrib = path.weight * bsdf_weight * bg * MIS::power_heuristic<MIS::WEIGHT_WEIGHT>(bg_pdf, bsdf_pdf);
+        if ((contrib.x + contrib.y + contrib.z) > 0)
+            shadows.emplace_back(Ray(sg.P, bg_dir), contrib, pathindex, id, -1);
+    }
+    for (int lid : scene.lights) {
+        if (lid == id) continue; // skip self
+        int lightShaderID = scene.shaderid(lid);
+        if (lightShaderID < 0 || !m_shaders[lightShaderID]) continue; // no shader attached to this light
+        // sample a random direction towards the object
+        float light_pdf;
+        Vec3 ldir = scene.sample(lid, sg.P, xi, yi, light_pdf);
+        float bsdf_pdf = 0;
+        Color3 bsdf_weight = result.bsdf.eval(sg, ldir, bsdf_pdf);
+        Color3 contrib = path.weight * bsdf_weight * MIS::power_heuristic<MIS::EVAL_WEIGHT>(light_pdf, bsdf_pdf);
+        if ((contrib.x + contrib.y + contrib.z) > 0)
+            shadows.emplace_back(Ray(sg.P, ldir), contrib, pathindex, id, lid);
+    }
+
+    // sample the indirect ray for the next bounce
+    path.weight *= result.bsdf.sample(sg, xi, yi, zi, path.ray.direction, path.bsdf_pdf);
+    if (!(path.weight.x > 0) && !(path.weight.y > 0) && !(path.weight.z > 0)) {
+        path.active = false; // filter out all 0's or NaNs
+        return;
+    }
+    path.prev_id = id;
+    path.ray.origin = Dual2<Vec3>(sg.P, sg.dPdx, sg.dPdy);
+    path.flip ^= sg.Ng.dot(path.ray.direction.val()) > 0;
+}
+
+
+
+void
+SimpleRaytracer::trace_wavefront_shadows(std::vector<WavefrontPath>& paths,
+                                         std::vector<ShadowQuery>& shadows,
+                                         std::vector<int>& light_hits,
+                                         ShadingContext* ctx)
+{
+    // trace all shadow rays
+    light_hits.clear();
+    for (int i = 0, n = int(shadows.size()); i < n; i++) {
+        ShadowQuery& q = shadows[i];
+        int shadow_id = q.self; // ignore self hit
+        bool hit = scene.intersect(q.ray, q.t, shadow_id);
+        if (q.lid < 0) {
+            q.visible = !hit; // ray reached the background?
+        } else if (hit && shadow_id == q.lid) {
+            q.visible = true;
+            light_hits.push_back(i);
+        }
+    }
+
+    // evaluate the emission of the lights we reached, grouped by shader
+    std::stable_sort(light_hits.begin(), light_hits.end(), [&](int i, int j) {
+        return scene.shaderid(shadows[i].lid) < scene.shaderid(shadows[j].lid);
+    });
+    for (int i : light_hits) {
+        ShadowQuery& q = shadows[i];
+        // setup a shader global for the point on the light
+        ShaderGlobals light_sg;
+        globals_from_hit(light_sg, q.ray, q.t, q.lid, false);
+        // execute the light shader (for emissive closures only)
+        shadingsys->execute (*ctx, *m_shaders[scene.shaderid(q.lid)], light_sg);
+        ShadingResult light_result;
+        process_closure(light_result, light_sg.Ci, true);
+        q.Le = light_result.Le;
+    }
+
+    // accumulate in the order the queries were made, so that every path
+    // sums its contributions exactly as subpixel_radiance does
+    for (const ShadowQuery& q : shadows) {
+        if (!q.visible)
+            continue;
+        if (q.lid < 0)
+            paths[q.path].radiance += q.contrib;
+        else
+            paths[q.path].radiance += q.contrib * q.Le;
+    }
+}
+
+
+
+void
+SimpleRaytracer::render_wavefront(int xres, int ybegin, int yend, ShadingContext* ctx)
+{
+    const int spp = aa * aa;
+    const int npixels = xres * (yend - ybegin);
+    const int batch_pixels = std::max(1, WavefrontSize / spp);
+    std::vector<WavefrontPath> paths;
+    std::vector<int> hits;
+    std::vector<ShadowQuery> shadows;
+    std::vector<int> light_hits;
+    paths.reserve(size_t(std::min(batch_pixels, npixels)) * spp);
+
+    for (int first = 0; first < npixels; first += batch_pixels) {
+        const int n = std::min(batch_pixels, npixels - first);
+
+        // ray generation: one path per pixel sample
+        paths.clear();
+        for (int p = 0; p < n; p++) {
+            int x = (first + p) % xres, y = ybegin + (first + p) / xres;
+            for (int si = 0; si < spp; si++) {
+                Sampler sampler(x, y, si);
+                Vec3 j = pixel_jitter(sampler);
+                paths.emplace_back(p, camera.get(x + 0.5f + j.x, y + 0.5f + j.y), sampler);
+            }
+        }
+
+        for (int b = 0; b <= max_bounces; b++) {
+            // intersection, retiring the paths that leave the scene
+            hits.clear();
+            for (int i = 0, np = int(paths.size()); i < np; i++) {
+                WavefrontPath& path = paths[i];
+                if (!path.active)
+                    continue;
+                path.id = path.prev_id;
+                if (!scene.intersect(path.ray, path.t, path.id)) {
+                    // we hit nothing? check background shader
+                    if (backgroundShaderID >= 0) {
+                        if (backgroundResolution > 0) {
+                            float bg_pdf = 0;
+                            Vec3 bg = background.eval(path.ray.direction.val(), bg_pdf);
+                            path.radiance += path.weight * bg * MIS::power_heuristic<MIS::WEIGHT_WEIGHT>(path.bsdf_pdf, bg_pdf);
+                        } else {
+                            path.radiance += path.weight * eval_background(path.ray.direction, ctx);
+                        }
+                    }
+                    path.active = false;
+                    continue;
+                }
+                int shaderID = scene.shaderid(path.id);
+                if (shaderID < 0 || !m_shaders[shaderID]) {
+                    path.active = false; // no shader attached? done
+                    continue;
+                }
+                hits.push_back(i);
+            }
+            if (hits.empty())
+                break;
+
+            // sort the hits so each shader group runs over a coherent run
+            std::stable_sort(hits.begin(), hits.end(), [&](int i, int j) {
+                return scene.shaderid(paths[i].id) < scene.shaderid(paths[j].id);
+            });
+
+            // shading, then next event estimation for the whole batch
+            shadows.clear();
+            for (int i : hits)
+                shade_wavefront_path(paths[i], i, b, shadows, ctx);
+            trace_wavefront_shadows(paths, shadows, light_hits, ctx);
+        }
+
+        // resolve the samples of each pixel in the same order as antialias_pixel
+        for (int p = 0; p < n; p++) {
+            Color3 result(0, 0, 0);
+            for (int si = 0; si < spp; si++)
+                result = OIIO::lerp(result, paths[p * spp + si].radiance, 1.0f / (si + 1));
+            int x = (first + p) % xres, y = ybegin + (first + p) / xres;
+            pixelbuf.setpixel(x, y, &result.x, 3);
+        }
+    }
+}
+
+
 void
 SimpleRaytracer::prepare_render ()
 {
@@ -891,6 +1145,10 @@ SimpleRaytracer::prepare_render ()
     aa = std::max (1, options.get_int("aa"));
     max_bounces = options.get_int("max_bounces");
     rr_depth = options.get_int("rr_depth");
+    wavefront = options.get_int("wavefront");
+
+    // build the acceleration structure for the scene
+    scene.prepare();
 
     // prepare background importance table (if requested)
     if (backgroundResolution > 0 && backgroundShaderID >= 0) {
@@ -930,12 +1188,16 @@ SimpleRaytracer::render (int xres, int yres)
         // within a thread.
         ShadingContext *ctx = shadingsys->get_context (thread_info);
 
-        OIIO::ImageBuf::Iterator<float> p(pixelbuf, OIIO::ROI(0,xres,ybegin,yend));
-        for ( ; !p.done(); ++p) {
-            Color3 c = antialias_pixel(p.x(), p.y(), ctx);
-            p[0] = c[0];
-            p[1] = c[1];
-            p[2] = c[2];
+        if (wavefront) {
+            render_wavefront(xres, int(ybegin), int(yend), ctx);
+        } else {
+            OIIO::ImageBuf::Iterator<float> p(pixelbuf, OIIO::ROI(0,xres,ybegin,yend));
+            for ( ; !p.done(); ++p) {
+                Color3 c = antialias_pixel(p.x(), p.y(), ctx);
+                p[0] = c[0];
+                p[1] = c[1];
+                p[2] = c[2];
+            }
         }
 
         // We're done shading with this context.
@@ -111,6 +111,7 @@ private:
     int aa = 1;
     int max_bounces = 1000000;
     int rr_depth = 5;
+    int wavefront = 0;
     std::vector<ShaderGroupRef> m_shaders;
 
     class ErrorHandler;  // subclass ErrorHandler for SimpleRaytracer
@@ -166,6 +167,19 @@ private:
                              ShadingContext* ctx);
     Color3 antialias_pixel(int x, int y, ShadingContext* ctx);
 
+    // Wavefront integrator: paths of a batch of pixels advance one bounce
+    // at a time, with hits sorted by shader before shading.
+    struct WavefrontPath;
+    struct ShadowQuery;
+    void render_wavefront(int xres, int ybegin, int yend, ShadingContext* ctx);
+    void shade_wavefront_path(WavefrontPath& path, int pathindex, int bounce,
+                              std::vector<ShadowQuery>& shadows,
+                              ShadingContext* ctx);
+    void trace_wavefront_shadows(std::vector<WavefrontPath>& paths,
+                                 std::vector<ShadowQuery>& shadows,
+                                 std::vector<int>& light_hits,
+                                 ShadingContext* ctx);
+
     friend class ErrorHandler;
 };
 
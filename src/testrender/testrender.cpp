@@ -50,6 +50,7 @@ static std::string extraoptions;
 static std::string texoptions;
 static int xres = 640, yres = 480;
 static int aa = 1, max_bounces = 1000000, rr_depth = 5;
+static bool wavefront = false;
 static int num_threads = 0;
 static int iters = 1;
 static std::string scenefile, imagefile;
@@ -124,6 +125,7 @@ void getargs(int argc, const char *argv[])
                 "-r %d %d", &xres, &yres, "", // synonym for -res
                 "-aa %d", &aa, "Trace NxN rays per pixel",
                 "--iters %d", &iters, "Number of iterations",
+                "--wavefront", &wavefront, "Trace paths in batches and sort hits by shader (CPU only)",
                 "-O0", &O0, "Do no runtime shader optimization",
                 "-O1", &O1, "Do a little runtime shader optimization",
                 "-O2", &O2, "Do lots of runtime shader optimization",
@@ -191,6 +193,7 @@ main (int argc, const char *argv[])
         rend->attribute("max_bounces", max_bounces);
         rend->attribute("rr_depth", rr_depth);
         rend->attribute("aa", aa);
+        rend->attribute("wavefront", (int)wavefront);
         OIIO::attribute("threads", num_threads);
 
         // Create a new shading system.  We pass it the RendererServices
@@ -143,9 +143,9 @@ SimpleRenderer::~SimpleRenderer ()
 {}
 
 int
-SimpleRenderer::supports (string_view /*feature*/) const
+SimpleRenderer::supports (string_view feature) const
 {
-    return false;
+    return feature == "attribute_invariance";
 }
 
 
@@ -374,6 +374,23 @@ SimpleRenderer::get_attribute (ShaderGlobals *sg, bool derivatives, ustring obje
 
 
 
+RendererServices::AttributeInvariance
+SimpleRenderer::attribute_invariance (ShaderGroup * /*group*/, ustring object,
+                                      ustring name)
+{
+    // The camera and version attributes never change once we start
+    // shading.  "options"/"blahblah" is only promised per object, just to
+    // exercise that kind of caching.  Everything else (like userdata) may
+    // differ from point to point.
+    if (object.empty() && m_attr_getters.count (name))
+        return AttributePerGroup;
+    if (object == "options" && name == "blahblah")
+        return AttributePerObject;
+    return AttributeVaries;
+}
+
+
+
 bool
 SimpleRenderer::get_userdata (bool derivatives, ustring name, TypeDesc type,
                               ShaderGlobals *sg, void *val)
@@ -55,6 +55,9 @@ public:
                                       int index, void *val );
     virtual bool get_attribute (ShaderGlobals *sg, bool derivatives, ustring object,
                                 TypeDesc type, ustring name, void *val);
+    virtual AttributeInvariance attribute_invariance (ShaderGroup *group,
+                                                      ustring object,
+                                                      ustring name);
     virtual bool get_userdata (bool derivatives, ustring name, TypeDesc type, 
                                ShaderGlobals *sg, void *val);
 
@@ -3,6 +3,7 @@
 // https://github.com/imageworks/OpenShadingLanguage
 
 
+#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -10,6 +11,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <OpenImageIO/imageio.h>
@@ -54,12 +56,14 @@ static bool debug2 = false;
 static bool llvm_debug = false;
 static bool verbose = false;
 static bool runstats = false;
+static std::vector<std::string> printstats;
 static bool batched = false;
 static int max_batch_size = -1;
 static int batch_size = -1;
 static bool vary_Pdxdy = false;
 static bool vary_udxdy = false;
 static bool vary_vdxdy = false;
+static bool vary_objspace = false;
 static bool saveptx = false;
 static bool warmup = false;
 static bool profile = false;
@@ -84,6 +88,7 @@ static std::vector<std::string> connections;
 static ParamValueList params;
 static ParamValueList reparams;
 static std::string reparam_layer;
+static bool promote_interactive = false;
 static ErrorHandler errhandler;
 static int iters = 1;
 static std::string raytype = "camera";
@@ -92,6 +97,7 @@ static std::string extraoptions;
 static std::string texoptions;
 static OSL::Matrix44 Mshad;  // "shader" space to "common" space matrix
 static OSL::Matrix44 Mobj;   // "object" space to "common" space matrix
+static OSL::Matrix44 Mobj_varying[7];  // per-point "object" spaces (--vary_objspace)
 static ShaderGroupRef shadergroup;
 static std::string archivegroup;
 static int exprcount = 0;
@@ -581,10 +587,12 @@ getargs (int argc, const char *argv[])
                 "--llvm_debug", &llvm_debug, "Turn on LLVM debugging info",
                 "--runstats", &runstats, "Print run statistics",
                 "--stats", &runstats, "",  // DEPRECATED 1.7
+                "--printstat %L", &printstats, "Print one ShadingSystem statistic (e.g. stat:groups_compiled) when done",
                 "--batched", &batched, "Submit batches to ShadingSystem",
                 "--vary_pdxdy", &vary_Pdxdy, "populate Dx(P) & Dy(P) with varying values (vs. uniform)",
                 "--vary_udxdy", &vary_udxdy, "populate Dx(u) & Dy(u) with varying values (vs. uniform)",
                 "--vary_vdxdy", &vary_vdxdy, "populate Dx(v) & Dy(v) with varying values (vs. uniform)",
+                "--vary_objspace", &vary_objspace, "give neighboring points different \"object\" spaces (vs. uniform)",
                 "--profile", &profile, "Print profile information",
                 "--saveptx", &saveptx, "Save the generated PTX (OptiX mode only)",
                 "--warmup", &warmup, "Perform a warmup launch",
@@ -609,6 +617,8 @@ getargs (int argc, const char *argv[])
                     "Connect fromlayer fromoutput tolayer toinput",
                 "--reparam %@ %s %s %s", stash_shader_arg, NULL, NULL, NULL,
                         "Change a parameter (args: layername paramname value) (options: type=%s)",
+                "--promote", &promote_interactive,
+                        "After the first iteration's reparams, promote the interactive params and shade the rest with the new group",
                 "--group %@ %s", stash_shader_arg, NULL,
                         "Specify a full group command",
                 "--archivegroup %s", &archivegroup,
@@ -715,6 +725,14 @@ setup_transformations (SimpleRenderer &rend, OSL::Matrix44 &Mshad,
     Mobj.rotate (OSL::Vec3 (0.0, 0.0, M_PI_2));
     // std::cout << "object-to-common matrix: " << Mobj << "\n";
 
+    // For --vary_objspace, a handful of object spaces that differ from
+    // Mobj and from each other by a translation and a scale.
+    for (int i = 0;  i < 7;  ++i) {
+        Mobj_varying[i] = Mobj;
+        Mobj_varying[i].translate (OSL::Vec3 (0.5f * i, -0.25f * i, 0.0f));
+        Mobj_varying[i].scale (OSL::Vec3 (1.0f + 0.125f * i));
+    }
+
     OSL::Matrix44 Mmyspace;
     Mmyspace.scale (OSL::Vec3 (1.0, 2.0, 1.0));
     // std::cout << "myspace-to-common matrix: " << Mmyspace << "\n";
@@ -741,7 +759,9 @@ setup_shaderglobals (ShaderGlobals &sg, ShadingSystem *shadingsys,
 
     // Set "object" space to be Mobj.  In a real renderer, this may be
     // different for each object.
-    sg.object2common = OSL::TransformationPtr (&Mobj);
+    sg.object2common = OSL::TransformationPtr (vary_objspace
+                                               ? &Mobj_varying[(x + y * xres) % 7]
+                                               : &Mobj);
 
     // Just make it look like all shades are the result of 'raytype' rays.
     sg.raytype = shadingsys->raytype_bit (ustring (raytype));
@@ -880,6 +900,12 @@ setup_output_images (SimpleRenderer *rend, ShadingSystem *shadingsys,
         std::cout << "\n";
     }
 
+    // shade_image() stores all the outputs, one after another, in the
+    // float channels of a single image, so with --shadeimage the first
+    // output file gets one image big enough for all of them.
+    std::string shadeimage_var, shadeimage_file;
+    int shadeimage_nchans = 0;
+
     // For each output file specified on the command line...
     for (size_t i = 0;  i < outputfiles.size();  ++i) {
         // Make a ustring version of the output name, for fast manipulation
@@ -899,7 +925,10 @@ setup_output_images (SimpleRenderer *rend, ShadingSystem *shadingsys,
 
         if (outputfiles[i] == "null") {
             // Filename "null" means to consider this a "renderer output",
-            // but not save it in an image file.
+            // but not save it in an image file.  shade_image() still
+            // leaves room for it.
+            if (use_shade_image)
+                shadeimage_nchans += t.numelements() * t.aggregate;
             continue;
         }
 
@@ -922,10 +951,22 @@ setup_output_images (SimpleRenderer *rend, ShadingSystem *shadingsys,
         // vector, etc.)
         int nchans = t.numelements() * t.aggregate;
 
+        if (use_shade_image) {
+            if (shadeimage_file.empty()) {
+                shadeimage_var = outputvars[i];
+                shadeimage_file = outputfiles[i];
+            }
+            shadeimage_nchans += nchans;
+            continue;
+        }
+
         // Make an ImageBuf of the right type and size to hold this
         // symbol's output, and initially clear it to all black pixels.
         rend->add_output (outputvars[i], outputfiles[i], tbase, nchans);
     }
+    if (shadeimage_file.size())
+        rend->add_output (shadeimage_var, shadeimage_file, OIIO::TypeFloat,
+                          shadeimage_nchans);
 
     if (! rend->noutputs()) {
         rend->add_output ("Cout", "Cout.tif", OIIO::TypeFloat, 3);
@@ -1430,6 +1471,8 @@ setup_varying_shaderglobals (int lane, BatchedShaderGlobals<WidthT> & bsg, Shadi
 
     vsg.u[lane] = u;
     vsg.v[lane] = v;
+    if (vary_objspace)
+        vsg.object2common[lane] = OSL::TransformationPtr (&Mobj_varying[(x + y * xres) % 7]);
     if (vary_udxdy) {
         vsg.dudx[lane] = 1.0f - u;
         vsg.dudy[lane] = u;
@@ -1807,6 +1850,19 @@ test_shade (int argc, const char *argv[])
                                          pv.data());
             }
         }
+
+        // Optionally promote the interactive params once they've been
+        // edited, and shade the remaining iterations with the new group.
+        if (promote_interactive && iter == 0) {
+            ShaderGroupRef promoted =
+                shadingsys->PromoteInteractiveParameters (*shadergroup);
+            if (promoted) {
+                shadergroup = promoted;
+                rend->shaders().push_back (shadergroup);
+            } else {
+                std::cerr << "ERROR: could not promote the interactive params\n";
+            }
+        }
     }
     double runtime = timer.lap();
 
@@ -1851,6 +1907,41 @@ test_shade (int argc, const char *argv[])
         }
     }
 
+    // Print the individually requested statistics.  Any background
+    // texture warmup or tier-up is waited for first, so its counts are
+    // the same from run to run.
+    if (printstats.size()) {
+        int texture_warmup = 0;
+        shadingsys->getattribute ("texture_warmup", texture_warmup);
+        if (texture_warmup)
+            shadingsys->warmup_textures (shadergroup.get(), true);
+        // Don't wait forever, though, in case the tier-up never comes.
+        int tier_up_pending = 0;
+        auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while (shadingsys->getattribute (shadergroup.get(), "tier_up_pending",
+                                         tier_up_pending) && tier_up_pending) {
+            if (std::chrono::steady_clock::now() > give_up) {
+                std::cerr << "WARNING: gave up waiting for the tier-up\n";
+                break;
+            }
+            std::this_thread::sleep_for (std::chrono::milliseconds(10));
+        }
+        for (auto&& name : printstats) {
+            int ival = 0;
+            long long llval = 0;
+            float fval = 0.0f;
+            std::cout << name << " = ";
+            if (shadingsys->getattribute (name, ival))
+                std::cout << ival << "\n";
+            else if (shadingsys->getattribute (name, TypeDesc::INT64, &llval))
+                std::cout << llval << "\n";
+            else if (shadingsys->getattribute (name, fval))
+                std::cout << fval << "\n";
+            else
+                std::cout << "(unknown)\n";
+        }
+    }
+
     // Print some debugging info
     if (debug1 || runstats || profile) {
         double writetime = timer.lap();
@@ -0,0 +1,20 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# Both runs set "optimize" themselves, so that TESTSHADE_OPT doesn't matter.
+
+# Unoptimized, every getattribute runs, but the two invariant attributes
+# are only asked of the renderer once per context: 1+1+16 calls, and the
+# other 15+15 lookups come from the cache.
+command += testshade("-t 1 -g 4 4 --options optimize=0 -od float -o Cout out_O0.exr "
+                     "--printstat stat:getattribute_calls "
+                     "--printstat stat:getattribute_cache_hits test")
+
+# Optimized, the group-invariant attribute is constant folded along with
+# the one from a named object, which leaves only the 16 "s" lookups.
+command += testshade("-t 1 -g 4 4 --options optimize=2 -od float -o Cout out.exr "
+                     "--printstat stat:getattribute_calls "
+                     "--printstat stat:getattribute_cache_hits test")
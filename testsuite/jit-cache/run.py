@@ -0,0 +1,20 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+import atexit, shutil, tempfile
+
+# The first run compiles the group and saves its machine code in the
+# jit_cache_dir, the second run should load it from there instead of
+# generating code again. Both must produce identical results, and the
+# stats show which run hit the cache. The cache starts out empty every
+# time and is removed when the test is done.
+jitcache = tempfile.mkdtemp (prefix="osl-jitcache-")
+atexit.register (shutil.rmtree, jitcache, True)
+for i in range(2) :
+    command += testshade("-g 2 1 -options jit_cache_dir=" + jitcache +
+                         " --printstat stat:jit_cache_hits"
+                         " --printstat stat:jit_cache_misses"
+                         " --printstat stat:jit_cache_uncacheable test")
@@ -0,0 +1,12 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# The group is first JITed at the quick level and, after two executions,
+# recompiled fully optimized in the background. Results must not change
+# no matter which code runs which points, and the group must have been
+# tiered up exactly once by the time testshade is done.
+command = testshade("-g 5 1 -options llvm_tiered_jit=2 "
+                    "--printstat stat:groups_tiered_up test")
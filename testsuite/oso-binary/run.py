@@ -0,0 +1,9 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# Compile to binary oso, then both query and run the binary shaders
+oslcargs = "-Wall -binary-oso"
+command = oslinfo("-v metadata") + testshade("test")
@@ -0,0 +1,13 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# Same as the pointcloud test, but through the native .oslpc format
+failthresh = max (failthresh, 0.005)   # summation order may differ from Partio by an LSB
+command += testshade("-g 16 16 -param filename cloud.oslpc -od uint8 -o Cout out0.tif wrcloud")
+command += testshade("-g 256 256 -param filename cloud.oslpc -param radius 0.01 -od uint8 -o Cout out1.tif rdcloud")
+command += testshade("-g 256 256 -param filename cloud.oslpc -param radius 0.1 -od uint8 -o Cout out2.tif rdcloud")
+command += testshade("-g 1 1 -param filename cloud.oslpc rdwrcloud")
+outputs = [ "out0.tif", "out1.tif", "out2.tif", "out.txt" ]
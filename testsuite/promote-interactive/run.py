@@ -0,0 +1,16 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# scale is interactive and is changed to 15 after the first iteration,
+# which then promotes it.  The promoted group must be the network as
+# described (including the connection that the optimizer folds away) with
+# scale as an ordinary instance value of 15.
+command = testshade('-g 1 1 -iters 3 -promote -group "' +
+                        'shader source srclay, ' +
+                        'param float scale 5 [[int interactive=1]], ' +
+                        'shader test testlay, ' +
+                        'connect srclay.out testlay.offset" ' +
+                    '-reparam testlay scale 15.0')
@@ -0,0 +1,15 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# The wavefront integrator must produce the same image as the default one,
+# so render render-cornell's scene with its shaders and compare against
+# its reference image rather than keeping copies of them here.
+test_source_dir = os.path.join (test_source_dir, "..", "render-cornell")
+refdir = os.path.join (test_source_dir, "ref")
+
+failthresh = max (failthresh, 0.005)   # allow a little more LSB noise between platforms
+outputs = [ "out.exr" ]
+command = testrender("-r 256 256 -aa 4 --wavefront cornell.xml out.exr")
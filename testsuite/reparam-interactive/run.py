@@ -0,0 +1,13 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# scale is interactive, so it is not folded into the printf, and changing
+# it between iterations takes effect even though the group is already
+# optimized and JITed.
+command = testshade('-g 1 1 -iters 2 -group "' +
+                        'param float scale 5 [[int interactive=1]], ' +
+                        'shader test testlay" ' +
+                    '-reparam testlay scale 15.0')
@@ -96,15 +96,18 @@ splitsymbol = ';'
 #print ("refdir = " + refdir)
 print ("test source dir = ", test_source_dir)
 
+# A test may have no ref directory of its own if its run.py points refdir
+# at another test's.
+has_ref = os.path.exists (os.path.join (test_source_dir, "ref"))
 if platform.system() == 'Windows' :
-    if not os.path.exists("./ref") :
+    if has_ref and not os.path.exists("./ref") :
         shutil.copytree (os.path.join (test_source_dir, "ref"), "./ref")
     if os.path.exists (os.path.join (test_source_dir, "src")) and not os.path.exists("./src") :
         shutil.copytree (os.path.join (test_source_dir, "src"), "./src")
     if not os.path.exists(os.path.abspath("data")) :
         shutil.copytree (test_source_dir, os.path.abspath("data"))
 else :
-    if not os.path.exists("./ref") :
+    if has_ref and not os.path.exists("./ref") :
         os.symlink (os.path.join (test_source_dir, "ref"), "./ref")
     if os.path.exists (os.path.join (test_source_dir, "src")) and not os.path.exists("./src") :
         os.symlink (os.path.join (test_source_dir, "src"), "./src")
@@ -290,7 +293,7 @@ def runtest (command, outputs, failureok=0, failthresh=0, failpercent=0) :
         # will compare it to everything else with the same extension in
         # the ref directory.  That allows us to have multiple matching
         # variants for different platforms, etc.
-        for testfile in (["ref/"+out] + glob.glob (os.path.join ("ref", "*"+extension))) :
+        for testfile in ([os.path.join (refdir, out)] + glob.glob (os.path.join (refdir, "*"+extension))) :
             # print ("comparing " + out + " to " + testfile)
             if extension == ".tif" or extension == ".exr" :
                 # images -- use idiff
@@ -371,9 +374,9 @@ if compile_osl_files :
 
 # If either out.exr or out.tif is in the reference directory but somehow
 # is not in the outputs list, put it there anyway!
-if (os.path.exists("ref/out.exr") and ("out.exr" not in outputs)) :
+if (os.path.exists(os.path.join(refdir, "out.exr")) and ("out.exr" not in outputs)) :
     outputs.append ("out.exr")
-if (os.path.exists("ref/out.tif") and ("out.tif" not in outputs)) :
+if (os.path.exists(os.path.join(refdir, "out.tif")) and ("out.tif" not in outputs)) :
     outputs.append ("out.tif")
 
 # Run the test and check the outputs
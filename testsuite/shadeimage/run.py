@@ -0,0 +1,19 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# shade_image() packs every output, int and array ones included, into the
+# channels of a single float image (the "null" outputs still take their
+# channels).  Each group of channels must match testshade's own loop.
+command = testshade("--shadeimage -g 37 5 -od float -o Cout shadeimage.exr -o Iout null -o Ia null -o Fa null test")
+command += testshade("-g 37 5 -od float -o Cout Cout.exr -o Iout Iout.exr -o Ia Ia.exr -o Fa Fa.exr test")
+command += oiiotool ("shadeimage.exr --ch 0,1,2 -o si_Cout.exr")
+command += oiiotool ("shadeimage.exr --ch 3 -o si_Iout.exr")
+command += oiiotool ("shadeimage.exr --ch 4,5 -o si_Ia.exr")
+command += oiiotool ("shadeimage.exr --ch 6,7 -o si_Fa.exr")
+command += oiiodiff ("si_Cout.exr", "Cout.exr")
+command += oiiodiff ("si_Iout.exr", "Iout.exr")
+command += oiiodiff ("si_Ia.exr", "Ia.exr")
+command += oiiodiff ("si_Fa.exr", "Fa.exr")
@@ -0,0 +1,12 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/imageworks/OpenShadingLanguage
+
+# Same as texture-simple, but with the texture opened (and its coarsest
+# MIP level read) in the background as soon as the group is optimized.
+# The stats show that the warmup really opened it.
+command += testshade("--options texture_warmup=2 -g 256 256 --center -od uint8 -o Cout out.tif "
+                     "--printstat stat:textures_warmed --printstat stat:texture_warmup_failed test")
+outputs = [ "out.txt", "out.tif" ]